@@ -0,0 +1,243 @@
+#include "BatchRenderer.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+#include <iostream>
+#include "DesignFile.h"
+#include "OffscreenRenderer.h"
+#include "RenderManager.h"
+
+static const char* rendering_mode_names[] = { "basic", "ssao", "contour", "line", "hatching", "sketchy" };
+
+BatchRenderer::BatchRenderer() {
+	layer_id = -1;
+	renderingMode = RenderManager::RENDERING_MODE_BASIC;
+
+	// the same as the initial camera of GLWidget3D
+	Camera camera;
+	xrot = camera.xrot;
+	yrot = camera.yrot;
+	zrot = camera.zrot;
+	pos = camera.pos;
+	fovy = camera.fovy;
+
+	width = 1024;
+	height = 768;
+	output_dir = ".";
+	jobs = QThread::idealThreadCount();
+}
+
+/**
+ * Render the design files specified by the command line arguments.
+ * Return the exit code of the application.
+ */
+int BatchRenderer::run(const QStringList& arguments) {
+	QStringList files;
+	if (!parseArguments(arguments, files)) return 1;
+
+	QElapsedTimer total_timer;
+	total_timer.start();
+
+	// start loading all the files (parsing the xml and generating the 3D geometry) in the thread pool
+	QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+	QList<QFuture<LoadedDesign> > loads;
+	for (int i = 0; i < files.size(); ++i) {
+		loads.push_back(QtConcurrent::run(&BatchRenderer::load, files[i]));
+	}
+
+	// the OpenGL context is bound to this thread, so the images are rendered one by one
+	OffscreenRenderer renderer;
+	QElapsedTimer timer;
+	timer.start();
+	try {
+		renderer.init(width, height);
+	}
+	catch (const char* ex) {
+		std::cerr << "Error: " << ex << std::endl;
+		return 1;
+	}
+	renderer.renderManager.renderingMode = renderingMode;
+	renderer.camera.xrot = xrot;
+	renderer.camera.yrot = yrot;
+	renderer.camera.zrot = zrot;
+	renderer.camera.pos = pos;
+	renderer.camera.fovy = fovy;
+	renderer.camera.updatePMatrix(width, height);
+	printf("init context: %.1f ms\n", timer.nsecsElapsed() * 1e-6);
+
+	QList<QFuture<double> > saves;
+	int num_errors = 0;
+	for (int i = 0; i < loads.size(); ++i) {
+		LoadedDesign design = loads[i].result();
+		if (!design.error.isEmpty()) {
+			std::cerr << design.filename.toUtf8().constData() << ": " << design.error.toUtf8().constData() << std::endl;
+			num_errors++;
+			continue;
+		}
+		printf("%s: load %.1f ms, %d layers\n", design.filename.toUtf8().constData(), design.load_time, (int)design.layers.size());
+		if (layer_id >= (int)design.layers.size()) {
+			std::cerr << design.filename.toUtf8().constData() << ": Layer " << layer_id + 1 << " is out of range (" << design.layers.size() << " layers)" << std::endl;
+			num_errors++;
+			continue;
+		}
+
+		for (int l = 0; l < design.layers.size(); ++l) {
+			if (layer_id >= 0 && l != layer_id) continue;
+
+			// glFinish() is called after each stage so that the GPU time is counted in the stage
+			timer.restart();
+			renderer.setLayer(design.layers[l]);
+			glFinish();
+			double upload_time = timer.nsecsElapsed() * 1e-6;
+
+			timer.restart();
+			renderer.updateShadowMap();
+			glFinish();
+			double shadow_time = timer.nsecsElapsed() * 1e-6;
+
+			timer.restart();
+			renderer.render();
+			glFinish();
+			double render_time = timer.nsecsElapsed() * 1e-6;
+
+			timer.restart();
+			QImage image = renderer.readImage();
+			double readback_time = timer.nsecsElapsed() * 1e-6;
+
+			QString output_file = QDir(output_dir).filePath(QString("%1_layer%2_%3.png").arg(QFileInfo(design.filename).completeBaseName()).arg(l + 1).arg(rendering_mode_names[renderingMode]));
+			saves.push_back(QtConcurrent::run(&BatchRenderer::saveImage, image, output_file));
+
+			printf("  layer %d: upload %.1f ms, shadow %.1f ms, render %.1f ms, readback %.1f ms\n", l + 1, upload_time, shadow_time, render_time, readback_time);
+		}
+	}
+
+	// wait for the images to be encoded
+	double encode_time = 0.0;
+	for (int i = 0; i < saves.size(); ++i) {
+		double t = saves[i].result();
+		if (t < 0) {
+			num_errors++;
+		}
+		else {
+			encode_time += t;
+		}
+	}
+	printf("encode: %.1f ms in total for %d images\n", encode_time, saves.size());
+	printf("total: %.1f ms\n", total_timer.nsecsElapsed() * 1e-6);
+
+	return num_errors > 0 ? 1 : 0;
+}
+
+bool BatchRenderer::parseArguments(const QStringList& arguments, QStringList& files) {
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Render the design files into PNG images without showing the window.");
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("render", "Run the batch renderer."));
+	parser.addOption(QCommandLineOption("layer", "Layer to render (1-based). All the layers are rendered by default.", "id"));
+	parser.addOption(QCommandLineOption("mode", "Rendering mode: basic, ssao, contour, line, hatching, or sketchy.", "mode", "basic"));
+	parser.addOption(QCommandLineOption("xrot", "Rotation of the camera around the x axis in degrees.", "degree"));
+	parser.addOption(QCommandLineOption("yrot", "Rotation of the camera around the y axis in degrees.", "degree"));
+	parser.addOption(QCommandLineOption("zrot", "Rotation of the camera around the z axis in degrees.", "degree"));
+	parser.addOption(QCommandLineOption("pos", "Position of the camera.", "x,y,z"));
+	parser.addOption(QCommandLineOption("fovy", "Vertical field of view in degrees.", "degree"));
+	parser.addOption(QCommandLineOption("size", "Size of the images.", "WxH", "1024x768"));
+	parser.addOption(QCommandLineOption("output", "Output directory.", "dir", "."));
+	parser.addOption(QCommandLineOption("jobs", "Number of threads to load the files and encode the images.", "n"));
+	parser.addPositionalArgument("files", "Design files to render.", "file1.xml file2.xml ...");
+	parser.process(arguments);
+
+	if (parser.isSet("layer")) {
+		bool ok;
+		layer_id = parser.value("layer").toInt(&ok) - 1;
+		if (!ok || layer_id < 0) {
+			std::cerr << "Invalid layer: " << parser.value("layer").toUtf8().constData() << std::endl;
+			return false;
+		}
+	}
+	if (parser.isSet("xrot")) xrot = parser.value("xrot").toFloat();
+	if (parser.isSet("yrot")) yrot = parser.value("yrot").toFloat();
+	if (parser.isSet("zrot")) zrot = parser.value("zrot").toFloat();
+	if (parser.isSet("fovy")) fovy = parser.value("fovy").toFloat();
+	if (parser.isSet("jobs")) jobs = std::max(1, parser.value("jobs").toInt());
+	output_dir = parser.value("output");
+
+	renderingMode = -1;
+	for (int i = 0; i < 6; ++i) {
+		if (parser.value("mode") == rendering_mode_names[i]) renderingMode = i;
+	}
+	if (renderingMode < 0) {
+		std::cerr << "Unknown rendering mode: " << parser.value("mode").toUtf8().constData() << std::endl;
+		return false;
+	}
+
+	if (parser.isSet("pos")) {
+		QStringList list = parser.value("pos").split(",");
+		if (list.size() != 3) {
+			std::cerr << "Invalid camera position: " << parser.value("pos").toUtf8().constData() << std::endl;
+			return false;
+		}
+		pos = glm::vec3(list[0].toFloat(), list[1].toFloat(), list[2].toFloat());
+	}
+
+	QStringList size = parser.value("size").split("x");
+	if (size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0) {
+		std::cerr << "Invalid image size: " << parser.value("size").toUtf8().constData() << std::endl;
+		return false;
+	}
+	width = size[0].toInt();
+	height = size[1].toInt();
+
+	files = parser.positionalArguments();
+	if (files.empty()) {
+		std::cerr << "No design file is specified." << std::endl;
+		return false;
+	}
+
+	QDir().mkpath(output_dir);
+
+	return true;
+}
+
+/**
+ * Load the design file. This is called in the thread pool.
+ */
+BatchRenderer::LoadedDesign BatchRenderer::load(const QString& filename) {
+	LoadedDesign design;
+	design.filename = filename;
+
+	QElapsedTimer timer;
+	timer.start();
+	try {
+		design.layers = canvas::DesignFile::load(filename);
+
+		// the loader defers the tessellation, so generate the 3D geometry here in the thread pool
+		for (int i = 0; i < design.layers.size(); ++i) {
+			for (int k = 0; k < design.layers[i].shapes.size(); ++k) {
+				design.layers[i].shapes[k]->ensure3DGeometry();
+			}
+		}
+	}
+	catch (const char* ex) {
+		design.error = ex;
+	}
+	design.load_time = timer.nsecsElapsed() * 1e-6;
+
+	return design;
+}
+
+/**
+ * Encode the image to the PNG file. This is called in the thread pool.
+ * Return the time in milliseconds, or -1 if the file cannot be written.
+ */
+double BatchRenderer::saveImage(const QImage& image, const QString& filename) {
+	QElapsedTimer timer;
+	timer.start();
+	if (!image.save(filename)) {
+		std::cerr << "Cannot write " << filename.toUtf8().constData() << std::endl;
+		return -1;
+	}
+	return timer.nsecsElapsed() * 1e-6;
+}
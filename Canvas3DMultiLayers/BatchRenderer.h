@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <glm/glm.hpp>
+#include "Layer.h"
+
+/**
+ * Command line tool which renders the design files into PNG images without showing the window.
+ *
+ * Usage: Canvas3DMultiLayers --render [options] file1.xml file2.xml ...
+ *
+ * The files are loaded concurrently by the thread pool while the images are rendered one by one
+ * on the offscreen context, and the PNG images are encoded concurrently again.
+ * On a machine without GPU, run it with a software OpenGL implementation (e.g. Mesa llvmpipe)
+ * and the offscreen platform plugin (-platform offscreen).
+ */
+class BatchRenderer {
+public:
+	struct LoadedDesign {
+		QString filename;
+		std::vector<canvas::Layer> layers;
+		double load_time;
+		QString error;
+	};
+
+public:
+	int layer_id;		// -1 to render all the layers
+	int renderingMode;
+	float xrot;
+	float yrot;
+	float zrot;
+	glm::vec3 pos;
+	float fovy;
+	int width;
+	int height;
+	QString output_dir;
+	int jobs;
+
+public:
+	BatchRenderer();
+
+	int run(const QStringList& arguments);
+
+private:
+	bool parseArguments(const QStringList& arguments, QStringList& files);
+	static LoadedDesign load(const QString& filename);
+	static double saveImage(const QImage& image, const QString& filename);
+};
@@ -0,0 +1,338 @@
+#include "Benchmark.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include "DesignFile.h"
+#include "History.h"
+#include "GLUtils.h"
+#include "Triangulator.h"
+#include "ShapeClipper.h"
+
+// operations to be measured (all_samples are indexed in this order)
+static const char* operation_names[] = { "load", "update3DGeometry", "hit", "history_push", "history_undo", "history_redo", "layer_clone", "save", "triangulate_cgal", "triangulate_earcut", "clip_offset", "clip_union", "clip_union_cached" };
+static const int NUM_OPERATIONS = 13;
+
+Benchmark::Benchmark() {
+	repeat = 20;
+	num_hit_tests = 1000;
+}
+
+/**
+ * Run the benchmark specified by the command line arguments.
+ * Return the exit code of the application.
+ */
+int Benchmark::run(const QStringList& arguments) {
+	QString dir;
+	if (!parseArguments(arguments, dir)) return 1;
+
+	QStringList files = QDir(dir).entryList(QStringList() << "*.xml" << "*.cdb", QDir::Files, QDir::Name);
+	if (files.empty()) {
+		std::cerr << "No design file is found in " << dir.toUtf8().constData() << std::endl;
+		return 1;
+	}
+
+	QJsonObject results;
+	std::vector<std::vector<double> > all_samples(NUM_OPERATIONS);
+	for (int i = 0; i < files.size(); ++i) {
+		std::cerr << "Benchmarking " << files[i].toUtf8().constData() << "..." << std::endl;
+		try {
+			results[files[i]] = benchmarkFile(QDir(dir).filePath(files[i]), all_samples);
+		}
+		catch (const char* ex) {
+			std::cerr << files[i].toUtf8().constData() << ": " << ex << std::endl;
+			return 1;
+		}
+	}
+
+	// statistics over all the files
+	QJsonObject total;
+	for (int i = 0; i < NUM_OPERATIONS; ++i) {
+		total[operation_names[i]] = statistics(all_samples[i]);
+	}
+
+	QJsonObject root;
+	root["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+	root["build"] = QString("%1 %2").arg(__DATE__).arg(__TIME__);
+	root["repeat"] = repeat;
+	root["hit_tests"] = num_hit_tests;
+	root["unit"] = QString("ms");
+	root["files"] = results;
+	root["total"] = total;
+
+	QByteArray json = QJsonDocument(root).toJson();
+	if (output_file.isEmpty()) {
+		std::cout << json.constData();
+	}
+	else {
+		QFile file(output_file);
+		if (!file.open(QFile::WriteOnly)) {
+			std::cerr << "Cannot write " << output_file.toUtf8().constData() << std::endl;
+			return 1;
+		}
+		file.write(json);
+	}
+
+	return 0;
+}
+
+bool Benchmark::parseArguments(const QStringList& arguments, QString& dir) {
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measure the editing operations over the design files.");
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("benchmark", "Run the benchmark."));
+	parser.addOption(QCommandLineOption("repeat", "Number of repetitions of each operation.", "n", "20"));
+	parser.addOption(QCommandLineOption("hits", "Number of hit tests per layer.", "n", "1000"));
+	parser.addOption(QCommandLineOption("output", "JSON file to write the results to (stdout by default).", "file"));
+	parser.addPositionalArgument("directory", "Directory of the design files (data by default).", "[directory]");
+	parser.process(arguments);
+
+	repeat = std::max(1, parser.value("repeat").toInt());
+	num_hit_tests = std::max(1, parser.value("hits").toInt());
+	output_file = parser.value("output");
+
+	dir = parser.positionalArguments().empty() ? "data" : parser.positionalArguments()[0];
+	if (!QDir(dir).exists()) {
+		std::cerr << "Directory not found: " << dir.toUtf8().constData() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Measure all the operations on the design file.
+ * The samples are also appended to all_samples to compute the statistics over all the files.
+ */
+QJsonObject Benchmark::benchmarkFile(const QString& filename, std::vector<std::vector<double> >& all_samples) {
+	std::vector<std::vector<double> > samples(NUM_OPERATIONS);
+	QElapsedTimer timer;
+
+	// load
+	std::vector<canvas::Layer> layers;
+	for (int r = 0; r < repeat; ++r) {
+		timer.start();
+		layers = canvas::DesignFile::load(filename);
+		samples[0].push_back(timer.nsecsElapsed() * 1e-6);
+	}
+
+	// update3DGeometry of each shape
+	int num_shapes = 0;
+	for (int r = 0; r < repeat; ++r) {
+		for (int l = 0; l < layers.size(); ++l) {
+			for (int i = 0; i < layers[l].shapes.size(); ++i) {
+				timer.start();
+				layers[l].shapes[i]->update3DGeometry();
+				samples[1].push_back(timer.nsecsElapsed() * 1e-6);
+			}
+			if (r == 0) num_shapes += layers[l].shapes.size();
+		}
+	}
+
+	// triangulate the outline of each shape by the CGAL convex partition and by the ear clipping,
+	// and check that the triangles cover the polygon without flipping
+	int num_polygons = 0;
+	int invalid_cgal = 0;
+	int invalid_earcut = 0;
+	glutils::Triangulator triangulator;
+	for (int l = 0; l < layers.size(); ++l) {
+		for (int i = 0; i < layers[l].shapes.size(); ++i) {
+			std::vector<glm::dvec2> points = layers[l].shapes[i]->getPoints();
+			std::vector<glm::vec2> pts(points.size());
+			for (int k = 0; k < points.size(); ++k) {
+				pts[k] = glm::vec2(points[k]);
+			}
+
+			std::vector<glm::vec2> triangles;
+			for (int r = 0; r < repeat; ++r) {
+				timer.start();
+				glutils::convexPartitionTriangles(pts, triangles);
+				samples[8].push_back(timer.nsecsElapsed() * 1e-6);
+			}
+			if (!validTriangulation(pts, triangles)) invalid_cgal++;
+
+			std::vector<unsigned int> indices;
+			for (int r = 0; r < repeat; ++r) {
+				timer.start();
+				triangulator.triangulate(pts, indices);
+				samples[9].push_back(timer.nsecsElapsed() * 1e-6);
+			}
+			triangles.resize(indices.size());
+			for (int k = 0; k < indices.size(); ++k) {
+				triangles[k] = pts[indices[k]];
+			}
+			if (!validTriangulation(pts, triangles)) invalid_earcut++;
+
+			num_polygons++;
+		}
+	}
+
+	// offset the outline of each shape by 5% of its size, and merge the outlines of the shapes of each layer,
+	// where the merged outline is taken from the cache if no shape has changed
+	canvas::ShapeClipper clipper;
+	for (int l = 0; l < layers.size(); ++l) {
+		for (int i = 0; i < layers[l].shapes.size(); ++i) {
+			canvas::BoundingBox bbox = layers[l].shapes[i]->worldBoundingBox();
+			double delta = glm::length(bbox.maxPt - bbox.minPt) * 0.05;
+			for (int r = 0; r < repeat; ++r) {
+				clipper.clear();
+				timer.start();
+				clipper.offset(layers[l].shapes[i], delta);
+				samples[10].push_back(timer.nsecsElapsed() * 1e-6);
+			}
+		}
+
+		for (int r = 0; r < repeat; ++r) {
+			clipper.clear();
+			timer.start();
+			clipper.unite(layers[l].shapes);
+			samples[11].push_back(timer.nsecsElapsed() * 1e-6);
+		}
+		for (int r = 0; r < repeat; ++r) {
+			timer.start();
+			clipper.unite(layers[l].shapes);
+			samples[12].push_back(timer.nsecsElapsed() * 1e-6);
+		}
+	}
+
+	// hit tests at random points around the shapes, in the same way as selecting a shape by the mouse
+	// (the seed is fixed so that the same points are tested by every build)
+	std::mt19937 mt(0);
+	int num_hits = 0;
+	for (int l = 0; l < layers.size(); ++l) {
+		if (layers[l].shapes.empty()) continue;
+
+		canvas::BoundingBox bbox = layers[l].shapes[0]->worldBoundingBox();
+		for (int i = 1; i < layers[l].shapes.size(); ++i) {
+			canvas::BoundingBox b = layers[l].shapes[i]->worldBoundingBox();
+			bbox = canvas::BoundingBox(glm::min(bbox.minPt, b.minPt), glm::max(bbox.maxPt, b.maxPt));
+		}
+		glm::dvec2 margin = (bbox.maxPt - bbox.minPt) * 0.1;
+		std::uniform_real_distribution<double> dist_x(bbox.minPt.x - margin.x, bbox.maxPt.x + margin.x);
+		std::uniform_real_distribution<double> dist_y(bbox.minPt.y - margin.y, bbox.maxPt.y + margin.y);
+
+		for (int k = 0; k < num_hit_tests; ++k) {
+			glm::dvec2 pt(dist_x(mt), dist_y(mt));
+			timer.start();
+			for (int i = layers[l].shapes.size() - 1; i >= 0; --i) {
+				if (layers[l].shapes[i]->hit(pt)) {
+					num_hits++;
+					break;
+				}
+			}
+			samples[2].push_back(timer.nsecsElapsed() * 1e-6);
+		}
+	}
+
+	// history: push the states of an editing session, and then, undo and redo all of them
+	canvas::History history;
+	for (int r = 0; r < repeat; ++r) {
+		timer.start();
+		history.push(layers);
+		samples[3].push_back(timer.nsecsElapsed() * 1e-6);
+	}
+	for (int r = 0; r < repeat - 1; ++r) {
+		timer.start();
+		layers = history.undo();
+		samples[4].push_back(timer.nsecsElapsed() * 1e-6);
+	}
+	for (int r = 0; r < repeat - 1; ++r) {
+		timer.start();
+		layers = history.redo();
+		samples[5].push_back(timer.nsecsElapsed() * 1e-6);
+	}
+
+	// clone each layer
+	for (int r = 0; r < repeat; ++r) {
+		for (int l = 0; l < layers.size(); ++l) {
+			timer.start();
+			canvas::Layer copied_layer = layers[l].clone();
+			samples[6].push_back(timer.nsecsElapsed() * 1e-6);
+		}
+	}
+
+	// save to a temporary file
+	QString temp_file = QDir::temp().filePath(QString("canvas_benchmark_%1.xml").arg(QFileInfo(filename).completeBaseName()));
+	for (int r = 0; r < repeat; ++r) {
+		timer.start();
+		canvas::DesignFile::save(temp_file, layers);
+		samples[7].push_back(timer.nsecsElapsed() * 1e-6);
+	}
+	QFile::remove(temp_file);
+
+	QJsonObject result;
+	result["layers"] = (int)layers.size();
+	result["shapes"] = num_shapes;
+	result["hit_ratio"] = samples[2].empty() ? 0.0 : (double)num_hits / samples[2].size();
+	QJsonObject triangulation;
+	triangulation["polygons"] = num_polygons;
+	triangulation["invalid_cgal"] = invalid_cgal;
+	triangulation["invalid_earcut"] = invalid_earcut;
+	result["triangulation"] = triangulation;
+	for (int i = 0; i < NUM_OPERATIONS; ++i) {
+		result[operation_names[i]] = statistics(samples[i]);
+		all_samples[i].insert(all_samples[i].end(), samples[i].begin(), samples[i].end());
+	}
+
+	return result;
+}
+
+/**
+ * Check whether the triangles, which are stored as the triplets of points, are all counter clockwise and
+ * their total area is equal to the area of the polygon.
+ */
+bool Benchmark::validTriangulation(const std::vector<glm::vec2>& points, const std::vector<glm::vec2>& triangles) {
+	double polygon_area = 0.0;
+	for (int i = 0; i < points.size(); ++i) {
+		int next = (i + 1) % points.size();
+		polygon_area += (double)points[i].x * points[next].y - (double)points[next].x * points[i].y;
+	}
+	polygon_area = std::abs(polygon_area) * 0.5;
+	if (polygon_area == 0.0) return true;
+
+	double total_area = 0.0;
+	for (int i = 0; i + 2 < triangles.size(); i += 3) {
+		glm::dvec2 a(triangles[i]);
+		glm::dvec2 b(triangles[i + 1]);
+		glm::dvec2 c(triangles[i + 2]);
+		double area = ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)) * 0.5;
+		if (area < -polygon_area * 1e-6) return false;
+		total_area += area;
+	}
+
+	return std::abs(total_area - polygon_area) <= polygon_area * 1e-4;
+}
+
+/**
+ * Return the number of samples, the mean, the median, and the percentiles of the samples.
+ * The percentiles are computed by the nearest-rank method.
+ */
+QJsonObject Benchmark::statistics(std::vector<double> samples) {
+	QJsonObject stats;
+	stats["samples"] = (int)samples.size();
+	if (samples.empty()) return stats;
+
+	std::sort(samples.begin(), samples.end());
+	int n = samples.size();
+
+	double sum = 0.0;
+	for (int i = 0; i < n; ++i) {
+		sum += samples[i];
+	}
+
+	stats["min"] = samples[0];
+	stats["mean"] = sum / n;
+	stats["median"] = n % 2 == 1 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) * 0.5;
+	stats["p90"] = samples[std::min(n - 1, (int)ceil(n * 0.90) - 1)];
+	stats["p99"] = samples[std::min(n - 1, (int)ceil(n * 0.99) - 1)];
+	stats["max"] = samples[n - 1];
+
+	return stats;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include "Layer.h"
+
+/**
+ * Command line tool which measures the editing hot paths over the design files.
+ *
+ * Usage: Canvas3DMultiLayers --benchmark [options] [directory]
+ *
+ * Every design file in the directory (data/ by default) is loaded, and the following operations
+ * are measured repeatedly: loading, update3DGeometry of each shape, hit tests at random points,
+ * History::push/undo/redo, Layer::clone, and saving to XML.
+ * The outline of every shape is also triangulated by the CGAL convex partition and by Triangulator,
+ * and the number of the invalid triangulations of each is reported.
+ * The median and the percentiles of each operation are reported as JSON in milliseconds, so that
+ * the results of different builds can be compared.
+ */
+class Benchmark {
+public:
+	int repeat;
+	int num_hit_tests;
+	QString output_file;
+
+public:
+	Benchmark();
+
+	int run(const QStringList& arguments);
+
+private:
+	bool parseArguments(const QStringList& arguments, QString& dir);
+	QJsonObject benchmarkFile(const QString& filename, std::vector<std::vector<double> >& all_samples);
+	static bool validTriangulation(const std::vector<glm::vec2>& points, const std::vector<glm::vec2>& triangles);
+	static QJsonObject statistics(std::vector<double> samples);
+};
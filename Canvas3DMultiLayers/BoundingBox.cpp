@@ -22,4 +22,10 @@ namespace canvas {
 		return maxPt.y - minPt.y;
 	}
 
+	bool BoundingBox::intersects(const BoundingBox& other) const {
+		if (maxPt.x < other.minPt.x || minPt.x > other.maxPt.x) return false;
+		if (maxPt.y < other.minPt.y || minPt.y > other.maxPt.y) return false;
+		return true;
+	}
+
 }
\ No newline at end of file
@@ -16,6 +16,7 @@ namespace canvas {
 		glm::dvec2 center() const;
 		double width() const;
 		double height() const;
+		bool intersects(const BoundingBox& other) const;
 	};
 
 }
\ No newline at end of file
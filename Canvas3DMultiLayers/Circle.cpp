@@ -1,7 +1,13 @@
 #include "Circle.h"
+#include "GLUtils.h"
+#include "Trace.h"
 
 namespace canvas {
 
+	// maximum distance between the arc and the chords of the 3D geometry in the world coordinate system
+	// (a large circle gets more segments, up to the maximum of glutils::circleSegments)
+	double Circle::tessellation_tolerance = 0.05;
+
 	Circle::Circle(int subtype) : Shape(subtype) {
 		type = TYPE_CIRCLE;
 		width = 0;
@@ -39,6 +45,19 @@ namespace canvas {
 		update3DGeometry();
 	}
 
+	/**
+	 * Construct a circle from the parameters read from a file.
+	 * The 3D geometry is not generated until it is used.
+	 */
+	Circle::Circle(int subtype, const glm::dvec2& pos, double theta, double width, double height) : Shape(subtype) {
+		type = TYPE_CIRCLE;
+		this->pos = pos;
+		this->theta = theta;
+		this->width = width;
+		this->height = height;
+		geometry_outdated = true;
+	}
+
 	Circle::~Circle() {
 	}
 
@@ -46,6 +65,15 @@ namespace canvas {
 		return boost::shared_ptr<Shape>(new Circle(*this));
 	}
 
+	/**
+	 * Return a copy of the circle without the 3D geometry, e.g., for writing the design to a file.
+	 */
+	boost::shared_ptr<Shape> Circle::cloneOutline() const {
+		Circle* new_circle = new Circle(subtype, pos, theta, width, height);
+		new_circle->copyIdentity(*this);
+		return boost::shared_ptr<Shape>(new_circle);
+	}
+
 	void Circle::draw(QPainter& painter, const QPointF& origin, double scale) const {
 		painter.save();
 
@@ -53,10 +81,10 @@ namespace canvas {
 		painter.rotate(-theta / 3.14159265 * 180);
 
 		if (selected || currently_drawing) {
-			painter.setPen(QPen(QColor(0, 0, 255), 2));
+			painter.setPen(pens[1]);
 		}
 		else {
-			painter.setPen(QPen(QColor(0, 0, 0), 1));
+			painter.setPen(pens[0]);
 		}
 		if (currently_drawing) {
 			painter.setBrush(QBrush(QColor(0, 0, 0, 0)));
@@ -66,16 +94,17 @@ namespace canvas {
 		}
 
 		// draw circle
+		// (the number of segments is chosen so that the chords deviate from the arc by at most a quarter pixel)
+		const std::vector<glm::vec2>& table = glutils::unitCircle(glutils::circleSegments(std::max(abs(width), abs(height)) * 0.5 * scale, 0.25f));
 		QPolygonF pol;
-		for (int i = 0; i < 36; i++) {
-			double theta = (double)i * 3.141592653 * 2 / 36;
-			pol.push_back(QPointF((width * 0.5 + width * 0.5 * cos(theta)) * scale, (-height * 0.5 + height * 0.5 * sin(theta)) * scale));
+		for (int i = 0; i < table.size(); i++) {
+			pol.push_back(QPointF((width * 0.5 + width * 0.5 * table[i].x) * scale, (-height * 0.5 + height * 0.5 * table[i].y) * scale));
 		}
 		painter.drawPolygon(pol);
 
 		if (selected) {
 			// show resize marker
-			painter.setPen(QPen(QColor(0, 0, 0), 1));
+			painter.setPen(pens[0]);
 			painter.setBrush(QBrush(QColor(255, 255, 255)));
 			painter.drawRect(-3, -3, 6, 6);
 			painter.drawRect(width * scale - 3, -3, 6, 6);
@@ -118,10 +147,26 @@ namespace canvas {
 	* Return the points of the rectangle in the world coordinate system.
 	*/
 	std::vector<glm::dvec2> Circle::getPoints() const {
-		std::vector<glm::dvec2> points;
-		for (int i = 0; i < 36; i++) {
-			double theta = (double)i * 3.141592653 * 2 / 36;
-			points.push_back(worldCoordinate(glm::dvec2(width * 0.5 + width * 0.5 * cos(theta), height * 0.5 + height * 0.5 * sin(theta))));
+		return tessellate(numSegments());
+	}
+
+	/**
+	* Return the points of the outline drawn on the screen of the given scale.
+	* The chords deviate from the arc by at most a quarter pixel.
+	*/
+	std::vector<glm::dvec2> Circle::getOutline(double scale) const {
+		return tessellate(glutils::circleSegments(std::max(abs(width), abs(height)) * 0.5 * scale, 0.25f));
+	}
+
+	/**
+	* Return the points which divide the circle into the given number of segments in the world coordinate system.
+	*/
+	std::vector<glm::dvec2> Circle::tessellate(int slices) const {
+		const std::vector<glm::vec2>& table = glutils::unitCircle(slices);
+
+		std::vector<glm::dvec2> points(table.size());
+		for (int i = 0; i < table.size(); i++) {
+			points[i] = worldCoordinate(glm::dvec2(width * 0.5 + width * 0.5 * table[i].x, height * 0.5 + height * 0.5 * table[i].y));
 		}
 		return points;
 	}
@@ -134,6 +179,7 @@ namespace canvas {
 			if (height * width >= 0) height = width;
 			else height = -width;
 		}
+		updateGeometryVersion();
 	}
 
 	/**
@@ -147,11 +193,22 @@ namespace canvas {
 		else return false;
 	}
 
+	/**
+	 * Return true if the other shape is a circle of the same size regardless of its pose.
+	 */
+	bool Circle::hasSameGeometry(const boost::shared_ptr<Shape>& other) const {
+		if (other->getType() != type || other->getSubType() != subtype) return false;
+
+		boost::shared_ptr<Circle> circle = boost::static_pointer_cast<Circle>(other);
+		return circle->width == width && circle->height == height;
+	}
+
 	/**
 	* Resize the rectangle by the specified scale.
 	* The resizing scale and the center of the resizing are specified as local coordinates.
 	*/
 	void Circle::resize(const glm::dvec2& scale, const glm::dvec2& resize_center) {
+		TRACE_SCOPE("Circle::resize");
 		glm::dvec2 dir(resize_center.x * (1.0 - scale.x), resize_center.y * (1.0 - scale.y));
 
 		pos.x += dir.x * cos(theta) - dir.y * sin(theta);
@@ -172,4 +229,23 @@ namespace canvas {
 		return BoundingBox(glm::dvec2(min_x, min_y), glm::dvec2(max_x, max_y));
 	}
 
+	/**
+	 * Return the number of the segments of the outline in the world coordinate system,
+	 * so that the chords deviate from the arc by at most the tessellation tolerance.
+	 */
+	int Circle::numSegments() const {
+		return glutils::circleSegments(std::max(abs(width), abs(height)) * 0.5, tessellation_tolerance);
+	}
+
+	/**
+	* Generate the 3D geometry from the cached elliptic prism instead of triangulating the outline.
+	*/
+	void Circle::buildMesh() {
+		int slices = numSegments();
+		glm::mat4 mat = glm::translate(glm::mat4(), glm::vec3(pos.x, pos.y, -10));
+		mat = glm::rotate(mat, (float)theta, glm::vec3(0, 0, 1));
+		mat = glm::translate(mat, glm::vec3(width * 0.5, height * 0.5, 0));
+		glutils::drawEllipticPrism(abs(width) * 0.5, abs(height) * 0.5, 10, glm::vec4(0.7, 1, 0.7, 1), mat, vertices, slices);
+	}
+
 }
\ No newline at end of file
@@ -5,26 +5,41 @@
 namespace canvas {
 
 	class Circle : public Shape {
+	public:
+		static double tessellation_tolerance;
+
 	private:
 		double width;
 		double height;
 
-
 	public:
 		Circle(int subtype);
 		Circle(int subtype, const glm::dvec2& point);
 		Circle(int subtype, QDomNode& node);
+		Circle(int subtype, const glm::dvec2& pos, double theta, double width, double height);
 		~Circle();
 
 		boost::shared_ptr<Shape> clone() const;
+		boost::shared_ptr<Shape> cloneOutline() const;
 		void draw(QPainter& painter, const QPointF& origin, double scale) const;
 		QDomElement toXml(QDomDocument& doc) const;
 		void addPoint(const glm::dvec2& point);
 		std::vector<glm::dvec2> getPoints() const;
+		double getWidth() const { return width; }
+		double getHeight() const { return height; }
+		std::vector<glm::dvec2> getOutline(double scale) const;
+		int numSegments() const;
 		void updateByNewPoint(const glm::dvec2& point, bool shiftPressed);
 		bool hit(const glm::dvec2& point) const;
+		bool hasSameGeometry(const boost::shared_ptr<Shape>& other) const;
 		void resize(const glm::dvec2& scale, const glm::dvec2& resize_center);
 		BoundingBox boundingBox() const;
+
+	protected:
+		void buildMesh();
+
+	private:
+		std::vector<glm::dvec2> tessellate(int slices) const;
 	};
 
 }
\ No newline at end of file
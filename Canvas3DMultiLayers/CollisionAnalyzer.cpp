@@ -0,0 +1,418 @@
+#include "CollisionAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <utility>
+#include <QtConcurrent/QtConcurrent>
+
+namespace canvas {
+
+	namespace {
+
+		// the smallest step of the time in the continuous check, which bounds the number of the steps
+		// when two bodies slide along each other at the clearance
+		const double MIN_TIME_STEP = 1.0 / 4096.0;
+
+		struct Box {
+			glm::dvec2 minPt;
+			glm::dvec2 maxPt;
+		};
+
+		/**
+		 * Body of a layer. The outline is in the local coordinate system, and the radius bounds the distance
+		 * of the outline from the origin of the body, around which the body rotates.
+		 */
+		struct Body {
+			int id;
+			std::vector<glm::dvec2> points;
+			double radius;
+			// the poses in this layer and in the next layer
+			glm::dvec2 pos[2];
+			double theta[2];
+			bool has_next;
+		};
+
+		/**
+		 * Outline of a body moved to a pose, and the bounding boxes of its edges.
+		 * The edge i connects the point i and the point i + 1 (the last edge connects the last point and the first point).
+		 */
+		struct PosedBody {
+			std::vector<glm::dvec2> points;
+			std::vector<Box> boxes;
+			Box box;
+		};
+
+		/**
+		 * Bounding box of an edge in the sweep of the narrowphase.
+		 */
+		struct EdgeItem {
+			double min_x;
+			int body;
+			int edge;
+
+			bool operator<(const EdgeItem& other) const { return min_x < other.min_x; }
+		};
+
+		struct LayerTask {
+			int layer;
+			double clearance;
+			// the bodies of the layer, and the corresponding shapes of the next layer (NULL if there is none)
+			std::vector<boost::shared_ptr<Shape> > shapes;
+			std::vector<boost::shared_ptr<Shape> > next_shapes;
+			std::vector<CollisionAnalyzer::Contact> contacts;
+		};
+
+		void buildBody(const boost::shared_ptr<Shape>& shape, const boost::shared_ptr<Shape>& next_shape, Body& body) {
+			body.id = shape->getId();
+			body.pos[0] = body.pos[1] = shape->getPosition();
+			body.theta[0] = body.theta[1] = shape->getRotation();
+			body.has_next = (bool)next_shape;
+			if (next_shape) {
+				body.pos[1] = next_shape->getPosition();
+				body.theta[1] = next_shape->getRotation();
+			}
+
+			body.points = shape->getPoints();
+			body.radius = 0.0;
+			for (int i = 0; i < body.points.size(); ++i) {
+				body.points[i] = shape->localCoordinate(body.points[i]);
+				body.radius = std::max(body.radius, glm::length(body.points[i]));
+			}
+		}
+
+		/**
+		 * Return the pose of the body at the time of the motion to the next layer.
+		 * The body rotates along the shorter arc, in the same way as the playback.
+		 */
+		void interpolatePose(const Body& body, double t, glm::dvec2& pos, double& theta) {
+			double dtheta = body.theta[1] - body.theta[0];
+			dtheta = atan2(sin(dtheta), cos(dtheta));
+			pos = body.pos[0] + (body.pos[1] - body.pos[0]) * t;
+			theta = body.theta[0] + dtheta * t;
+		}
+
+		/**
+		 * Return the bound of the displacement of any point of the body during the motion to the next layer.
+		 */
+		double motionBound(const Body& body) {
+			double dtheta = body.theta[1] - body.theta[0];
+			dtheta = atan2(sin(dtheta), cos(dtheta));
+			return glm::length(body.pos[1] - body.pos[0]) + fabs(dtheta) * body.radius;
+		}
+
+		void poseBody(const Body& body, const glm::dvec2& pos, double theta, PosedBody& posed) {
+			double c = cos(theta);
+			double s = sin(theta);
+
+			int n = body.points.size();
+			posed.points.resize(n);
+			for (int i = 0; i < n; ++i) {
+				const glm::dvec2& p = body.points[i];
+				posed.points[i] = glm::dvec2(p.x * c - p.y * s + pos.x, p.x * s + p.y * c + pos.y);
+			}
+
+			posed.boxes.resize(n);
+			posed.box.minPt = glm::dvec2(std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+			posed.box.maxPt = -posed.box.minPt;
+			for (int i = 0; i < n; ++i) {
+				const glm::dvec2& a = posed.points[i];
+				const glm::dvec2& b = posed.points[(i + 1) % n];
+				posed.boxes[i].minPt = glm::min(a, b);
+				posed.boxes[i].maxPt = glm::max(a, b);
+				posed.box.minPt = glm::min(posed.box.minPt, a);
+				posed.box.maxPt = glm::max(posed.box.maxPt, a);
+			}
+		}
+
+		double boxGap(const Box& a, const Box& b) {
+			return std::max(std::max(b.minPt.x - a.maxPt.x, a.minPt.x - b.maxPt.x), std::max(b.minPt.y - a.maxPt.y, a.minPt.y - b.maxPt.y));
+		}
+
+		bool boxContains(const Box& outer, const Box& inner) {
+			return outer.minPt.x <= inner.minPt.x && outer.minPt.y <= inner.minPt.y && outer.maxPt.x >= inner.maxPt.x && outer.maxPt.y >= inner.maxPt.y;
+		}
+
+		/**
+		 * Check whether the point is inside the polygon by the crossing number.
+		 */
+		bool isInside(const glm::dvec2& p, const std::vector<glm::dvec2>& points) {
+			bool inside = false;
+			for (int i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+				if ((points[i].y > p.y) != (points[j].y > p.y) && p.x < (points[j].x - points[i].x) * (p.y - points[i].y) / (points[j].y - points[i].y) + points[i].x) {
+					inside = !inside;
+				}
+			}
+			return inside;
+		}
+
+		double cross(const glm::dvec2& o, const glm::dvec2& a, const glm::dvec2& b) {
+			return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+		}
+
+		/**
+		 * Return the distance between the point and the segment ab, and the closest point on the segment.
+		 */
+		double pointSegmentDistance(const glm::dvec2& p, const glm::dvec2& a, const glm::dvec2& b, glm::dvec2& closest) {
+			glm::dvec2 ab = b - a;
+			double len2 = glm::dot(ab, ab);
+			double t = len2 > 0.0 ? std::max(0.0, std::min(1.0, glm::dot(p - a, ab) / len2)) : 0.0;
+			closest = a + ab * t;
+			return glm::length(p - closest);
+		}
+
+		/**
+		 * Return the distance between the segments a1a2 and b1b2 if it is less than the best distance so far,
+		 * and the closest points. Otherwise, return the best distance.
+		 * The segments are the convex pieces of the outlines, so the separating axis is either of their normals,
+		 * which is tested by the orientations of the end points. If they are separated, the closest points include
+		 * an end point of either segment.
+		 */
+		double segmentDistance(const glm::dvec2& a1, const glm::dvec2& a2, const glm::dvec2& b1, const glm::dvec2& b2, double best, glm::dvec2& point1, glm::dvec2& point2) {
+			double d1 = cross(a1, a2, b1);
+			double d2 = cross(a1, a2, b2);
+			double d3 = cross(b1, b2, a1);
+			double d4 = cross(b1, b2, a2);
+			if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+				// the segments cross at a single point
+				point1 = point2 = a1 + (a2 - a1) * (d3 / (d3 - d4));
+				return 0.0;
+			}
+
+			glm::dvec2 closest;
+			double d = pointSegmentDistance(a1, b1, b2, closest);
+			if (d < best) { best = d; point1 = a1; point2 = closest; }
+			d = pointSegmentDistance(a2, b1, b2, closest);
+			if (d < best) { best = d; point1 = a2; point2 = closest; }
+			d = pointSegmentDistance(b1, a1, a2, closest);
+			if (d < best) { best = d; point1 = closest; point2 = b1; }
+			d = pointSegmentDistance(b2, a1, a2, closest);
+			if (d < best) { best = d; point1 = closest; point2 = b2; }
+
+			return best;
+		}
+
+		/**
+		 * Return the minimum distance between the bodies if it is less than the margin, and the closest points.
+		 * Otherwise, return the margin. The distance is 0 if the outlines cross or one body contains the other.
+		 *
+		 * Only the edges whose bounding boxes are closer than the best distance so far are tested, which are found
+		 * by a sweep along the x axis. The closest edges are returned in the hint, and the edges of the given hint
+		 * are tested first, so that the sweep of the next step of the motion prunes most of the edges from the beginning.
+		 */
+		double bodyDistance(const PosedBody& body1, const PosedBody& body2, double margin, glm::dvec2& point1, glm::dvec2& point2, std::pair<int, int>& hint) {
+			if (body1.points.empty() || body2.points.empty()) return margin;
+			if (boxGap(body1.box, body2.box) >= margin) return margin;
+
+			// a body inside the other does not cross its outline
+			if (boxContains(body2.box, body1.box) && isInside(body1.points[0], body2.points)) {
+				point1 = point2 = body1.points[0];
+				return 0.0;
+			}
+			if (boxContains(body1.box, body2.box) && isInside(body2.points[0], body1.points)) {
+				point1 = point2 = body2.points[0];
+				return 0.0;
+			}
+
+			const PosedBody* bodies[2] = { &body1, &body2 };
+			int n1 = body1.points.size();
+			int n2 = body2.points.size();
+
+			double best = margin;
+			if (hint.first >= 0 && hint.first < n1 && hint.second >= 0 && hint.second < n2) {
+				best = segmentDistance(body1.points[hint.first], body1.points[(hint.first + 1) % n1], body2.points[hint.second], body2.points[(hint.second + 1) % n2], best, point1, point2);
+				if (best <= 0.0) return 0.0;
+			}
+
+			std::vector<EdgeItem> items;
+			items.reserve(n1 + n2);
+			for (int b = 0; b < 2; ++b) {
+				for (int i = 0; i < bodies[b]->boxes.size(); ++i) {
+					EdgeItem item = { bodies[b]->boxes[i].minPt.x, b, i };
+					items.push_back(item);
+				}
+			}
+			std::sort(items.begin(), items.end());
+
+			std::vector<int> active[2];
+			for (int i = 0; i < items.size(); ++i) {
+				const EdgeItem& item = items[i];
+				const Box& box = bodies[item.body]->boxes[item.edge];
+
+				// drop the edges of the other body which are left of this edge by more than the best distance
+				std::vector<int>& others = active[1 - item.body];
+				int num_others = 0;
+				for (int j = 0; j < others.size(); ++j) {
+					if (bodies[1 - item.body]->boxes[others[j]].maxPt.x + best < item.min_x) continue;
+					others[num_others++] = others[j];
+				}
+				others.resize(num_others);
+
+				for (int j = 0; j < others.size(); ++j) {
+					if (boxGap(box, bodies[1 - item.body]->boxes[others[j]]) > best) continue;
+
+					int e1 = item.body == 0 ? item.edge : others[j];
+					int e2 = item.body == 0 ? others[j] : item.edge;
+					double distance = segmentDistance(body1.points[e1], body1.points[(e1 + 1) % n1], body2.points[e2], body2.points[(e2 + 1) % n2], best, point1, point2);
+					if (distance < best) {
+						best = distance;
+						hint = std::make_pair(e1, e2);
+					}
+					if (best <= 0.0) return 0.0;
+				}
+
+				active[item.body].push_back(item.edge);
+			}
+
+			return best;
+		}
+
+		/**
+		 * Return the pairs of the boxes closer than the margin by sweep-and-prune along the x axis.
+		 */
+		std::vector<std::pair<int, int> > sweepAndPrune(const std::vector<Box>& boxes, double margin) {
+			std::vector<std::pair<double, int> > order(boxes.size());
+			for (int i = 0; i < boxes.size(); ++i) {
+				order[i] = std::make_pair(boxes[i].minPt.x, i);
+			}
+			std::sort(order.begin(), order.end());
+
+			std::vector<std::pair<int, int> > pairs;
+			for (int i = 0; i < order.size(); ++i) {
+				const Box& box = boxes[order[i].second];
+				for (int j = i + 1; j < order.size() && order[j].first <= box.maxPt.x + margin; ++j) {
+					if (boxGap(box, boxes[order[j].second]) > margin) continue;
+					pairs.push_back(std::make_pair(std::min(order[i].second, order[j].second), std::max(order[i].second, order[j].second)));
+				}
+			}
+			return pairs;
+		}
+
+		void addContact(const Body& body1, const Body& body2, int layer, double time, double distance, const glm::dvec2& point1, const glm::dvec2& point2, std::vector<CollisionAnalyzer::Contact>& contacts) {
+			CollisionAnalyzer::Contact contact;
+			contact.layer = layer;
+			contact.time = time;
+			contact.id1 = body1.id;
+			contact.id2 = body2.id;
+			contact.distance = distance;
+			contact.point1 = point1;
+			contact.point2 = point2;
+			interpolatePose(body1, time, contact.pos1, contact.theta1);
+			interpolatePose(body2, time, contact.pos2, contact.theta2);
+			contacts.push_back(contact);
+		}
+
+		/**
+		 * Check the bodies in the pose of the layer, and in the motion to the next layer.
+		 */
+		void analyzeLayer(LayerTask& task) {
+			std::vector<Body> bodies(task.shapes.size());
+			for (int i = 0; i < task.shapes.size(); ++i) {
+				buildBody(task.shapes[i], task.next_shapes[i], bodies[i]);
+			}
+
+			// the pose of the layer
+			std::vector<PosedBody> posed(bodies.size());
+			std::vector<Box> boxes(bodies.size());
+			for (int i = 0; i < bodies.size(); ++i) {
+				poseBody(bodies[i], bodies[i].pos[0], bodies[i].theta[0], posed[i]);
+				boxes[i] = posed[i].box;
+			}
+
+			std::set<std::pair<int, int> > violated;
+			std::vector<std::pair<int, int> > pairs = sweepAndPrune(boxes, task.clearance);
+			for (int i = 0; i < pairs.size(); ++i) {
+				glm::dvec2 point1, point2;
+				std::pair<int, int> hint(-1, -1);
+				double distance = bodyDistance(posed[pairs[i].first], posed[pairs[i].second], task.clearance, point1, point2, hint);
+				if (distance <= 0.0 || distance < task.clearance) {
+					addContact(bodies[pairs[i].first], bodies[pairs[i].second], task.layer, 0.0, distance, point1, point2, task.contacts);
+					violated.insert(pairs[i]);
+				}
+			}
+
+			// the motion to the next layer, where each body stays within the box swept by its bounding circle
+			for (int i = 0; i < bodies.size(); ++i) {
+				glm::dvec2 r(bodies[i].radius, bodies[i].radius);
+				boxes[i].minPt = glm::min(bodies[i].pos[0], bodies[i].pos[1]) - r;
+				boxes[i].maxPt = glm::max(bodies[i].pos[0], bodies[i].pos[1]) + r;
+			}
+			pairs = sweepAndPrune(boxes, task.clearance);
+			PosedBody posed1, posed2;
+			for (int i = 0; i < pairs.size(); ++i) {
+				const Body& body1 = bodies[pairs[i].first];
+				const Body& body2 = bodies[pairs[i].second];
+				if (!body1.has_next || !body2.has_next) continue;
+
+				// the pair which violates at the pose of the layer has already been reported
+				if (violated.find(pairs[i]) != violated.end()) continue;
+
+				double motion = motionBound(body1) + motionBound(body2);
+				if (motion <= 0.0) continue;
+
+				// advance by the time in which the distance can shrink to the clearance, but at least by MIN_TIME_STEP
+				double margin = task.clearance + motion * 0.25;
+				std::pair<int, int> hint(-1, -1);
+				double t = MIN_TIME_STEP;
+				while (t < 1.0) {
+					glm::dvec2 pos1, pos2;
+					double theta1, theta2;
+					interpolatePose(body1, t, pos1, theta1);
+					interpolatePose(body2, t, pos2, theta2);
+					poseBody(body1, pos1, theta1, posed1);
+					poseBody(body2, pos2, theta2, posed2);
+
+					glm::dvec2 point1, point2;
+					double distance = bodyDistance(posed1, posed2, margin, point1, point2, hint);
+					if (distance <= 0.0 || distance < task.clearance) {
+						addContact(body1, body2, task.layer, t, distance, point1, point2, task.contacts);
+						break;
+					}
+
+					t += std::max((distance - task.clearance) / motion, MIN_TIME_STEP);
+				}
+			}
+		}
+
+	}
+
+	/**
+	 * Analyze the bodies of the layers. The contacts are sorted by the layer.
+	 */
+	void CollisionAnalyzer::analyze(const std::vector<Layer>& layers, double clearance) {
+		contacts.clear();
+
+		// the shapes are looked up before the parallel analysis, since the lookup may update the index of the layer
+		std::vector<LayerTask> tasks(layers.size());
+		for (int i = 0; i < layers.size(); ++i) {
+			tasks[i].layer = i;
+			tasks[i].clearance = clearance;
+			for (int k = 0; k < layers[i].shapes.size(); ++k) {
+				if (layers[i].shapes[k]->getSubType() != Shape::TYPE_BODY) continue;
+
+				boost::shared_ptr<Shape> next_shape;
+				if (i + 1 < layers.size()) next_shape = layers[i + 1].findShape(layers[i].shapes[k]->getId());
+				tasks[i].shapes.push_back(layers[i].shapes[k]);
+				tasks[i].next_shapes.push_back(next_shape);
+			}
+		}
+
+		QtConcurrent::blockingMap(tasks, analyzeLayer);
+
+		for (int i = 0; i < tasks.size(); ++i) {
+			contacts.insert(contacts.end(), tasks[i].contacts.begin(), tasks[i].contacts.end());
+		}
+	}
+
+	/**
+	 * Return the number of the contacts where the bodies overlap. The others only violate the clearance.
+	 */
+	int CollisionAnalyzer::numOverlaps() const {
+		int count = 0;
+		for (int i = 0; i < contacts.size(); ++i) {
+			if (contacts[i].isOverlap()) count++;
+		}
+		return count;
+	}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Layer.h"
+
+namespace canvas {
+
+	/**
+	 * Find the bodies which overlap, or come closer than the clearance, in the poses of the layers and in the motion
+	 * between the consecutive layers.
+	 *
+	 * Each body is represented by the edges of its outline, which are moved by the pose of the body.
+	 * The analysis has three stages:
+	 * 1. Broadphase: sweep-and-prune on the bounding boxes of the bodies of each layer.
+	 * 2. Narrowphase: sweep-and-prune on the bounding boxes of the edges of two bodies, and the intersection test
+	 *    and the minimum distance of each pair of edges whose boxes are close to each other. A body inside the other
+	 *    is found by the point-in-polygon test.
+	 * 3. Continuous: the poses are interpolated between the consecutive layers as in the playback, and the time is
+	 *    advanced by the distance of the bodies divided by the bound of their relative displacement, but at least by
+	 *    MIN_TIME_STEP. This is not conservative: when the bodies are already close, the step is MIN_TIME_STEP, and a
+	 *    contact which lasts shorter than that (e.g., a sharp corner grazing another body) can be missed.
+	 * The layers are analyzed in parallel.
+	 */
+	class CollisionAnalyzer {
+	public:
+		struct Contact {
+			// the layer, or the first layer of the motion
+			int layer;
+			// 0 at the pose of the layer, or the time in (0, 1) of the motion to the next layer
+			double time;
+			int id1;
+			int id2;
+			// 0 if the bodies overlap
+			double distance;
+			// the closest points of the bodies in the world coordinate system
+			glm::dvec2 point1;
+			glm::dvec2 point2;
+			// the poses of the bodies at the contact
+			glm::dvec2 pos1;
+			double theta1;
+			glm::dvec2 pos2;
+			double theta2;
+
+			bool isOverlap() const { return distance <= 0.0; }
+		};
+
+	private:
+		std::vector<Contact> contacts;
+
+	public:
+		CollisionAnalyzer() {}
+
+		void analyze(const std::vector<Layer>& layers, double clearance);
+		void clear() { contacts.clear(); }
+		const std::vector<Contact>& getContacts() const { return contacts; }
+		int numOverlaps() const;
+	};
+
+}
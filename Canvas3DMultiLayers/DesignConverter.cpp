@@ -0,0 +1,119 @@
+#include "DesignConverter.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <iostream>
+#include "DesignFile.h"
+
+DesignConverter::DesignConverter() {
+	target = TO_OTHER;
+}
+
+/**
+ * Convert the design files specified by the command line arguments.
+ * Return the exit code of the application.
+ */
+int DesignConverter::run(const QStringList& arguments) {
+	QStringList files;
+	if (!parseArguments(arguments, files)) return 1;
+
+	int num_errors = 0;
+	for (int i = 0; i < files.size(); ++i) {
+		if (!convert(files[i])) num_errors++;
+	}
+
+	return num_errors > 0 ? 1 : 0;
+}
+
+bool DesignConverter::parseArguments(const QStringList& arguments, QStringList& files) {
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Convert the design files between the XML and the binary formats.");
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("convert", "Convert the design files."));
+	parser.addOption(QCommandLineOption("to", "Target format: binary or xml (the other format of each file by default).", "format"));
+	parser.addOption(QCommandLineOption("output", "Directory to write the converted files to (next to the original files by default).", "dir"));
+	parser.addPositionalArgument("files", "Design files or directories to convert.", "file_or_directory ...");
+	parser.process(arguments);
+
+	if (parser.isSet("to")) {
+		if (parser.value("to") == "binary") {
+			target = TO_BINARY;
+		}
+		else if (parser.value("to") == "xml") {
+			target = TO_XML;
+		}
+		else {
+			std::cerr << "Unknown format: " << parser.value("to").toUtf8().constData() << std::endl;
+			return false;
+		}
+	}
+	output_dir = parser.value("output");
+	if (!output_dir.isEmpty()) {
+		QDir().mkpath(output_dir);
+	}
+
+	for (int i = 0; i < parser.positionalArguments().size(); ++i) {
+		QString path = parser.positionalArguments()[i];
+		if (QFileInfo(path).isDir()) {
+			QStringList names;
+			if (target != TO_BINARY) names << "*.cdb";
+			if (target != TO_XML) names << "*.xml";
+			QStringList entries = QDir(path).entryList(names, QDir::Files, QDir::Name);
+			for (int k = 0; k < entries.size(); ++k) {
+				files.push_back(QDir(path).filePath(entries[k]));
+			}
+		}
+		else {
+			files.push_back(path);
+		}
+	}
+
+	if (files.empty()) {
+		std::cerr << "No design file is specified." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Convert the file, and print the sizes and the loading times of both formats.
+ */
+bool DesignConverter::convert(const QString& filename) {
+	QFileInfo info(filename);
+	bool binary = canvas::DesignFile::isBinary(filename);
+	bool to_binary = target == TO_BINARY || (target == TO_OTHER && !binary);
+	QString dir = output_dir.isEmpty() ? info.path() : output_dir;
+	QString output_file = QDir(dir).filePath(info.completeBaseName() + (to_binary ? ".cdb" : ".xml"));
+	if (QFileInfo(output_file).absoluteFilePath() == info.absoluteFilePath()) {
+		std::cerr << filename.toUtf8().constData() << ": already in the target format" << std::endl;
+		return true;
+	}
+
+	try {
+		QElapsedTimer timer;
+		timer.start();
+		std::vector<canvas::Layer> layers = canvas::DesignFile::load(filename);
+		double load_time = timer.nsecsElapsed() * 1e-6;
+
+		if (to_binary) {
+			canvas::DesignFile::saveBinary(output_file, layers);
+		}
+		else {
+			canvas::DesignFile::saveXml(output_file, layers);
+		}
+
+		timer.restart();
+		canvas::DesignFile::load(output_file);
+		double reload_time = timer.nsecsElapsed() * 1e-6;
+
+		printf("%s (%lld bytes, %.2f ms) -> %s (%lld bytes, %.2f ms)\n", filename.toUtf8().constData(), info.size(), load_time, output_file.toUtf8().constData(), QFileInfo(output_file).size(), reload_time);
+	}
+	catch (const char* ex) {
+		std::cerr << filename.toUtf8().constData() << ": " << ex << std::endl;
+		return false;
+	}
+
+	return true;
+}
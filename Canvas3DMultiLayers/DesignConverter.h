@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Command line tool which converts the design files between the XML and the binary formats.
+ *
+ * Usage: Canvas3DMultiLayers --convert [options] file_or_directory ...
+ *
+ * Each file is written next to the original (or into the output directory) with the other extension,
+ * i.e. ".xml" files are converted to ".cdb" and ".cdb" files to ".xml". For a directory, all the design
+ * files in it are converted, e.g. "--convert --to binary data" converts every XML file in data/.
+ */
+class DesignConverter {
+public:
+	static enum { TO_OTHER = 0, TO_BINARY, TO_XML };
+
+public:
+	int target;
+	QString output_dir;
+
+public:
+	DesignConverter();
+
+	int run(const QStringList& arguments);
+
+private:
+	bool parseArguments(const QStringList& arguments, QStringList& files);
+	bool convert(const QString& filename);
+};
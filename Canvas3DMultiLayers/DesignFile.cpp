@@ -0,0 +1,567 @@
+#include "DesignFile.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QDate>
+#include <cstring>
+#include "Rectangle.h"
+#include "Circle.h"
+#include "Polygon.h"
+
+namespace canvas {
+
+	namespace {
+
+		/**
+		 * Parameters of a shape read from the file.
+		 * A shape of the delta-encoded file has only its pose and the index of its geometry.
+		 */
+		struct ShapeRecord {
+			int type;
+			int subtype;
+			glm::dvec2 pos;
+			double theta;
+			double width;
+			double height;
+			std::vector<glm::dvec2> points;
+			int geometry;
+		};
+
+		struct BinaryHeader {
+			char magic[4];
+			quint32 version;
+			quint32 num_layers;
+			quint32 num_shapes;
+			quint32 num_points;
+			quint32 num_geometries;		// 0 in version 1
+			quint32 reserved[2];
+		};
+
+		struct BinaryLayer {
+			quint32 first_shape;
+			quint32 num_shapes;
+		};
+
+		// shape record of version 1
+		struct BinaryShape {
+			qint32 type;
+			qint32 subtype;
+			double x;
+			double y;
+			double theta;
+			double width;
+			double height;
+			quint32 first_point;
+			quint32 num_points;
+		};
+
+		struct BinaryGeometry {
+			qint32 type;
+			qint32 subtype;
+			double width;
+			double height;
+			quint32 first_point;
+			quint32 num_points;
+		};
+
+		struct BinaryPose {
+			quint32 geometry;
+			quint32 reserved;
+			double x;
+			double y;
+			double theta;
+		};
+
+		// the records are read in place from the file, so their layouts must not have any padding
+		static_assert(sizeof(BinaryHeader) == 32, "Unexpected size of BinaryHeader");
+		static_assert(sizeof(BinaryLayer) == 8, "Unexpected size of BinaryLayer");
+		static_assert(sizeof(BinaryShape) == 56, "Unexpected size of BinaryShape");
+		static_assert(sizeof(BinaryGeometry) == 32, "Unexpected size of BinaryGeometry");
+		static_assert(sizeof(BinaryPose) == 32, "Unexpected size of BinaryPose");
+		static_assert(sizeof(glm::dvec2) == 16, "Unexpected size of glm::dvec2");
+
+		const char binary_magic[4] = { 'C', 'D', 'B', '1' };
+
+		/**
+		 * Read a shape element. The reader has to be at the start of the element, and is moved to its end.
+		 */
+		ShapeRecord readShape(QXmlStreamReader& reader) {
+			ShapeRecord record;
+			QStringRef type = reader.attributes().value(QLatin1String("type"));
+			if (type == QLatin1String("rectangle")) record.type = Shape::TYPE_RECTANGLE;
+			else if (type == QLatin1String("circle")) record.type = Shape::TYPE_CIRCLE;
+			else if (type == QLatin1String("polygon")) record.type = Shape::TYPE_POLYGON;
+			else record.type = -1;
+			record.subtype = reader.attributes().value(QLatin1String("subtype")).toInt();
+			record.theta = 0;
+			record.width = 0;
+			record.height = 0;
+			record.geometry = -1;
+
+			while (reader.readNextStartElement()) {
+				QXmlStreamAttributes attributes = reader.attributes();
+				if (reader.name() == QLatin1String("pose")) {
+					record.pos.x = attributes.value(QLatin1String("x")).toDouble();
+					record.pos.y = attributes.value(QLatin1String("y")).toDouble();
+					record.theta = attributes.value(QLatin1String("theta")).toDouble();
+				}
+				else if (reader.name() == QLatin1String("params")) {
+					record.width = attributes.value(QLatin1String("width")).toDouble();
+					record.height = attributes.value(QLatin1String("height")).toDouble();
+				}
+				else if (reader.name() == QLatin1String("point")) {
+					record.points.push_back(glm::dvec2(attributes.value(QLatin1String("x")).toDouble(), attributes.value(QLatin1String("y")).toDouble()));
+				}
+				reader.skipCurrentElement();
+			}
+
+			return record;
+		}
+
+		/**
+		 * Read a pose element of the delta-encoded file, which refers to a shape of the geometry table.
+		 */
+		ShapeRecord readPose(QXmlStreamReader& reader, int num_geometries) {
+			QXmlStreamAttributes attributes = reader.attributes();
+
+			ShapeRecord record;
+			record.geometry = attributes.value(QLatin1String("shape")).toInt();
+			if (record.geometry < 0 || record.geometry >= num_geometries) throw "Invalid file format.";
+			record.pos.x = attributes.value(QLatin1String("x")).toDouble();
+			record.pos.y = attributes.value(QLatin1String("y")).toDouble();
+			record.theta = attributes.value(QLatin1String("theta")).toDouble();
+			reader.skipCurrentElement();
+
+			return record;
+		}
+
+		/**
+		 * Construct the shapes of a layer. The 3D geometry of the shapes is generated when it is used for the first time.
+		 * The polygons which refer to the same geometry share their points.
+		 */
+		void buildLayer(const std::vector<ShapeRecord>& records, const std::vector<ShapeRecord>& geometries, const std::vector<boost::shared_ptr<std::vector<glm::dvec2> > >& geometry_points, Layer& layer) {
+			layer.shapes.reserve(records.size());
+			for (int i = 0; i < records.size(); ++i) {
+				const ShapeRecord& record = records[i];
+				const ShapeRecord& geometry = record.geometry >= 0 ? geometries[record.geometry] : record;
+				if (geometry.type == Shape::TYPE_RECTANGLE) {
+					layer.shapes.push_back(boost::shared_ptr<Shape>(new Rectangle(geometry.subtype, record.pos, record.theta, geometry.width, geometry.height)));
+				}
+				else if (geometry.type == Shape::TYPE_CIRCLE) {
+					layer.shapes.push_back(boost::shared_ptr<Shape>(new Circle(geometry.subtype, record.pos, record.theta, geometry.width, geometry.height)));
+				}
+				else if (geometry.type == Shape::TYPE_POLYGON) {
+					if (record.geometry >= 0) {
+						layer.shapes.push_back(boost::shared_ptr<Shape>(new Polygon(geometry.subtype, record.pos, record.theta, geometry_points[record.geometry])));
+					}
+					else {
+						layer.shapes.push_back(boost::shared_ptr<Shape>(new Polygon(geometry.subtype, record.pos, record.theta, geometry.points.data(), geometry.points.size())));
+					}
+				}
+			}
+		}
+
+		/**
+		 * Make the corresponding shapes of the consecutive layers share the same geometry,
+		 * so that the layers loaded from a file without the delta encoding keep a single copy of it as well.
+		 */
+		void shareGeometry(std::vector<Layer>& layers) {
+			for (int i = 1; i < layers.size(); ++i) {
+				for (int k = 0; k < layers[i].shapes.size() && k < layers[i - 1].shapes.size(); ++k) {
+					layers[i].shapes[k]->shareGeometry(layers[i - 1].shapes[k]);
+				}
+			}
+		}
+
+		/**
+		 * Build the geometry table of the delta encoding.
+		 * A shape refers to the same geometry as the corresponding shape of the previous layer unless it differs.
+		 * Return the geometry index of each shape of each layer.
+		 */
+		std::vector<std::vector<int> > buildGeometryTable(const std::vector<Layer>& layers, std::vector<boost::shared_ptr<Shape> >& geometries) {
+			std::vector<std::vector<int> > indices(layers.size());
+			for (int i = 0; i < layers.size(); ++i) {
+				indices[i].resize(layers[i].shapes.size());
+				for (int k = 0; k < layers[i].shapes.size(); ++k) {
+					if (i > 0 && k < indices[i - 1].size() && layers[i].shapes[k]->hasSameGeometry(geometries[indices[i - 1][k]])) {
+						indices[i][k] = indices[i - 1][k];
+					}
+					else {
+						indices[i][k] = geometries.size();
+						geometries.push_back(layers[i].shapes[k]);
+					}
+				}
+			}
+			return indices;
+		}
+
+		QString toString(double value) {
+			return QString::number(value, 'g', 17);
+		}
+
+	}
+
+	/**
+	 * Load the layers from the design file. The format is detected from the content of the file.
+	 */
+	std::vector<Layer> DesignFile::load(const QString& filename, int* num_repaired) {
+		std::vector<Layer> layers;
+		if (isBinary(filename)) {
+			layers = loadBinary(filename);
+		}
+		else {
+			layers = loadXml(filename);
+		}
+
+		// the corresponding shapes of the layers share the same ID
+		Layer::assignIds(layers);
+
+		// the self-intersecting outlines are repaired before they are triangulated
+		int repaired = Layer::repairShapes(layers);
+		if (num_repaired != NULL) *num_repaired = repaired;
+
+		return layers;
+	}
+
+	/**
+	 * Save the layers to the design file. The binary format is used if the file has the extension ".cdb".
+	 */
+	void DesignFile::save(const QString& filename, const std::vector<Layer>& layers, QAtomicInt* progress) {
+		if (hasBinaryExtension(filename)) {
+			saveBinary(filename, layers, progress);
+		}
+		else {
+			saveXml(filename, layers, progress);
+		}
+	}
+
+	/**
+	 * Return true if the file starts with the magic number of the binary format.
+	 */
+	bool DesignFile::isBinary(const QString& filename) {
+		QFile file(filename);
+		if (!file.open(QFile::ReadOnly)) return false;
+
+		QByteArray magic = file.read(sizeof(binary_magic));
+		return magic.size() == sizeof(binary_magic) && memcmp(magic.constData(), binary_magic, sizeof(binary_magic)) == 0;
+	}
+
+	bool DesignFile::hasBinaryExtension(const QString& filename) {
+		return filename.endsWith(".cdb", Qt::CaseInsensitive);
+	}
+
+	/**
+	 * Load the layers from the XML design file.
+	 * The file is parsed in a single pass without building a DOM tree, and then the shapes of the layers
+	 * are constructed in parallel. The tessellation of the shapes is deferred until their 3D geometry is used.
+	 * Both the delta-encoded files (version 2.0) and the files which have full shapes in every layer (version 1.0) can be loaded.
+	 */
+	std::vector<Layer> DesignFile::loadXml(const QString& filename) {
+		QFile file(filename);
+		if (!file.open(QFile::ReadOnly)) throw "File cannot open.";
+
+		QXmlStreamReader reader(&file);
+		if (!reader.readNextStartElement() || reader.name() != QLatin1String("design")) throw "Invalid file format.";
+
+		std::vector<ShapeRecord> geometries;
+		std::vector<std::vector<ShapeRecord> > records;
+		while (reader.readNextStartElement()) {
+			if (reader.name() == QLatin1String("geometry")) {
+				while (reader.readNextStartElement()) {
+					if (reader.name() == QLatin1String("shape")) {
+						geometries.push_back(readShape(reader));
+					}
+					else {
+						reader.skipCurrentElement();
+					}
+				}
+			}
+			else if (reader.name() == QLatin1String("layer")) {
+				records.push_back(std::vector<ShapeRecord>());
+				while (reader.readNextStartElement()) {
+					if (reader.name() == QLatin1String("shape")) {
+						records.back().push_back(readShape(reader));
+					}
+					else if (reader.name() == QLatin1String("pose")) {
+						records.back().push_back(readPose(reader, geometries.size()));
+					}
+					else {
+						reader.skipCurrentElement();
+					}
+				}
+			}
+			else {
+				reader.skipCurrentElement();
+			}
+		}
+		if (reader.hasError()) throw "Invalid file format.";
+
+		// the points of each geometry are shared by all the polygons which refer to it
+		std::vector<boost::shared_ptr<std::vector<glm::dvec2> > > geometry_points(geometries.size());
+		for (int i = 0; i < geometries.size(); ++i) {
+			geometry_points[i] = boost::shared_ptr<std::vector<glm::dvec2> >(new std::vector<glm::dvec2>(geometries[i].points));
+		}
+
+		// constructing the shapes is only a few allocations per shape, since their 3D geometry is deferred,
+		// so the layers are built sequentially
+		std::vector<Layer> layers(records.size());
+		for (int i = 0; i < records.size(); ++i) {
+			buildLayer(records[i], geometries, geometry_points, layers[i]);
+		}
+
+		shareGeometry(layers);
+
+		return layers;
+	}
+
+	/**
+	 * Load the layers from the binary design file.
+	 * The file is mapped into memory, and the table and the pose records are read from the mapping without a stream.
+	 * The points are copied out of the mapping once per geometry, since the mapping is released when the file is closed.
+	 */
+	std::vector<Layer> DesignFile::loadBinary(const QString& filename) {
+		QFile file(filename);
+		if (!file.open(QFile::ReadOnly)) throw "File cannot open.";
+
+		qint64 size = file.size();
+		if (size < (qint64)sizeof(BinaryHeader)) throw "Invalid file format.";
+		const uchar* data = file.map(0, size);
+		if (data == NULL) throw "File cannot open.";
+
+		const BinaryHeader* header = reinterpret_cast<const BinaryHeader*>(data);
+		if (memcmp(header->magic, binary_magic, sizeof(binary_magic)) != 0) throw "Invalid file format.";
+		if (header->version > BINARY_VERSION) throw "Unsupported file version.";
+
+		// version 1 has the full shape records, while version 2 has the geometry table and the pose records
+		qint64 layers_offset = sizeof(BinaryHeader);
+		qint64 geometries_offset = layers_offset + (qint64)header->num_layers * sizeof(BinaryLayer);
+		qint64 shapes_offset = geometries_offset;
+		qint64 points_offset;
+		if (header->version == 1) {
+			points_offset = shapes_offset + (qint64)header->num_shapes * sizeof(BinaryShape);
+		}
+		else {
+			shapes_offset = geometries_offset + (qint64)header->num_geometries * sizeof(BinaryGeometry);
+			points_offset = shapes_offset + (qint64)header->num_shapes * sizeof(BinaryPose);
+		}
+		if (points_offset + (qint64)header->num_points * sizeof(glm::dvec2) > size) throw "Invalid file format.";
+
+		const BinaryLayer* layer_table = reinterpret_cast<const BinaryLayer*>(data + layers_offset);
+		const glm::dvec2* points = reinterpret_cast<const glm::dvec2*>(data + points_offset);
+
+		// the points of each geometry are shared by all the polygons which refer to it
+		const BinaryGeometry* geometries = reinterpret_cast<const BinaryGeometry*>(data + geometries_offset);
+		std::vector<boost::shared_ptr<std::vector<glm::dvec2> > > geometry_points(header->version == 1 ? 0 : header->num_geometries);
+		for (int i = 0; i < geometry_points.size(); ++i) {
+			if ((qint64)geometries[i].first_point + geometries[i].num_points > header->num_points) throw "Invalid file format.";
+			const glm::dvec2* first = points + geometries[i].first_point;
+			geometry_points[i] = boost::shared_ptr<std::vector<glm::dvec2> >(new std::vector<glm::dvec2>(first, first + geometries[i].num_points));
+		}
+
+		std::vector<Layer> layers(header->num_layers);
+		for (int i = 0; i < layers.size(); ++i) {
+			const BinaryLayer& layer_record = layer_table[i];
+			if ((qint64)layer_record.first_shape + layer_record.num_shapes > header->num_shapes) throw "Invalid file format.";
+
+			layers[i].shapes.reserve(layer_record.num_shapes);
+			for (int k = 0; k < layer_record.num_shapes; ++k) {
+				if (header->version == 1) {
+					const BinaryShape& record = reinterpret_cast<const BinaryShape*>(data + shapes_offset)[layer_record.first_shape + k];
+					glm::dvec2 pos(record.x, record.y);
+					if (record.type == Shape::TYPE_RECTANGLE) {
+						layers[i].shapes.push_back(boost::shared_ptr<Shape>(new Rectangle(record.subtype, pos, record.theta, record.width, record.height)));
+					}
+					else if (record.type == Shape::TYPE_CIRCLE) {
+						layers[i].shapes.push_back(boost::shared_ptr<Shape>(new Circle(record.subtype, pos, record.theta, record.width, record.height)));
+					}
+					else if (record.type == Shape::TYPE_POLYGON) {
+						if ((qint64)record.first_point + record.num_points > header->num_points) throw "Invalid file format.";
+						layers[i].shapes.push_back(boost::shared_ptr<Shape>(new Polygon(record.subtype, pos, record.theta, points + record.first_point, record.num_points)));
+					}
+					else {
+						throw "Invalid file format.";
+					}
+				}
+				else {
+					const BinaryPose& pose = reinterpret_cast<const BinaryPose*>(data + shapes_offset)[layer_record.first_shape + k];
+					if (pose.geometry >= header->num_geometries) throw "Invalid file format.";
+					const BinaryGeometry& geometry = geometries[pose.geometry];
+					glm::dvec2 pos(pose.x, pose.y);
+					if (geometry.type == Shape::TYPE_RECTANGLE) {
+						layers[i].shapes.push_back(boost::shared_ptr<Shape>(new Rectangle(geometry.subtype, pos, pose.theta, geometry.width, geometry.height)));
+					}
+					else if (geometry.type == Shape::TYPE_CIRCLE) {
+						layers[i].shapes.push_back(boost::shared_ptr<Shape>(new Circle(geometry.subtype, pos, pose.theta, geometry.width, geometry.height)));
+					}
+					else if (geometry.type == Shape::TYPE_POLYGON) {
+						layers[i].shapes.push_back(boost::shared_ptr<Shape>(new Polygon(geometry.subtype, pos, pose.theta, geometry_points[pose.geometry])));
+					}
+					else {
+						throw "Invalid file format.";
+					}
+				}
+			}
+		}
+
+		if (header->version == 1) {
+			shareGeometry(layers);
+		}
+
+		return layers;
+	}
+
+	/**
+	 * Save the layers to the XML design file.
+	 * The geometry of the shapes is written once in the geometry table, and each layer has only the poses of the shapes
+	 * and the indices of their geometries.
+	 */
+	void DesignFile::saveXml(const QString& filename, const std::vector<Layer>& layers, QAtomicInt* progress) {
+		QSaveFile file(filename);
+		if (!file.open(QFile::WriteOnly)) throw "File cannot open.";
+
+		std::vector<boost::shared_ptr<Shape> > geometries;
+		std::vector<std::vector<int> > indices = buildGeometryTable(layers, geometries);
+
+		QXmlStreamWriter writer(&file);
+		writer.setAutoFormatting(true);
+		writer.setAutoFormattingIndent(4);
+		writer.writeStartElement("design");
+		writer.writeAttribute("author", "Gen Nishida");
+		writer.writeAttribute("version", "2.0");
+		writer.writeAttribute("date", QDate::currentDate().toString("MM/dd/yyyy"));
+
+		// write the geometry table
+		writer.writeStartElement("geometry");
+		for (int i = 0; i < geometries.size(); ++i) {
+			writer.writeStartElement("shape");
+			writer.writeAttribute("subtype", QString::number(geometries[i]->getSubType()));
+			if (geometries[i]->getType() == Shape::TYPE_RECTANGLE) {
+				boost::shared_ptr<Rectangle> rectangle = boost::static_pointer_cast<Rectangle>(geometries[i]);
+				writer.writeAttribute("type", "rectangle");
+				writer.writeEmptyElement("params");
+				writer.writeAttribute("width", toString(rectangle->getWidth()));
+				writer.writeAttribute("height", toString(rectangle->getHeight()));
+			}
+			else if (geometries[i]->getType() == Shape::TYPE_CIRCLE) {
+				boost::shared_ptr<Circle> circle = boost::static_pointer_cast<Circle>(geometries[i]);
+				writer.writeAttribute("type", "circle");
+				writer.writeEmptyElement("params");
+				writer.writeAttribute("width", toString(circle->getWidth()));
+				writer.writeAttribute("height", toString(circle->getHeight()));
+			}
+			else if (geometries[i]->getType() == Shape::TYPE_POLYGON) {
+				const std::vector<glm::dvec2>& points = boost::static_pointer_cast<Polygon>(geometries[i])->getLocalPoints();
+				writer.writeAttribute("type", "polygon");
+				for (int k = 0; k < points.size(); ++k) {
+					writer.writeEmptyElement("point");
+					writer.writeAttribute("x", toString(points[k].x));
+					writer.writeAttribute("y", toString(points[k].y));
+				}
+			}
+			writer.writeEndElement();
+		}
+		writer.writeEndElement();
+
+		// write the poses of the layers
+		for (int i = 0; i < layers.size(); ++i) {
+			writer.writeStartElement("layer");
+			for (int k = 0; k < layers[i].shapes.size(); ++k) {
+				writer.writeEmptyElement("pose");
+				writer.writeAttribute("shape", QString::number(indices[i][k]));
+				writer.writeAttribute("x", toString(layers[i].shapes[k]->getPosition().x));
+				writer.writeAttribute("y", toString(layers[i].shapes[k]->getPosition().y));
+				writer.writeAttribute("theta", toString(layers[i].shapes[k]->getRotation()));
+			}
+			writer.writeEndElement();
+
+			if (progress != NULL) progress->store((i + 1) * 100 / layers.size());
+		}
+
+		writer.writeEndElement();
+		writer.writeEndDocument();
+
+		// replace the target file only if everything has been written
+		if (writer.hasError() || !file.commit()) throw "File cannot be written.";
+	}
+
+	/**
+	 * Save the layers to the binary design file in the delta encoding (version 2).
+	 */
+	void DesignFile::saveBinary(const QString& filename, const std::vector<Layer>& layers, QAtomicInt* progress) {
+		std::vector<boost::shared_ptr<Shape> > shapes;
+		std::vector<std::vector<int> > indices = buildGeometryTable(layers, shapes);
+
+		// geometry table
+		std::vector<BinaryGeometry> geometries(shapes.size());
+		std::vector<glm::dvec2> points;
+		for (int i = 0; i < shapes.size(); ++i) {
+			BinaryGeometry& geometry = geometries[i];
+			geometry.type = shapes[i]->getType();
+			geometry.subtype = shapes[i]->getSubType();
+			geometry.width = 0;
+			geometry.height = 0;
+			geometry.first_point = points.size();
+			geometry.num_points = 0;
+			if (shapes[i]->getType() == Shape::TYPE_RECTANGLE) {
+				boost::shared_ptr<Rectangle> rectangle = boost::static_pointer_cast<Rectangle>(shapes[i]);
+				geometry.width = rectangle->getWidth();
+				geometry.height = rectangle->getHeight();
+			}
+			else if (shapes[i]->getType() == Shape::TYPE_CIRCLE) {
+				boost::shared_ptr<Circle> circle = boost::static_pointer_cast<Circle>(shapes[i]);
+				geometry.width = circle->getWidth();
+				geometry.height = circle->getHeight();
+			}
+			else if (shapes[i]->getType() == Shape::TYPE_POLYGON) {
+				const std::vector<glm::dvec2>& polygon_points = boost::static_pointer_cast<Polygon>(shapes[i])->getLocalPoints();
+				points.insert(points.end(), polygon_points.begin(), polygon_points.end());
+				geometry.num_points = polygon_points.size();
+			}
+		}
+
+		// layer table and poses
+		std::vector<BinaryLayer> layer_table(layers.size());
+		std::vector<BinaryPose> poses;
+		for (int i = 0; i < layers.size(); ++i) {
+			layer_table[i].first_shape = poses.size();
+			layer_table[i].num_shapes = layers[i].shapes.size();
+
+			for (int k = 0; k < layers[i].shapes.size(); ++k) {
+				BinaryPose pose;
+				pose.geometry = indices[i][k];
+				pose.reserved = 0;
+				pose.x = layers[i].shapes[k]->getPosition().x;
+				pose.y = layers[i].shapes[k]->getPosition().y;
+				pose.theta = layers[i].shapes[k]->getRotation();
+				poses.push_back(pose);
+			}
+		}
+
+		BinaryHeader header;
+		memcpy(header.magic, binary_magic, sizeof(binary_magic));
+		header.version = BINARY_VERSION;
+		header.num_layers = layer_table.size();
+		header.num_shapes = poses.size();
+		header.num_points = points.size();
+		header.num_geometries = geometries.size();
+		memset(header.reserved, 0, sizeof(header.reserved));
+
+		if (progress != NULL) progress->store(50);
+
+		QSaveFile file(filename);
+		if (!file.open(QFile::WriteOnly)) throw "File cannot open.";
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!layer_table.empty()) file.write(reinterpret_cast<const char*>(layer_table.data()), layer_table.size() * sizeof(BinaryLayer));
+		if (!geometries.empty()) file.write(reinterpret_cast<const char*>(geometries.data()), geometries.size() * sizeof(BinaryGeometry));
+		if (!poses.empty()) file.write(reinterpret_cast<const char*>(poses.data()), poses.size() * sizeof(BinaryPose));
+		if (!points.empty()) file.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(glm::dvec2));
+
+		// replace the target file only if everything has been written
+		if (!file.commit()) throw "File cannot be written.";
+
+		if (progress != NULL) progress->store(100);
+	}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QAtomicInt>
+#include "Layer.h"
+
+namespace canvas {
+
+	/**
+	 * Reader and writer of the design files.
+	 * This does not depend on the widget, so that the designs can be loaded and saved without the GUI.
+	 *
+	 * Two formats are supported: XML, and a compact binary format whose files have the extension ".cdb".
+	 * Since the shapes of the same index correspond across the layers and usually differ only in their poses,
+	 * both formats store the geometry of the shapes once in a geometry table, and each layer as a table of
+	 * (geometry index, x, y, theta). A shape whose geometry differs from that of the previous layer simply
+	 * refers to another entry of the geometry table.
+	 *
+	 * The binary file consists of a header, a layer table, the geometry table, the pose records,
+	 * and a flat array of the polygon points, all in little endian:
+	 *
+	 *     header:    char magic[4] = "CDB1", uint32 version, uint32 num_layers, uint32 num_shapes, uint32 num_points, uint32 num_geometries, uint32 reserved[2]
+	 *     layer:     uint32 first_shape, uint32 num_shapes
+	 *     geometry:  int32 type, int32 subtype, double width, height, uint32 first_point, uint32 num_points
+	 *     pose:      uint32 geometry, uint32 reserved, double x, y, theta
+	 *     point:     double x, y
+	 *
+	 * The binary file is loaded by mapping it into memory, and the tables and the pose records are parsed from the mapped data.
+	 * The points are not used in place: the points of each geometry are copied out of the mapping into an array which is
+	 * shared by the polygons referring to it, and the mapping is released when the file has been loaded.
+	 * The files of the previous versions (XML 1.0 and binary version 1, which have the full shapes in every layer) can still be loaded.
+	 *
+	 * The files are written to a temporary file which replaces the target file only when it has been written completely,
+	 * so that the design is not corrupted by a crash during saving. The progress of saving is reported in percent
+	 * if a counter is given, so that the file can be saved by a worker thread while the UI shows the progress.
+	 */
+	class DesignFile {
+	public:
+		static const quint32 BINARY_VERSION = 2;
+
+	public:
+		static std::vector<Layer> load(const QString& filename, int* num_repaired = NULL);
+		static void save(const QString& filename, const std::vector<Layer>& layers, QAtomicInt* progress = NULL);
+		static bool isBinary(const QString& filename);
+		static bool hasBinaryExtension(const QString& filename);
+		static std::vector<Layer> loadXml(const QString& filename);
+		static std::vector<Layer> loadBinary(const QString& filename);
+		static void saveXml(const QString& filename, const std::vector<Layer>& layers, QAtomicInt* progress = NULL);
+		static void saveBinary(const QString& filename, const std::vector<Layer>& layers, QAtomicInt* progress = NULL);
+	};
+
+}
@@ -1,4 +1,5 @@
 ﻿#include "GLUtils.h"
+#include "Triangulator.h"
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -7,12 +8,14 @@
 #include <CGAL/point_generators_2.h>
 #include <CGAL/random_polygon_2.h>
 #include <CGAL/Polygon_2.h>
-#include <CGAL/create_offset_polygons_2.h>
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point_xy.hpp>
 #include <boost/geometry/geometries/ring.hpp>
+#include <boost/shared_ptr.hpp>
 #include <cassert>
 #include <list>
+#include <map>
+#include <mutex>
 
 namespace glutils {
 
@@ -24,9 +27,15 @@ typedef Polygon_2::Vertex_iterator                          Vertex_iterator;
 typedef std::list<Polygon_2>                                Polygon_list;
 typedef CGAL::Creator_uniform_2<int, Point_2>               Creator;
 typedef CGAL::Random_points_in_square_2< Point_2, Creator > Point_generator;
-typedef boost::shared_ptr<Polygon_2>						PolygonPtr;
 typedef boost::geometry::model::d2::point_xy<double>		point_2d;
 
+// tables of (cos, sin) per number of segments, and unit elliptic prisms per (number of segments, aspect ratio)
+// (the meshes of arbitrary aspect ratios are created while resizing, so the cache is flushed when it gets too large)
+static std::map<int, std::vector<glm::vec2> > unit_circle_tables;
+static std::map<std::pair<int, float>, boost::shared_ptr<const std::vector<Vertex> > > elliptic_prism_meshes;
+static const int MAX_CACHED_ELLIPTIC_PRISMS = 256;
+static std::mutex tessellation_mutex;
+
 BoundingBox::BoundingBox() {
 	minPt.x = (std::numeric_limits<float>::max)();
 	minPt.y = (std::numeric_limits<float>::max)();
@@ -195,38 +204,6 @@ float area(const std::vector<glm::vec2>& points) {
 	return boost::geometry::area(contour);
 }
 
-/**
- * Compute the offset polygon.
- */
-void offsetPolygon(const std::vector<glm::vec2>& points, float offsetDistance, std::vector<glm::vec2>& offset_points) {
-	offset_points.clear();
-
-	Polygon_2 poly;
-
-	for (int i = 0; i < points.size(); ++i) {
-		poly.push_back(K::Point_2(points[i].x, points[i].y));
-	}
-
-	std::vector<PolygonPtr> offset_poly;
-	if (offsetDistance >= 0) {
-		K::FT lOffset = offsetDistance;
-		offset_poly = CGAL::create_exterior_skeleton_and_offset_polygons_2(lOffset, poly);
-
-		for (auto it = offset_poly[1]->vertices_begin(); it != offset_poly[1]->vertices_end(); ++it) {
-			offset_points.push_back(glm::vec2(it->x(), it->y()));
-		}
-		std::reverse(offset_points.begin(), offset_points.end());
-	}
-	else {
-		K::FT lOffset = -offsetDistance;
-		offset_poly = CGAL::create_interior_skeleton_and_offset_polygons_2(lOffset, poly);
-
-		for (auto it = offset_poly[0]->vertices_begin(); it != offset_poly[0]->vertices_end(); ++it) {
-			offset_points.push_back(glm::vec2(it->x(), it->y()));
-		}
-	}
-}
-
 /*
  * Return the distance from segment ab to point c.
  */
@@ -339,6 +316,83 @@ glm::vec2 barycentricCoordinates(const glm::vec2& p1, const glm::vec2& p2, const
 	return glm::vec2(alpha, beta);
 }
 
+/**
+ * Return the number of segments to approximate a circle of the given radius such that
+ * the distance between each chord and the arc (the sagitta) does not exceed the tolerance.
+ */
+int circleSegments(float radius, float tolerance, int minSegments, int maxSegments) {
+	if (radius <= tolerance) return minSegments;
+
+	int segments = (int)ceil(M_PI / acos(1.0 - tolerance / radius));
+	return std::max(minSegments, std::min(maxSegments, segments));
+}
+
+/**
+ * Return the table of (cos, sin) of the angles which divide the unit circle into the given number of segments.
+ * Each table is computed only once, and the reference stays valid.
+ */
+const std::vector<glm::vec2>& unitCircle(int segments) {
+	std::lock_guard<std::mutex> lock(tessellation_mutex);
+
+	std::vector<glm::vec2>& table = unit_circle_tables[segments];
+	if (table.empty()) {
+		table.resize(segments);
+		for (int i = 0; i < segments; ++i) {
+			double theta = M_PI * 2.0 * i / segments;
+			table[i] = glm::vec2(cos(theta), sin(theta));
+		}
+	}
+
+	return table;
+}
+
+/**
+ * Create a prism of height 1 whose base is an ellipse with the radii 1 and aspect centered at the origin.
+ */
+static boost::shared_ptr<const std::vector<Vertex> > createUnitEllipticPrism(int slices, float aspect) {
+	const std::vector<glm::vec2>& table = unitCircle(slices);
+	glm::vec4 color(1, 1, 1, 1);
+	boost::shared_ptr<std::vector<Vertex> > mesh(new std::vector<Vertex>());
+	std::vector<Vertex>& vertices = *mesh;
+
+	// top face
+	for (int i = 0; i < slices; ++i) {
+		int next = (i + 1) % slices;
+		vertices.push_back(Vertex(glm::vec3(0, 0, 1), glm::vec3(0, 0, 1), color));
+		vertices.push_back(Vertex(glm::vec3(table[i].x, table[i].y * aspect, 1), glm::vec3(0, 0, 1), color, 1));
+		vertices.push_back(Vertex(glm::vec3(table[next].x, table[next].y * aspect, 1), glm::vec3(0, 0, 1), color, 1));
+	}
+
+	// bottom face
+	for (int i = 0; i < slices; ++i) {
+		int next = (i + 1) % slices;
+		vertices.push_back(Vertex(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), color));
+		vertices.push_back(Vertex(glm::vec3(table[next].x, table[next].y * aspect, 0), glm::vec3(0, 0, -1), color, 1));
+		vertices.push_back(Vertex(glm::vec3(table[i].x, table[i].y * aspect, 0), glm::vec3(0, 0, -1), color, 1));
+	}
+
+	// side faces (the normal of the ellipse at (cos t, a sin t) is proportional to (a cos t, sin t))
+	for (int i = 0; i < slices; ++i) {
+		int next = (i + 1) % slices;
+		glm::vec3 p1(table[i].x, table[i].y * aspect, 0);
+		glm::vec3 p2(table[next].x, table[next].y * aspect, 0);
+		glm::vec3 p3(table[next].x, table[next].y * aspect, 1);
+		glm::vec3 p4(table[i].x, table[i].y * aspect, 1);
+		glm::vec3 n1 = glm::normalize(glm::vec3(table[i].x * aspect, table[i].y, 0));
+		glm::vec3 n2 = glm::normalize(glm::vec3(table[next].x * aspect, table[next].y, 0));
+
+		vertices.push_back(Vertex(p1, n1, color));
+		vertices.push_back(Vertex(p2, n2, color, 1));
+		vertices.push_back(Vertex(p3, n2, color));
+
+		vertices.push_back(Vertex(p1, n1, color));
+		vertices.push_back(Vertex(p3, n2, color));
+		vertices.push_back(Vertex(p4, n1, color, 1));
+	}
+
+	return mesh;
+}
+
 void drawCircle(float r1, float r2, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices) {
 	glm::vec4 p1(0, 0, 0, 1);
 	glm::vec4 n(0, 0, 1, 0);
@@ -577,14 +631,13 @@ void drawPolygon(const std::vector<glm::vec2>& points, const glm::vec4& color, c
 	}
 }
 
-void drawConcavePolygon(const std::vector<glm::vec2>& points, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices) {
+/**
+ * Compute the texture coordinates of the points by dividing them by the maximum coordinates.
+ */
+static void planarTexCoords(const std::vector<glm::vec2>& points, std::vector<glm::vec2>& texCoords) {
 	float max_x = 0.0f;
 	float max_y = 0.0f;
-
-	Polygon_2 polygon;
 	for (int i = 0; i < points.size(); ++i) {
-		polygon.push_back(Point_2(points[i].x, points[i].y));
-
 		if (points[i].x > max_x) {
 			max_x = points[i].x;
 		}
@@ -593,28 +646,64 @@ void drawConcavePolygon(const std::vector<glm::vec2>& points, const glm::vec4& c
 		}
 	}
 
-	if (polygon.is_clockwise_oriented()) {
-		polygon.reverse_orientation();
+	texCoords.resize(points.size());
+	for (int i = 0; i < points.size(); ++i) {
+		texCoords[i] = glm::vec2(points[i].x / max_x, points[i].y / max_y);
 	}
-	
-	// tesselate the concave polygon
-	Polygon_list partition_polys;
-	Traits       partition_traits;
-	CGAL::greene_approx_convex_partition_2(polygon.vertices_begin(), polygon.vertices_end(), std::back_inserter(partition_polys), partition_traits);
+}
 
-	for (auto fit = partition_polys.begin(); fit != partition_polys.end(); ++fit) {
-		std::vector<glm::vec2> pts;
-		std::vector<glm::vec2> texCoords;
-		for (auto vit = fit->vertices_begin(); vit != fit->vertices_end(); ++vit) {
-			pts.push_back(glm::vec2(vit->x(), vit->y()));
-			texCoords.push_back(glm::vec2(vit->x() / max_x, vit->y() / max_y));
-		}
+/**
+ * Add the triangles of a planar polygon given by the indices of the points.
+ * The triangles face the positive z direction of the local coordinate system, so the normal is the z axis transformed by the matrix
+ * rather than computed from a triangle, which may be degenerate. If reversed is true, the triangles are flipped.
+ */
+static void drawTriangles(const std::vector<glm::vec2>& points, const std::vector<glm::vec2>& texCoords, const std::vector<unsigned int>& indices, bool reversed, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices) {
+	if (indices.empty()) return;
+
+	std::vector<glm::vec3> pts(points.size());
+	for (int i = 0; i < points.size(); ++i) {
+		pts[i] = glm::vec3(mat * glm::vec4(points[i], 0, 1));
+	}
+
+	int second = reversed ? 2 : 1;
+	int third = reversed ? 1 : 2;
+	glm::vec3 normal = glm::normalize(glm::mat3(mat) * glm::vec3(0, 0, reversed ? -1 : 1));
 
-		drawPolygon(pts, color, texCoords, mat, vertices);
+	for (int i = 0; i + 2 < indices.size(); i += 3) {
+		vertices.push_back(Vertex(pts[indices[i]], normal, color, texCoords[indices[i]]));
+		vertices.push_back(Vertex(pts[indices[i + second]], normal, color, texCoords[indices[i + second]]));
+		vertices.push_back(Vertex(pts[indices[i + third]], normal, color, texCoords[indices[i + third]]));
 	}
 }
 
+/**
+ * Triangulate the concave polygon by ear clipping.
+ * The triangles face the positive z direction regardless of the orientation of the points.
+ */
+void drawConcavePolygon(const std::vector<glm::vec2>& points, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices) {
+	std::vector<glm::vec2> texCoords;
+	planarTexCoords(points, texCoords);
+
+	drawConcavePolygon(points, color, texCoords, mat, vertices);
+}
+
 void drawConcavePolygon(const std::vector<glm::vec2>& points, const glm::vec4& color, const std::vector<glm::vec2>& texCoords, const glm::mat4& mat, std::vector<Vertex>& vertices) {
+	std::vector<unsigned int> indices;
+	Triangulator triangulator;
+	triangulator.triangulate(points, indices);
+
+	drawTriangles(points, texCoords, indices, false, color, mat, vertices);
+}
+
+/**
+ * Triangulate the polygon by the convex partition of CGAL and a fan in each convex piece,
+ * which is how the polygons were triangulated before Triangulator was introduced.
+ * This is kept only to compare the two in the benchmark. The triangles are stored as the triplets of points.
+ */
+void convexPartitionTriangles(const std::vector<glm::vec2>& points, std::vector<glm::vec2>& triangles) {
+	triangles.clear();
+	if (points.size() < 3) return;
+
 	Polygon_2 polygon;
 	for (int i = 0; i < points.size(); ++i) {
 		polygon.push_back(Point_2(points[i].x, points[i].y));
@@ -623,51 +712,22 @@ void drawConcavePolygon(const std::vector<glm::vec2>& points, const glm::vec4& c
 	if (polygon.is_clockwise_oriented()) {
 		polygon.reverse_orientation();
 	}
-		
-	// tesselate the concave polygon
+
 	Polygon_list partition_polys;
 	Traits       partition_traits;
 	CGAL::greene_approx_convex_partition_2(polygon.vertices_begin(), polygon.vertices_end(), std::back_inserter(partition_polys), partition_traits);
 
 	for (auto fit = partition_polys.begin(); fit != partition_polys.end(); ++fit) {
 		std::vector<glm::vec2> pts;
-		std::vector<glm::vec2> tex;
-
 		for (auto vit = fit->vertices_begin(); vit != fit->vertices_end(); ++vit) {
-			glm::vec2 pt(vit->x(), vit->y());
-			pts.push_back(pt);
-
-			// find the same point to get texture coordinates
-			bool found = false;
-			glm::vec2 texCoord;
-			for (int i = 0; i < points.size(); ++i) {
-				if (glm::length(points[i] - pt) < 0.01f) {
-					found = true;
-					texCoord = texCoords[i];
-				}
-			}
-
-			// if not, estimate the texture coordinates based on the three neighbors
-			if (!found) {
-				glm::vec2 p1 = points[0];
-				glm::vec2 t1 = texCoords[0];
-				glm::vec2 p2 = points[1];
-				glm::vec2 t2 = texCoords[1];
-				glm::vec2 p3 = points[2];
-				glm::vec2 t3 = texCoords[2];
-				if (glm::dot(glm::normalize(p2 - p1), glm::normalize(p3 - p2)) > 0.99f && points.size() > 3 && texCoords.size() > 3) {
-					p3 = points[3];
-					t3 = texCoords[3];
-				}
-
-				glm::vec2 bc = barycentricCoordinates(p1, p2, p3, pt);
-				texCoord = t1 * (1.0f - bc.x - bc.y) + t2 * bc.x + t3 * bc.y;
-			}
-
-			tex.push_back(texCoord);
+			pts.push_back(glm::vec2(vit->x(), vit->y()));
 		}
 
-		drawPolygon(pts, color, tex, mat, vertices);
+		for (int i = 1; i + 1 < pts.size(); ++i) {
+			triangles.push_back(pts[0]);
+			triangles.push_back(pts[i]);
+			triangles.push_back(pts[i + 1]);
+		}
 	}
 }
 
@@ -1000,13 +1060,18 @@ void drawPrism(std::vector<glm::vec2> points, float h, const glm::vec4& color, c
 		std::reverse(points.begin(), points.end());
 	}
 
+	// the top face and the bottom face share the triangulation
+	std::vector<unsigned int> indices;
+	Triangulator triangulator;
+	triangulator.triangulate(points, indices);
+	std::vector<glm::vec2> texCoords;
+	planarTexCoords(points, texCoords);
+
 	// top face
-	drawConcavePolygon(points, color, glm::translate(mat, glm::vec3(0, 0, h)), vertices);
+	drawTriangles(points, texCoords, indices, false, color, glm::translate(mat, glm::vec3(0, 0, h)), vertices);
 
 	// bottom face
-	std::vector<glm::vec2> reversed_points = points;
-	std::reverse(reversed_points.begin(), reversed_points.end());
-	drawConcavePolygon(reversed_points, color, mat, vertices);
+	drawTriangles(points, texCoords, indices, true, color, mat, vertices);
 
 	// side faces
 	for (int i = 0; i < points.size(); i++) {
@@ -1034,6 +1099,78 @@ void drawPrism(std::vector<glm::vec2> points, float h, const glm::vec4& color, c
 	}
 }
 
+/**
+ * Generate the input of the prism which is extruded from the polygon by the geometry shader.
+ * Each triangle of the cap is stored with z = 0, and each edge of the outline is stored as a degenerate triangle
+ * (p_i, p_i+1, p_i+1) with z = 1, so that the caps and the side walls are drawn by a single draw call.
+ * The points are made counter clockwise as drawPrism does, so that the side walls face outward.
+ */
+void buildExtrusion(std::vector<glm::vec2> points, std::vector<glm::vec3>& vertices) {
+	if (points.size() < 3) return;
+
+	// make the order of points counter clock wise order
+	double a = 0.0;
+	for (int i = 0; i < points.size(); i++) {
+		int next = (i + 1) % points.size();
+		a += (points[next].x - points[i].x) * (points[next].y + points[i].y);
+	}
+	if (a > 0) {
+		std::reverse(points.begin(), points.end());
+	}
+
+	// cap triangles
+	std::vector<unsigned int> indices;
+	Triangulator triangulator;
+	triangulator.triangulate(points, indices);
+	for (int i = 0; i < indices.size(); ++i) {
+		vertices.push_back(glm::vec3(points[indices[i]], 0));
+	}
+
+	// side edges
+	for (int i = 0; i < points.size(); i++) {
+		int next = (i + 1) % points.size();
+		vertices.push_back(glm::vec3(points[i], 1));
+		vertices.push_back(glm::vec3(points[next], 1));
+		vertices.push_back(glm::vec3(points[next], 1));
+	}
+}
+
+/**
+ * Draw a prism of height h whose base is an ellipse with the radii rx and ry centered at the origin.
+ * The vertices are ordered as drawPrism does, i.e., the top face, the bottom face, and then the side faces.
+ * The unit meshes are cached per number of slices and aspect ratio, and shared by all the ellipses without copying,
+ * so that only the scale and the matrix are applied to each ellipse to make its vertices in the world coordinate system.
+ */
+void drawEllipticPrism(float rx, float ry, float h, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices) {
+	float aspect = rx > 0 ? ry / rx : 1.0f;
+	std::pair<int, float> key(slices, aspect);
+
+	boost::shared_ptr<const std::vector<Vertex> > mesh;
+	{
+		std::lock_guard<std::mutex> lock(tessellation_mutex);
+		auto it = elliptic_prism_meshes.find(key);
+		if (it != elliptic_prism_meshes.end()) mesh = it->second;
+	}
+	if (!mesh) {
+		mesh = createUnitEllipticPrism(slices, aspect);
+
+		std::lock_guard<std::mutex> lock(tessellation_mutex);
+		if (elliptic_prism_meshes.size() >= MAX_CACHED_ELLIPTIC_PRISMS) {
+			elliptic_prism_meshes.clear();
+		}
+		elliptic_prism_meshes[key] = mesh;
+	}
+
+	// the scale does not change the directions of the normals, so only the matrix is applied to them
+	glm::mat4 m = glm::scale(mat, glm::vec3(rx, rx, h));
+	glm::mat3 normalMatrix(mat);
+	const std::vector<Vertex>& unit_mesh = *mesh;
+	vertices.reserve(vertices.size() + unit_mesh.size());
+	for (int i = 0; i < unit_mesh.size(); ++i) {
+		vertices.push_back(Vertex(glm::vec3(m * glm::vec4(unit_mesh[i].position, 1)), glm::normalize(normalMatrix * unit_mesh[i].normal), color, unit_mesh[i].drawEdge));
+	}
+}
+
 /**
  * Z軸方向に、指定された長さ、色、半径の矢印を描画する。
  */
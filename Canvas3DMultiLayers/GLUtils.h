@@ -53,7 +53,6 @@ namespace glutils {
 	// geometry computation
 	bool isWithinPolygon(const glm::vec2& p, const std::vector<glm::vec2>& points);
 	float area(const std::vector<glm::vec2>& points);
-	void offsetPolygon(const std::vector<glm::vec2>& points, float offsetDistance, std::vector<glm::vec2>& offset_points);
 	float distance(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, bool segmentOnly = false);
 	float distance(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
 	glm::vec3 lineLineIntersection(const glm::vec3& p1, const glm::vec3& v1, const glm::vec3& p2, const glm::vec3& v2, float weight1 = 0.5f, float weight2 = 0.5f);
@@ -61,6 +60,11 @@ namespace glutils {
 	bool rayTriangleIntersection(const glm::vec3& a, const glm::vec3& v, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, glm::vec3& intPt);
 	glm::vec2 barycentricCoordinates(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, const glm::vec2& p);
 
+	// tessellation
+	int circleSegments(float radius, float tolerance, int minSegments = 8, int maxSegments = 256);
+	const std::vector<glm::vec2>& unitCircle(int segments);
+	void convexPartitionTriangles(const std::vector<glm::vec2>& points, std::vector<glm::vec2>& triangles);
+
 	// mesh generation
 	void drawCircle(float r1, float r2, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices = 12);
 	void drawCircle(float r1, float r2, float texWidth, float texHeight, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices = 12);
@@ -80,6 +84,8 @@ namespace glutils {
 	void drawCylinderY(float radius1, float radius2, float h, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices = 12);
 	void drawCylinderZ(float radius1, float radius2, float radius3, float radius4, float h, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices = 12, bool top_face = true, bool bottom_face = true);
 	void drawPrism(std::vector<glm::vec2> points, float h, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices);
+	void buildExtrusion(std::vector<glm::vec2> points, std::vector<glm::vec3>& vertices);
+	void drawEllipticPrism(float rx, float ry, float h, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices, int slices);
 	void drawArrow(float radius, float length, const glm::vec4& color, const glm::mat4& mat, std::vector<Vertex>& vertices);
 	void drawAxes(float radius, float length, const glm::mat4& mat, std::vector<Vertex>& vertices);
 	void drawTube(std::vector<glm::vec3>& points, float radius, const glm::vec4& color, std::vector<Vertex>& vertices, int slices = 12);
@@ -4,8 +4,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <map>
+#include <set>
 #include "GLUtils.h"
 #include <QDir>
+#include <QCoreApplication>
 #include <QTextStream>
 #include <QDate>
 #include <iostream>
@@ -13,8 +15,48 @@
 #include "Rectangle.h"
 #include "Circle.h"
 #include "Polygon.h"
+#include "DesignFile.h"
+#include "Trace.h"
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QtConcurrent/QtConcurrent>
+#include <QFileInfo>
+#include <QStatusBar>
+#include <QMessageBox>
+
+namespace {
+
+	/**
+	 * Save the snapshot of the layers. This is called in the thread pool.
+	 * Return the error message, or an empty string if the file is saved successfully.
+	 */
+	QString saveDesign(const QString& filename, const std::vector<canvas::Layer>& layers, QAtomicInt* progress) {
+		try {
+			canvas::DesignFile::save(filename, layers, progress);
+		}
+		catch (const char* ex) {
+			return QString(ex);
+		}
+		return QString();
+	}
 
-GLWidget3D::GLWidget3D(MainWindow *parent) : QGLWidget(QGLFormat(QGL::SampleBuffers)) {
+	/**
+	 * Generate the deferred 3D geometry of the shape. This is called in the thread pool.
+	 */
+	void ensure3DGeometry(boost::shared_ptr<canvas::Shape>& shape) {
+		shape->ensure3DGeometry();
+	}
+
+	/**
+	 * Return the 3D transform of the pose of a shape in the XY plane.
+	 */
+	glm::mat4 poseMatrix(const glm::dvec2& pos, double theta) {
+		return glm::rotate(glm::translate(glm::mat4(), glm::vec3(pos.x, pos.y, 0)), (float)theta, glm::vec3(0, 0, 1));
+	}
+
+}
+
+GLWidget3D::GLWidget3D(MainWindow *parent) : QGLWidget(QGLFormat(QGL::SampleBuffers)), journal_lock(journalFilename() + ".lock") {
 	this->mainWin = parent;
 	ctrlPressed = false;
 	shiftPressed = false;
@@ -27,276 +69,134 @@ GLWidget3D::GLWidget3D(MainWindow *parent) : QGLWidget(QGLFormat(QGL::SampleBuff
 	layer_id = 0;
 	current_shape.reset();
 	operation.reset();
+	background_layers_outdated = true;
+	background_layers_scale = 0.0;
 
 	// This is necessary to prevent the screen overdrawn by OpenGL
 	setAutoFillBackground(false);
 
 	// 光源位置をセット
 	// ShadowMappingは平行光源を使っている。この位置から原点方向を平行光源の方向とする。
-	light_dir = glm::normalize(glm::vec3(-4, -5, -8));
+	light_dir = RenderManager::defaultLightDir();
 
 	// シャドウマップ用のmodel/view/projection行列を作成
-	glm::mat4 light_pMatrix = glm::ortho<float>(-50, 50, -50, 50, 0.1, 200);
-	glm::mat4 light_mvMatrix = glm::lookAt(-light_dir * 50.0f, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-	light_mvpMatrix = light_pMatrix * light_mvMatrix;
-}
-
-/**
-* Draw the scene.
-*/
-void GLWidget3D::drawScene() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
-	glDepthMask(true);
-
-	renderManager.renderAll();
-}
-
-void GLWidget3D::render() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glMatrixMode(GL_MODELVIEW);
-
-	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-	// PASS 1: Render to texture
-	glUseProgram(renderManager.programs["pass1"]);
-	
-	glBindFramebuffer(GL_FRAMEBUFFER, renderManager.fragDataFB);
-	glClearColor(1, 1, 1, 1);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderManager.fragDataTex[0], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, renderManager.fragDataTex[1], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, renderManager.fragDataTex[2], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, renderManager.fragDataTex[3], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, renderManager.fragDepthTex, 0);
-
-	// Set the list of draw buffers.
-	GLenum DrawBuffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
-	glDrawBuffers(4, DrawBuffers); // "3" is the size of DrawBuffers
-	// Always check that our framebuffer is ok
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		printf("+ERROR: GL_FRAMEBUFFER_COMPLETE false\n");
-		exit(0);
-	}
-
-	glUniformMatrix4fv(glGetUniformLocation(renderManager.programs["pass1"], "mvpMatrix"), 1, false, &camera.mvpMatrix[0][0]);
-	glUniform3f(glGetUniformLocation(renderManager.programs["pass1"], "lightDir"), light_dir.x, light_dir.y, light_dir.z);
-	glUniformMatrix4fv(glGetUniformLocation(renderManager.programs["pass1"], "light_mvpMatrix"), 1, false, &light_mvpMatrix[0][0]);
-
-	glUniform1i(glGetUniformLocation(renderManager.programs["pass1"], "shadowMap"), 6);
-	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, renderManager.shadow.textureDepth);
-
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
-	drawScene();
-	
-	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-	// PASS 2: Create AO
-	if (renderManager.renderingMode == RenderManager::RENDERING_MODE_SSAO) {
-		glUseProgram(renderManager.programs["ssao"]);
-		glBindFramebuffer(GL_FRAMEBUFFER, renderManager.fragDataFB_AO);
-
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderManager.fragAOTex, 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, renderManager.fragDepthTex_AO, 0);
-		GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
-		glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
-
-		glClearColor(1, 1, 1, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Always check that our framebuffer is ok
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			printf("++ERROR: GL_FRAMEBUFFER_COMPLETE false\n");
-			exit(0);
+	light_mvpMatrix = RenderManager::lightMvpMatrixFor(light_dir);
+
+	// report the progress and the result of saving in the status bar
+	save_progress_timer.setInterval(100);
+	connect(&save_progress_timer, &QTimer::timeout, [this]() {
+		mainWin->statusBar()->showMessage(QString("Saving %1... %2%").arg(saving_filename).arg(save_progress.load()));
+	});
+	connect(&save_watcher, &QFutureWatcher<QString>::finished, [this]() {
+		save_progress_timer.stop();
+		QString error = save_watcher.result();
+		if (error.isEmpty()) {
+			mainWin->statusBar()->showMessage(QString("Saved %1").arg(saving_filename), 3000);
+
+			// the saved file becomes the base of the journal
+			journal.rebase(save_journal_base, save_journal_layers, save_journal_position, save_journal_generation);
 		}
-
-		glDisable(GL_DEPTH_TEST);
-		glDepthFunc(GL_ALWAYS);
-
-		glUniform2f(glGetUniformLocation(renderManager.programs["ssao"], "pixelSize"), 2.0f / this->width(), 2.0f / this->height());
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "tex0"), 1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[0]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "tex1"), 2);
-		glActiveTexture(GL_TEXTURE2);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[1]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "tex2"), 3);
-		glActiveTexture(GL_TEXTURE3);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[2]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "depthTex"), 8);
-		glActiveTexture(GL_TEXTURE8);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDepthTex);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "noiseTex"), 7);
-		glActiveTexture(GL_TEXTURE7);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragNoiseTex);
-
-		{
-			glUniformMatrix4fv(glGetUniformLocation(renderManager.programs["ssao"], "mvpMatrix"), 1, false, &camera.mvpMatrix[0][0]);
-			glUniformMatrix4fv(glGetUniformLocation(renderManager.programs["ssao"], "pMatrix"), 1, false, &camera.pMatrix[0][0]);
+		else {
+			mainWin->statusBar()->showMessage(QString("Failed to save %1: %2").arg(saving_filename).arg(error));
 		}
+		save_journal_layers.clear();
 
-		glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "uKernelSize"), renderManager.uKernelSize);
-		glUniform3fv(glGetUniformLocation(renderManager.programs["ssao"], "uKernelOffsets"), renderManager.uKernelOffsets.size(), (const GLfloat*)renderManager.uKernelOffsets.data());
-
-		glUniform1f(glGetUniformLocation(renderManager.programs["ssao"], "uPower"), renderManager.uPower);
-		glUniform1f(glGetUniformLocation(renderManager.programs["ssao"], "uRadius"), renderManager.uRadius);
-
-		glBindVertexArray(renderManager.secondPassVAO);
-
-		glDrawArrays(GL_QUADS, 0, 4);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LEQUAL);
-	}
-	else if (renderManager.renderingMode == RenderManager::RENDERING_MODE_LINE || renderManager.renderingMode == RenderManager::RENDERING_MODE_HATCHING || renderManager.renderingMode == RenderManager::RENDERING_MODE_SKETCHY) {
-		glUseProgram(renderManager.programs["line"]);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(1, 1, 1, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glDisable(GL_DEPTH_TEST);
-		glDepthFunc(GL_ALWAYS);
-
-		glUniform2f(glGetUniformLocation(renderManager.programs["line"], "pixelSize"), 1.0f / this->width(), 1.0f / this->height());
-		glUniformMatrix4fv(glGetUniformLocation(renderManager.programs["line"], "pMatrix"), 1, false, &camera.pMatrix[0][0]);
-		if (renderManager.renderingMode == RenderManager::RENDERING_MODE_HATCHING) {
-			glUniform1i(glGetUniformLocation(renderManager.programs["line"], "useHatching"), 1);
+		// start the save requested while this one was being written
+		if (!pending_save_filename.isEmpty()) {
+			QString filename = pending_save_filename;
+			pending_save_filename.clear();
+			save(filename);
 		}
-		else {
-			glUniform1i(glGetUniformLocation(renderManager.programs["line"], "useHatching"), 0);
+	});
+
+	// sync the journal to the disk in batches, and recover the design of the previous session after the first paint
+	journal_flush_timer.setInterval(1000);
+	journal_flush_timer.setSingleShot(true);
+	connect(&journal_flush_timer, &QTimer::timeout, [this]() {
+		journal.flush();
+	});
+	journal_lock.setStaleLockTime(0);
+	journal_lock.tryLock(0);
+	journal_recover_timer.setInterval(0);
+	journal_recover_timer.setSingleShot(true);
+	connect(&journal_recover_timer, &QTimer::timeout, [this]() {
+		recoverJournal();
+	});
+
+	// advance the playback of the poses at the display rate
+	animation_time = 0.0;
+	animation_speed = 1.0;
+	animation_posed = false;
+	animation_timer.setInterval(16);
+	animation_timer.setTimerType(Qt::PreciseTimer);
+	connect(&animation_timer, &QTimer::timeout, [this]() {
+		double duration = layers.size() - 1;
+		if (duration <= 0) {
+			stopAnimation();
+			return;
 		}
 
-		glUniform1i(glGetUniformLocation(renderManager.programs["line"], "tex0"), 1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[0]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["line"], "tex1"), 2);
-		glActiveTexture(GL_TEXTURE2);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[1]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["line"], "tex2"), 3);
-		glActiveTexture(GL_TEXTURE3);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[2]);
+		animation_time = fmod(animation_time + animation_clock.restart() * 0.001 * animation_speed, duration);
+		updateAnimation();
+		mainWin->updateAnimationControls(animation_time / duration, true);
+	});
 
-		glUniform1i(glGetUniformLocation(renderManager.programs["line"], "tex3"), 4);
-		glActiveTexture(GL_TEXTURE4);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[3]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["line"], "depthTex"), 8);
-		glActiveTexture(GL_TEXTURE8);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDepthTex);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["line"], "hatchingTexture"), 5);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_3D, renderManager.hatchingTextures);
-		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-		
-		glBindVertexArray(renderManager.secondPassVAO);
+	simplify_tolerance = 0.0;
+	show_collisions = false;
+	clearance = 0.0;
+	analyzed_clearance = 0.0;
+}
 
-		glDrawArrays(GL_QUADS, 0, 4);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LEQUAL);
+GLWidget3D::~GLWidget3D() {
+	// do not lose the design being saved, nor the one waiting to be saved
+	save_watcher.waitForFinished();
+	if (!pending_save_filename.isEmpty()) {
+		std::vector<canvas::Layer> snapshot(layers.size());
+		for (int i = 0; i < layers.size(); ++i) {
+			snapshot[i] = layers[i].cloneOutlines();
+		}
+		saveDesign(pending_save_filename, snapshot, &save_progress);
 	}
-	else if (renderManager.renderingMode == RenderManager::RENDERING_MODE_CONTOUR) {
-		glUseProgram(renderManager.programs["contour"]);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(1, 1, 1, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	journal.flush();
 
-		glDisable(GL_DEPTH_TEST);
-		glDepthFunc(GL_ALWAYS);
-
-		glUniform2f(glGetUniformLocation(renderManager.programs["contour"], "pixelSize"), 1.0f / this->width(), 1.0f / this->height());
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["contour"], "depthTex"), 8);
-		glActiveTexture(GL_TEXTURE8);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDepthTex);
-
-		glBindVertexArray(renderManager.secondPassVAO);
+	// the OpenGL objects of the members are deleted in their destructors, which need the context to be current
+	makeCurrent();
+}
 
-		glDrawArrays(GL_QUADS, 0, 4);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LEQUAL);
+/**
+ * Draw the grid of the 2D editor over the whole screen.
+ * The grid lines are computed in the fragment shader, so the grid has no bound, and
+ * the spacing is increased when zooming out so that the lines do not get too dense.
+ */
+void GLWidget3D::drawGrid() {
+	// the grid spacing is 5 in the world coordinate system, and is multiplied by 5 until the cells get at least 8 pixels wide
+	double cell_size = 5 * scale();
+	while (cell_size < 8) {
+		cell_size *= 5;
 	}
 
-	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-	// Blur
-
-	if (renderManager.renderingMode == RenderManager::RENDERING_MODE_BASIC || renderManager.renderingMode == RenderManager::RENDERING_MODE_SSAO) {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(1, 1, 1, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glDisable(GL_DEPTH_TEST);
-		glDepthFunc(GL_ALWAYS);
-
-		glUseProgram(renderManager.programs["blur"]);
-		glUniform2f(glGetUniformLocation(renderManager.programs["blur"], "pixelSize"), 2.0f / this->width(), 2.0f / this->height());
-		//printf("pixelSize loc %d\n", glGetUniformLocation(vboRenderManager.programs["blur"], "pixelSize"));
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "tex0"), 1);//COLOR
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[0]);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "tex1"), 2);//NORMAL
-		glActiveTexture(GL_TEXTURE2);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[1]);
+	// screen position of the grid intersection closest to the top-left corner of the screen
+	glm::dvec2 origin = worldToScreenCoordinates(glm::dvec2(0, 0));
+	glm::dvec2 offset(origin.x - floor(origin.x / cell_size) * cell_size, origin.y - floor(origin.y / cell_size) * cell_size);
 
-		/*glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "tex2"), 3);
-		glActiveTexture(GL_TEXTURE3);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDataTex[2]);*/
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "depthTex"), 8);
-		glActiveTexture(GL_TEXTURE8);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragDepthTex);
-
-		glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "tex3"), 4);//AO
-		glActiveTexture(GL_TEXTURE4);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, renderManager.fragAOTex);
-
-		if (renderManager.renderingMode == RenderManager::RENDERING_MODE_SSAO) {
-			glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "ssao_used"), 1); // ssao used
-		}
-		else {
-			glUniform1i(glGetUniformLocation(renderManager.programs["blur"], "ssao_used"), 0); // no ssao
-		}
+	glUseProgram(renderManager.programs["grid"]);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-		glBindVertexArray(renderManager.secondPassVAO);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-		glDrawArrays(GL_QUADS, 0, 4);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LEQUAL);
+	glUniform2f(glGetUniformLocation(renderManager.programs["grid"], "viewportSize"), width(), height());
+	glUniform2f(glGetUniformLocation(renderManager.programs["grid"], "offset"), offset.x, offset.y);
+	glUniform1f(glGetUniformLocation(renderManager.programs["grid"], "cellSize"), cell_size);
+	glUniform4f(glGetUniformLocation(renderManager.programs["grid"], "lineColor"), 224 / 255.0f, 224 / 255.0f, 224 / 255.0f, 1.0f);
 
-	}
+	glBindVertexArray(renderManager.secondPassVAO);
+	glDrawArrays(GL_QUADS, 0, 4);
+	glBindVertexArray(0);
 
-	// REMOVE
-	glActiveTexture(GL_TEXTURE0);
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
 }
 
 void GLWidget3D::clear() {
@@ -304,9 +204,14 @@ void GLWidget3D::clear() {
 		layers[i].clear();
 	}
 	selected_shape.reset();
+	invalidateBackgroundLayers();
+
+	// start the journal of a new design
+	journal.start(journalFilename(), "", layers);
 
 	// update 3D geometry
 	update3DGeometry();
+	updateCollisions();
 
 	update();
 }
@@ -326,13 +231,15 @@ void GLWidget3D::unselectAll() {
 }
 
 void GLWidget3D::deleteSelectedShapes() {
-	for (int i = layers[layer_id].shapes.size() - 1; i >= 0; --i) {
-		if (layers[layer_id].shapes[i]->isSelected()) {
-			for (int l = 0; l < layers.size(); l++) {
-				layers[l].shapes.erase(layers[l].shapes.begin() + i);
-			}
-		}
+	QSet<int> ids;
+	for (int i = 0; i < layers[layer_id].shapes.size(); ++i) {
+		if (layers[layer_id].shapes[i]->isSelected()) ids.insert(layers[layer_id].shapes[i]->getId());
 	}
+	for (int l = 0; l < layers.size(); l++) {
+		layers[l].removeShapes(ids);
+	}
+	journalEdit();
+	invalidateBackgroundLayers();
 
 	// update 3D geometry
 	update3DGeometry();
@@ -344,6 +251,8 @@ void GLWidget3D::deleteSelectedShapes() {
 void GLWidget3D::undo() {
 	try {
 		layers = history.undo();
+		journalEdit();
+		invalidateBackgroundLayers();
 
 		// update 3D geometry
 		update3DGeometry();
@@ -357,6 +266,8 @@ void GLWidget3D::undo() {
 void GLWidget3D::redo() {
 	try {
 		layers = history.redo();
+		journalEdit();
+		invalidateBackgroundLayers();
 
 		// update 3D geometry
 		update3DGeometry();
@@ -378,6 +289,7 @@ void GLWidget3D::copySelectedShapes() {
 
 void GLWidget3D::pasteCopiedShapes() {
 	layers[layer_id].pasteCopiedShapes(copied_shapes);
+	journalEdit();
 	
 	// update 3D geometry
 	update3DGeometry();
@@ -398,22 +310,30 @@ void GLWidget3D::setMode(int mode) {
 
 void GLWidget3D::addLayer() {
 	layers.push_back(layers.back().clone());
+	journalEdit();
 	setLayer(layers.size() - 1);
 }
 
 void GLWidget3D::insertLayer() {
 	layers.insert(layers.begin() + layer_id, layers[layer_id].clone());
+	journalEdit();
+
+	// the following layers are shifted, so their shadow maps do not match any more
+	renderManager.shadow.invalidate();
 	setLayer(layer_id);
 }
 
 void GLWidget3D::deleteLayer() {
-	// we assume that there must be at least two layers.
-	if (layers.size() <= 2) return;
+	if ((int)layers.size() <= MIN_NUM_LAYERS) return;
 
 	layers.erase(layers.begin() + layer_id);
 	if (layer_id >= layers.size()) {
 		layer_id--;
 	}
+	journalEdit();
+
+	// the following layers are shifted, so their shadow maps do not match any more
+	renderManager.shadow.invalidate();
 	setLayer(layer_id);
 }
 
@@ -421,9 +341,11 @@ void GLWidget3D::setLayer(int layer_id) {
 	layers[this->layer_id].unselectAll();
 	this->layer_id = layer_id;
 	current_shape.reset();
+	if (!isAnimating()) animation_time = layer_id;
+	invalidateBackgroundLayers();
 
-	// update 3D geometry
-	update3DGeometry();
+	// switch the 3D geometry to the layer
+	showLayerGeometry();
 
 	// change the mode to SELECT
 	setMode(MODE_SELECT);
@@ -431,38 +353,151 @@ void GLWidget3D::setLayer(int layer_id) {
 	update();
 }
 
+/**
+ * Start playing the motion of the shapes through the layers from the current time of the timeline.
+ */
+void GLWidget3D::startAnimation() {
+	if (layers.size() < 2) {
+		mainWin->updateAnimationControls(0, false);
+		return;
+	}
 
-void GLWidget3D::open(const QString& filename) {
-	QFile file(filename);
-	if (!file.open(QFile::ReadOnly | QFile::Text)) throw "File cannot open.";
+	animation_clock.start();
+	animation_timer.start();
+}
 
-	QDomDocument doc;
-	doc.setContent(&file);
+/**
+ * Stop the playback, and show the shapes at the poses of the active layer again so that they can be edited.
+ */
+void GLWidget3D::stopAnimation() {
+	animation_timer.stop();
+	animation_time = layer_id;
+	animation_posed = false;
+
+	updateObjectTransforms();
+	renderManager.updateShadowMap(light_dir, light_mvpMatrix);
+	update();
 
-	QDomElement root = doc.documentElement();
-	if (root.tagName() != "design")	throw "Invalid file format.";
+	if (layers.size() > 1) {
+		mainWin->updateAnimationControls((double)layer_id / (layers.size() - 1), false);
+	}
+	else {
+		mainWin->updateAnimationControls(0, false);
+	}
+}
 
-	// clear the data
-	layers.clear();
-	selected_shape.reset();
-	mode = MODE_SELECT;
+bool GLWidget3D::isAnimating() const {
+	return animation_timer.isActive();
+}
 
-	QDomNode layer_node = root.firstChild();
-	while (!layer_node.isNull()) {
-		if (layer_node.toElement().tagName() == "layer") {
-			canvas::Layer layer;
-			layer.load(layer_node.toElement());
-			layers.push_back(layer);
-		}
+/**
+ * Show the poses at the specified time of the timeline, which is used to scrub the timeline.
+ */
+void GLWidget3D::setAnimationTime(double time) {
+	if (layers.size() < 2) return;
+
+	animation_time = std::max(0.0, std::min(time, (double)layers.size() - 1));
+	updateAnimation();
+}
+
+/**
+ * Set the speed of the playback in layers per second.
+ */
+void GLWidget3D::setAnimationSpeed(double speed) {
+	animation_speed = speed;
+}
+
+/**
+ * Move the body shapes to the poses interpolated between the consecutive layers at the current time of the playback.
+ * The meshes of the active layer are reused and only their instance transforms are updated, so nothing is tessellated
+ * or uploaded to the GPU while playing.
+ */
+void GLWidget3D::updateAnimation() {
+	TRACE_SCOPE("GLWidget3D::updateAnimation");
+
+	QElapsedTimer timer;
+	timer.start();
+
+	int layer0 = std::min((int)animation_time, (int)layers.size() - 1);
+	int layer1 = std::min(layer0 + 1, (int)layers.size() - 1);
+	double t = animation_time - layer0;
+
+	for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
+		const boost::shared_ptr<canvas::Shape>& shape = layers[layer_id].shapes[i];
+		if (shape->getSubType() != canvas::Shape::TYPE_BODY) continue;
+
+		boost::shared_ptr<canvas::Shape> shape0 = layers[layer0].findShape(shape->getId());
+		boost::shared_ptr<canvas::Shape> shape1 = layers[layer1].findShape(shape->getId());
+		if (!shape0 || !shape1) continue;
+
+		// rotate along the shorter arc
+		double dtheta = shape1->getRotation() - shape0->getRotation();
+		dtheta = atan2(sin(dtheta), cos(dtheta));
+		glm::dvec2 pos = shape0->getPosition() + (shape1->getPosition() - shape0->getPosition()) * t;
+		double theta = shape0->getRotation() + dtheta * t;
+
+		renderManager.setObjectTransform(QString("object_%1").arg(shape->getId()), poseTransform(shape->getId(), pos, theta));
+	}
+	animation_posed = true;
+
+	// update shadow map, which must not be reused as the one of the active layer
+	renderManager.updateShadowMap(light_dir, light_mvpMatrix);
+	renderManager.shadow.invalidate(layer_id);
+
+	renderManager.profiler.addCPUTime(RenderProfiler::CPU_GEOMETRY, timer.nsecsElapsed() * 1e-6);
+	update();
+}
+
+
+void GLWidget3D::open(const QString& filename) {
+	int num_repaired = 0;
+	std::vector<canvas::Layer> loaded_layers = canvas::DesignFile::load(filename, &num_repaired);
+
+	// the journal starts on the content of the file
+	std::vector<canvas::Layer> base_layers(loaded_layers.size());
+	for (int i = 0; i < loaded_layers.size(); ++i) {
+		base_layers[i] = loaded_layers[i].cloneOutlines();
+	}
 
-		layer_node = layer_node.nextSibling();
+	// simplify the imported outlines
+	int num_removed = 0;
+	if (simplify_tolerance > 0.0) {
+		num_removed = canvas::Layer::simplifyShapes(loaded_layers, simplify_tolerance);
 	}
 
+	setLayers(loaded_layers);
+
+	QString message;
+	if (num_repaired > 0) {
+		message += QString("Repaired %1 invalid polygon(s) in %2. ").arg(num_repaired).arg(filename);
+	}
+	if (num_removed > 0) {
+		message += QString("Removed %1 vertices by simplification.").arg(num_removed);
+	}
+	if (!message.isEmpty()) {
+		mainWin->statusBar()->showMessage(message.trimmed(), 5000);
+	}
+
+	// start the journal on the loaded file, and record the simplification if any
+	journal.start(journalFilename(), filename, base_layers);
+	journal.append(layers);
+}
+
+/**
+ * Replace the design with the layers, and show the first layer.
+ */
+void GLWidget3D::setLayers(const std::vector<canvas::Layer>& layers) {
+	this->layers = layers;
+	selected_shape.reset();
+	mode = MODE_SELECT;
+
 	// select 1st layer to display
 	layer_id = 0;
+	invalidateBackgroundLayers();
 
 	// update 3D geometry
 	update3DGeometry();
+	updateCollisions();
 
 	// no currently drawing shape
 	current_shape.reset();
@@ -473,27 +508,106 @@ void GLWidget3D::open(const QString& filename) {
 	update();
 }
 
+/**
+ * Save the design in the background.
+ * The outlines of the layers are cloned so that the user can keep editing while the snapshot is being written by
+ * a worker thread. If a save is still being written, this save is started after it with the design at that time
+ * (only the last of such requests is kept), so that the UI never waits for the worker.
+ */
 void GLWidget3D::save(const QString& filename) {
-	QFile file(filename);
-	if (!file.open(QFile::WriteOnly)) throw "File cannot open.";
-
-	QDomDocument doc;
+	if (save_watcher.isRunning()) {
+		pending_save_filename = filename;
+		mainWin->statusBar()->showMessage(QString("%1 will be saved after %2.").arg(QFileInfo(filename).fileName()).arg(saving_filename));
+		return;
+	}
 
-	// set root node
-	QDomElement root = doc.createElement("design");
-	root.setAttribute("author", "Gen Nishida");
-	root.setAttribute("version", "1.0");
-	root.setAttribute("date", QDate::currentDate().toString("MM/dd/yyyy"));
-	doc.appendChild(root);
+	// the journal is rebased on the saved file after the file is written
+	journalEdit();
+	save_journal_position = journal.position();
+	save_journal_generation = journal.getGeneration();
+	save_journal_base = filename;
 
-	// write layers
+	std::vector<canvas::Layer> snapshot(layers.size());
 	for (int i = 0; i < layers.size(); ++i) {
-		QDomElement layer_node = layers[i].toXml(doc);
-		root.appendChild(layer_node);
+		snapshot[i] = layers[i].cloneOutlines();
+	}
+
+	save_journal_layers = snapshot;
+
+	saving_filename = QFileInfo(filename).fileName();
+	save_progress.store(0);
+	save_progress_timer.start();
+	save_watcher.setFuture(QtConcurrent::run(saveDesign, filename, snapshot, &save_progress));
+}
+
+/**
+ * Record the committed edit in the journal.
+ * Call this function after every change of the layers, e.g. drawing, deleting or pasting shapes and adding or deleting layers,
+ * so that no edit is lost when the application crashes.
+ */
+void GLWidget3D::journalEdit() {
+	journal.append(layers);
+	updateCollisions();
+	if (!journal_flush_timer.isActive()) {
+		journal_flush_timer.start();
 	}
 
-	QTextStream out(&file);
-	doc.save(out, 4);
+	// fold the journal into a snapshot when it gets long
+	// (two snapshot files are used alternately, so that the current base is intact until the journal is rebased)
+	if (journal.numRecords() >= canvas::Journal::COMPACTION_THRESHOLD) {
+		journal.compact(journalFilename() + QString(".%1.cdb").arg(journal.getGeneration() % 2));
+	}
+}
+
+/**
+ * Recover the design from the journal of a previous session which has ended without closing it, if the journal
+ * has any edit which has not been saved. The journals of the sessions which are still running are locked, and left alone.
+ * A new journal of this session is started in any case, and the journals of the ended sessions are deleted.
+ */
+void GLWidget3D::recoverJournal() {
+	journal.start(journalFilename(), "", layers);
+
+	// the most recent journal is offered first
+	QDir temp = QDir::temp();
+	QStringList names = temp.entryList(QStringList("Canvas3DMultiLayers.*.journal"), QDir::Files, QDir::Time);
+	bool recovered = false;
+	for (int i = 0; i < names.size(); ++i) {
+		QString filename = temp.filePath(names[i]);
+		if (filename == journalFilename()) continue;
+
+		QLockFile lock(filename + ".lock");
+		lock.setStaleLockTime(0);
+		if (!lock.tryLock(0)) continue;
+
+		if (!recovered) {
+			try {
+				int num_records;
+				std::vector<canvas::Layer> recovered_layers = canvas::Journal::replay(filename, num_records);
+
+				// a journal with fewer layers than the editor needs is not a design of this editor
+				if (num_records > 0 && (int)recovered_layers.size() >= MIN_NUM_LAYERS && QMessageBox::question(this, "Recovery", QString("Recover %1 unsaved edit(s) of the previous session?").arg(num_records), QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
+					setLayers(recovered_layers);
+					history.push(layers);
+					journalEdit();
+					recovered = true;
+				}
+			}
+			catch (const char* ex) {
+				mainWin->statusBar()->showMessage(QString("The journal of the previous session cannot be recovered: %1").arg(ex), 5000);
+			}
+		}
+
+		QFile::remove(filename);
+		QFile::remove(filename + ".0.cdb");
+		QFile::remove(filename + ".1.cdb");
+	}
+}
+
+/**
+ * Return the journal file of this session. Each running instance has its own journal.
+ */
+QString GLWidget3D::journalFilename() {
+	return QDir::temp().filePath(QString("Canvas3DMultiLayers.%1.journal").arg(QCoreApplication::applicationPid()));
 }
 
 glm::dvec2 GLWidget3D::screenToWorldCoordinates(const glm::dvec2& p) {
@@ -514,17 +628,425 @@ double GLWidget3D::scale() {
 	return camera.f() / camera.pos.z * height() * 0.5;
 }
 
+/**
+ * Return the area of the world coordinate system that is visible on the screen.
+ */
+canvas::BoundingBox GLWidget3D::visibleWorldBoundingBox() {
+	glm::dvec2 top_left = screenToWorldCoordinates(0, 0);
+	glm::dvec2 bottom_right = screenToWorldCoordinates(width(), height());
+	return canvas::BoundingBox(glm::dvec2(top_left.x, bottom_right.y), glm::dvec2(bottom_right.x, top_left.y));
+}
+
+/**
+ * Draw the shape on the screen only if it is within the visible area.
+ * A shape smaller than a couple of pixels is drawn as a small rectangle instead of its outline.
+ */
+void GLWidget3D::drawShape(QPainter& painter, const boost::shared_ptr<canvas::Shape>& shape, const QPointF& origin, const canvas::BoundingBox& view) {
+	canvas::BoundingBox bbox = shape->worldBoundingBox();
+
+	// the resize and rotation markers of the selected shape stick out of the bounding box
+	double margin = shape->isSelected() ? 30 / scale() : 0;
+	if (!bbox.intersects(canvas::BoundingBox(view.minPt - margin, view.maxPt + margin))) return;
+
+	if (!shape->isSelected() && std::max(bbox.width(), bbox.height()) * scale() < 2) {
+		glm::dvec2 c = bbox.center();
+		painter.fillRect(QRectF(origin.x() + c.x * scale() - 1, origin.y() - c.y * scale() - 1, 2, 2), QColor(0, 0, 0));
+		return;
+	}
+
+	shape->draw(painter, origin, scale());
+}
+
+/**
+ * Add the shape to the overlay batch only if it is within the visible area.
+ * This is the counterpart of drawShape(QPainter&, ...) for the OpenGL overlay renderer.
+ */
+void GLWidget3D::drawShape(OverlayRenderer& renderer, const boost::shared_ptr<canvas::Shape>& shape, const glm::dvec2& origin, const canvas::BoundingBox& view) {
+	canvas::BoundingBox bbox = shape->worldBoundingBox();
+
+	// the resize and rotation markers of the selected shape stick out of the bounding box
+	double margin = shape->isSelected() ? 30 / scale() : 0;
+	if (!bbox.intersects(canvas::BoundingBox(view.minPt - margin, view.maxPt + margin))) return;
+
+	if (!shape->isSelected() && std::max(bbox.width(), bbox.height()) * scale() < 2) {
+		glm::vec2 c(origin.x + bbox.center().x * scale(), origin.y - bbox.center().y * scale());
+		renderer.addSquare(c, 2, 0, glm::vec4(0, 0, 0, 1), glm::vec4(0, 0, 0, 1));
+		return;
+	}
+
+	shape->draw(renderer, origin, scale());
+}
+
 void GLWidget3D::update3DGeometry() {
+	TRACE_SCOPE("GLWidget3D::update3DGeometry");
+
+	QElapsedTimer timer;
+	timer.start();
+
 	renderManager.removeObjects();
+	resident_meshes.clear();
+	animation_posed = false;
+	generateDeferredGeometry();
 	for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
 		if (layers[layer_id].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
-			QString obj_name = QString("object_%1").arg(i);
-			renderManager.addObject(obj_name, "", layers[layer_id].shapes[i]->getVertices(), true);
+			addResidentObject(layers[layer_id].shapes[i]);
+		}
+	}
+	updateGhosts();
+
+	// the shapes of the other layers might have been changed as well
+	renderManager.shadow.setNumKeys(layers.size());
+	renderManager.shadow.invalidate();
+	renderManager.shadow.select(layer_id);
+
+	// update shadow map
+	renderManager.updateShadowMap(light_dir, light_mvpMatrix);
+
+	renderManager.profiler.addCPUTime(RenderProfiler::CPU_GEOMETRY, timer.nsecsElapsed() * 1e-6);
+}
+
+/**
+ * Show the 3D geometry of the active layer by reusing the meshes on the GPU.
+ * The corresponding shapes of the layers usually have the same outline and differ only in their poses, so the meshes are
+ * just moved by the instance transforms. A mesh is rebuilt only if the outline of the shape is different, and the shadow map
+ * is drawn only if the cached one of the layer is outdated.
+ */
+void GLWidget3D::showLayerGeometry() {
+	TRACE_SCOPE("GLWidget3D::showLayerGeometry");
+
+	QElapsedTimer timer;
+	timer.start();
+
+	animation_posed = false;
+	generateDeferredGeometry();
+	std::set<int> ids;
+	for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
+		const boost::shared_ptr<canvas::Shape>& shape = layers[layer_id].shapes[i];
+		if (shape->getSubType() != canvas::Shape::TYPE_BODY) continue;
+
+		ids.insert(shape->getId());
+		std::map<int, ResidentMesh>::iterator it = resident_meshes.find(shape->getId());
+		if (it == resident_meshes.end() || (it->second.geometryVersion != shape->getGeometryVersion() && !it->second.outline->hasSameGeometry(shape))) {
+			addResidentObject(shape);
+		}
+	}
+
+	// release the meshes of the shapes which this layer does not have
+	for (std::map<int, ResidentMesh>::iterator it = resident_meshes.begin(); it != resident_meshes.end();) {
+		if (ids.find(it->first) == ids.end()) {
+			renderManager.removeObject(QString("object_%1").arg(it->first));
+			it = resident_meshes.erase(it);
+		}
+		else {
+			++it;
 		}
 	}
 
+	updateObjectTransforms();
+	updateGhosts();
+
 	// update shadow map
-	renderManager.updateShadowMap(this, light_dir, light_mvpMatrix);
+	renderManager.shadow.setNumKeys(layers.size());
+	if (!renderManager.shadow.select(layer_id)) {
+		renderManager.updateShadowMap(light_dir, light_mvpMatrix);
+	}
+
+	renderManager.profiler.addCPUTime(RenderProfiler::CPU_GEOMETRY, timer.nsecsElapsed() * 1e-6);
+}
+
+/**
+ * Generate the deferred 3D geometry of the bodies of the active layer in parallel, before the meshes are uploaded one by one.
+ * The shapes loaded from a file are tessellated only here, when their layer is shown for the first time.
+ */
+void GLWidget3D::generateDeferredGeometry() {
+	std::vector<boost::shared_ptr<canvas::Shape> > shapes;
+	for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
+		const boost::shared_ptr<canvas::Shape>& shape = layers[layer_id].shapes[i];
+		if (shape->getSubType() == canvas::Shape::TYPE_BODY && shape->is3DGeometryDeferred()) {
+			shapes.push_back(shape);
+		}
+	}
+
+	if (shapes.size() > 1) {
+		QtConcurrent::blockingMap(shapes, ensure3DGeometry);
+	}
+}
+
+/**
+ * Build the mesh of the shape on the GPU, and remember the pose which it is built at.
+ * The mesh of the shape being dragged is streamed so that it can be updated in every mouse move without reallocating the GPU storage.
+ * The prism extruded on the GPU is built in the local coordinate system, so it is placed just by the pose of the shape.
+ */
+void GLWidget3D::addResidentObject(const boost::shared_ptr<canvas::Shape>& shape, bool streaming) {
+	QString obj_name = QString("object_%1").arg(shape->getId());
+	ResidentMesh& mesh = resident_meshes[shape->getId()];
+	mesh.geometryVersion = shape->getGeometryVersion();
+	mesh.outline = shape->cloneOutline();
+	if (canvas::Shape::isGPUExtrusion()) {
+		// the same prism as Shape::buildMesh() generates
+		if (streaming) {
+			renderManager.streamExtrudedObject(obj_name, shape->getExtrusion(), -10, 0, glm::vec4(0.7, 1, 0.7, 1));
+		}
+		else {
+			renderManager.removeObject(obj_name);
+			renderManager.addExtrudedObject(obj_name, shape->getExtrusion(), -10, 0, glm::vec4(0.7, 1, 0.7, 1));
+		}
+		mesh.invPoseMatrix = glm::mat4();
+		renderManager.setObjectTransform(obj_name, poseMatrix(shape->getPosition(), shape->getRotation()));
+		return;
+	}
+	else if (streaming) {
+		renderManager.streamObject(obj_name, shape->getVertices());
+	}
+	else {
+		renderManager.removeObject(obj_name);
+		renderManager.addObject(obj_name, "", shape->getVertices(), true);
+	}
+	mesh.invPoseMatrix = glm::inverse(poseMatrix(shape->getPosition(), shape->getRotation()));
+}
+
+/**
+ * Follow the pose of the shape being moved or rotated.
+ * The prism extruded on the GPU is just moved by its transform, while the mesh built on the CPU is streamed again.
+ */
+void GLWidget3D::moveResidentObject(const boost::shared_ptr<canvas::Shape>& shape) {
+	if (canvas::Shape::isGPUExtrusion() && resident_meshes.find(shape->getId()) != resident_meshes.end()) {
+		renderManager.setObjectTransform(QString("object_%1").arg(shape->getId()), poseTransform(shape->getId(), shape->getPosition(), shape->getRotation()));
+	}
+	else {
+		addResidentObject(shape, true);
+	}
+}
+
+/**
+ * Return the transform which moves the mesh of the shape from the pose which it was built at to the specified pose.
+ */
+glm::mat4 GLWidget3D::poseTransform(int id, const glm::dvec2& pos, double theta) {
+	std::map<int, ResidentMesh>::const_iterator it = resident_meshes.find(id);
+	if (it == resident_meshes.end()) return glm::mat4();
+
+	return poseMatrix(pos, theta) * it->second.invPoseMatrix;
+}
+
+/**
+ * Move the meshes to the poses of the shapes of the active layer.
+ */
+void GLWidget3D::updateObjectTransforms() {
+	for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
+		const boost::shared_ptr<canvas::Shape>& shape = layers[layer_id].shapes[i];
+		if (shape->getSubType() == canvas::Shape::TYPE_BODY) {
+			renderManager.setObjectTransform(QString("object_%1").arg(shape->getId()), poseTransform(shape->getId(), shape->getPosition(), shape->getRotation()));
+		}
+	}
+}
+
+/**
+ * Set the tolerance of simplifying the outlines of the polygons when they are completed or imported.
+ * The simplification is disabled if the tolerance is 0.
+ */
+void GLWidget3D::setSimplifyTolerance(double tolerance) {
+	simplify_tolerance = tolerance;
+}
+
+/**
+ * Enable/disable checking the bodies for the collisions and the clearance violations after every edit.
+ */
+void GLWidget3D::setCollisionCheck(bool show_collisions) {
+	this->show_collisions = show_collisions;
+	updateCollisions();
+	update();
+}
+
+/**
+ * Set the minimum distance which the bodies should keep from each other.
+ */
+void GLWidget3D::setClearance(double clearance) {
+	this->clearance = clearance;
+	updateCollisions();
+	update();
+}
+
+/**
+ * Set the GPU memory which the shadow maps of the layers may use to switch the layers without redrawing the shadows.
+ * At least the shadow map of the active layer is kept regardless of the budget.
+ */
+void GLWidget3D::setShadowMemoryBudget(int megabytes) {
+	makeCurrent();
+	renderManager.shadow.setMemoryBudget((size_t)megabytes * 1024 * 1024);
+}
+
+/**
+ * Analyze the bodies of all the layers for the collisions and the clearance violations, and show the result.
+ * The analysis is skipped if no body has been changed, added, or removed since the last one. The result is shown
+ * in its own label of the status bar, so that it does not hide the messages of the edit.
+ */
+void GLWidget3D::updateCollisions() {
+	if (!show_collisions) {
+		collisions.clear();
+		analyzed_bodies.clear();
+		mainWin->labelCollisions->clear();
+		return;
+	}
+
+	// the geometry version changes whenever the outline or the pose of a shape changes
+	std::vector<int> bodies;
+	for (int i = 0; i < layers.size(); ++i) {
+		for (int j = 0; j < layers[i].shapes.size(); ++j) {
+			if (layers[i].shapes[j]->getSubType() != canvas::Shape::TYPE_BODY) continue;
+			bodies.push_back(layers[i].shapes[j]->getId());
+			bodies.push_back(layers[i].shapes[j]->getGeometryVersion());
+		}
+		bodies.push_back(-1);
+	}
+	if (bodies == analyzed_bodies && clearance == analyzed_clearance) return;
+
+	QElapsedTimer timer;
+	timer.start();
+	collisions.analyze(layers, clearance);
+	analyzed_bodies.swap(bodies);
+	analyzed_clearance = clearance;
+
+	int num_overlaps = collisions.numOverlaps();
+	int num_violations = collisions.getContacts().size() - num_overlaps;
+	mainWin->labelCollisions->setText(QString("%1 collision(s), %2 clearance violation(s) in %3 ms").arg(num_overlaps).arg(num_violations).arg(timer.elapsed()));
+}
+
+/**
+ * Highlight the bodies of the current layer which collide or violate the clearance, in their poses at the contacts.
+ * The overlaps are red and the clearance violations are orange. The contacts in the motion to the next layer are
+ * lighter, and the closest points are connected by a line.
+ */
+void GLWidget3D::drawCollisions(OverlayRenderer& renderer, const glm::dvec2& origin) {
+	const std::vector<canvas::CollisionAnalyzer::Contact>& contacts = collisions.getContacts();
+	for (int i = 0; i < contacts.size(); ++i) {
+		const canvas::CollisionAnalyzer::Contact& contact = contacts[i];
+		if (contact.layer != layer_id) continue;
+
+		glm::vec4 color = contact.isOverlap() ? glm::vec4(1, 0, 0, 1) : glm::vec4(1, 0.5, 0, 1);
+		if (contact.time > 0.0) color.a = 0.5f;
+
+		int ids[2] = { contact.id1, contact.id2 };
+		glm::dvec2 positions[2] = { contact.pos1, contact.pos2 };
+		double thetas[2] = { contact.theta1, contact.theta2 };
+		for (int k = 0; k < 2; ++k) {
+			boost::shared_ptr<canvas::Shape> shape = layers[layer_id].findShape(ids[k]);
+			if (!shape) continue;
+
+			// move the outline from the current pose to the pose at the contact
+			std::vector<glm::dvec2> points = shape->getPoints();
+			std::vector<glm::vec2> screen_points(points.size());
+			double c = cos(thetas[k]);
+			double s = sin(thetas[k]);
+			for (int j = 0; j < points.size(); ++j) {
+				glm::dvec2 p = shape->localCoordinate(points[j]);
+				p = glm::dvec2(p.x * c - p.y * s, p.x * s + p.y * c) + positions[k];
+				screen_points[j] = glm::vec2(origin.x + p.x * scale(), origin.y - p.y * scale());
+			}
+			renderer.addPolyline(screen_points, color, 2, true);
+		}
+
+		std::vector<glm::vec2> segment(2);
+		segment[0] = glm::vec2(origin.x + contact.point1.x * scale(), origin.y - contact.point1.y * scale());
+		segment[1] = glm::vec2(origin.x + contact.point2.x * scale(), origin.y - contact.point2.y * scale());
+		renderer.addPolyline(segment, color, 1, false);
+		renderer.addSquare(segment[0], 6, 0, color, color);
+		renderer.addSquare(segment[1], 6, 0, color, color);
+	}
+}
+
+/**
+ * Show/hide the other layers as translucent ghosts in the 3D view.
+ */
+void GLWidget3D::setOnionSkin(bool onion_skin) {
+	renderManager.showGhosts = onion_skin;
+	updateGhosts();
+	update();
+}
+
+/**
+ * Switch between the meshes built on the CPU and the prisms extruded from the outlines by the geometry shader.
+ * The 3D geometry of all the shapes is regenerated lazily in the new form.
+ */
+void GLWidget3D::setGPUExtrusion(bool gpu_extrusion) {
+	canvas::Shape::setGPUExtrusion(gpu_extrusion);
+	for (int i = 0; i < layers.size(); i++) {
+		for (int j = 0; j < layers[i].shapes.size(); j++) {
+			layers[i].shapes[j]->invalidate3DGeometry();
+		}
+	}
+
+	update3DGeometry();
+	update();
+}
+
+/**
+ * Update the ghosts of all the body shapes of the active layer.
+ */
+void GLWidget3D::updateGhosts() {
+	if (!renderManager.showGhosts) return;
+
+	for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
+		if (layers[layer_id].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
+			updateGhosts(layers[layer_id].shapes[i]);
+		}
+	}
+}
+
+/**
+ * Update the ghosts of the shape, which are its mesh placed at the poses of the corresponding shapes of the other layers.
+ * The layers before the active one are tinted blue and the layers after it red, and they fade out with the distance from the active layer.
+ */
+void GLWidget3D::updateGhosts(const boost::shared_ptr<canvas::Shape>& shape) {
+	if (!renderManager.showGhosts) return;
+
+	std::vector<GhostInstance> ghosts;
+	for (int l = 0; l < layers.size(); ++l) {
+		if (l == layer_id) continue;
+
+		boost::shared_ptr<canvas::Shape> ghost = layers[l].findShape(shape->getId());
+		if (!ghost) continue;
+
+		float alpha = std::max(0.4f / abs(l - layer_id), 0.08f);
+		glm::vec4 color = l < layer_id ? glm::vec4(0.4, 0.6, 1, alpha) : glm::vec4(1, 0.5, 0.4, alpha);
+		ghosts.push_back(GhostInstance(poseTransform(shape->getId(), ghost->getPosition(), ghost->getRotation()), color));
+	}
+
+	renderManager.setObjectGhosts(QString("object_%1").arg(shape->getId()), ghosts);
+}
+
+/**
+ * Mark the cached image of the non-active layers as outdated.
+ * Call this function whenever the shapes of the non-active layers or the active layer id change.
+ */
+void GLWidget3D::invalidateBackgroundLayers() {
+	background_layers_outdated = true;
+}
+
+/**
+ * Render the body shapes of the non-active layers into the cached image.
+ * The image is re-rendered only when it is outdated or the view is panned, zoomed, or resized.
+ */
+void GLWidget3D::updateBackgroundLayers(const QPointF& origin) {
+	if (!background_layers_outdated && background_layers_origin == origin && background_layers_scale == scale() && background_layers_image.size() == size()) return;
+
+	background_layers_image = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+	background_layers_image.fill(Qt::transparent);
+
+	canvas::BoundingBox view = visibleWorldBoundingBox();
+	QPainter painter(&background_layers_image);
+	for (int l = 0; l < layers.size(); ++l) {
+		if (l == layer_id) continue;
+		for (int i = 0; i < layers[l].shapes.size(); ++i) {
+			if (layers[l].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
+				drawShape(painter, layers[l].shapes[i], origin, view);
+			}
+		}
+	}
+	painter.end();
+
+	background_layers_origin = origin;
+	background_layers_scale = scale();
+	background_layers_outdated = false;
 }
 
 void GLWidget3D::keyPressEvent(QKeyEvent *e) {
@@ -539,6 +1061,32 @@ void GLWidget3D::keyPressEvent(QKeyEvent *e) {
 	}
 
 	switch (e->key()) {
+	case Qt::Key_F3:
+		// show/hide the timings of the render passes
+		renderManager.profiler.showOverlay = !renderManager.profiler.showOverlay;
+		update();
+		break;
+	case Qt::Key_F4:
+		// start/stop streaming the timings to a CSV file
+		if (renderManager.profiler.isRecording()) {
+			renderManager.profiler.stopRecording();
+		}
+		else {
+			renderManager.profiler.startRecording(QString("profile_%1.csv").arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")));
+		}
+		update();
+		break;
+#ifdef CANVAS_TRACE
+	case Qt::Key_F5:
+		// dump the recorded trace events, which can be opened by chrome://tracing or Perfetto
+		Trace::dump(QString("trace_%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")));
+		Trace::clear();
+		break;
+#endif
+	case Qt::Key_F6:
+		// extrude the prisms on the GPU instead of building the meshes on the CPU
+		setGPUExtrusion(!canvas::Shape::isGPUExtrusion());
+		break;
 	default:
 		break;
 	}
@@ -600,6 +1148,7 @@ void GLWidget3D::initializeGL() {
 	////////////////////////////////
 	renderManager.init("", "", "", true, 8192);
 	renderManager.resize(this->width(), this->height());
+	overlay.init(renderManager.programs["overlay"], canvas::Shape::getRotationMarker());
 
 	glUniform1i(glGetUniformLocation(renderManager.programs["ssao"], "tex0"), 0);//tex0: 0
 }
@@ -619,12 +1168,16 @@ void GLWidget3D::resizeGL(int width, int height) {
 * This function is called whenever the widget needs to be painted.
 */
 void GLWidget3D::paintEvent(QPaintEvent *event) {
+	TRACE_SCOPE("GLWidget3D::paintEvent");
+
 	if (first_paint) {
 		std::vector<Vertex> vertices;
 		glutils::drawQuad(0.001, 0.001, glm::vec4(1, 1, 1, 1), glm::mat4(), vertices);
 		renderManager.addObject("dummy", "", vertices, true);
-		renderManager.updateShadowMap(this, light_dir, light_mvpMatrix);
+		renderManager.updateShadowMap(light_dir, light_mvpMatrix);
 		first_paint = false;
+
+		journal_recover_timer.start();
 	}
 
 	// OpenGLで描画
@@ -633,7 +1186,12 @@ void GLWidget3D::paintEvent(QPaintEvent *event) {
 	glMatrixMode(GL_MODELVIEW);
 	glPushMatrix();
 
-	render();
+	renderManager.render(camera, light_dir, light_mvpMatrix);
+
+	// draw grid
+	if (abs(camera.xrot) < 10 && abs(camera.yrot) < 10) {
+		drawGrid();
+	}
 
 	// REMOVE
 	glActiveTexture(GL_TEXTURE0);
@@ -648,49 +1206,48 @@ void GLWidget3D::paintEvent(QPaintEvent *event) {
 	glPopMatrix();
 
 	// draw 2D
+	QElapsedTimer timer;
+	timer.start();
 	QPainter painter(this);
 	painter.setOpacity(1.0f);
 	if (abs(camera.xrot) < 10 && abs(camera.yrot) < 10) {
-		// draw grid
-		painter.save();
-		painter.setPen(QPen(QColor(224, 224, 224), 1));
-		for (int i = -200; i <= 200; i++) {
-			glm::dvec2 p = worldToScreenCoordinates(glm::dvec2(i * 5, i * 5));
-			painter.drawLine(p.x, 0, p.x, height());
-			glm::dvec2 p2 = worldToScreenCoordinates(glm::dvec2(0, i * 5));
-			painter.drawLine(0, p.y, width(), p.y);
-		}
-		painter.restore();
-
 		glm::vec2 offset = glm::vec2(camera.pos.x, -camera.pos.y) * (float)scale();
 
 		// render unselected layers as background
-		for (int l = 0; l < layers.size(); ++l) {
-			if (l == layer_id) continue;
-			for (int i = 0; i < layers[l].shapes.size(); ++i) {
-				if (layers[l].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
-					layers[l].shapes[i]->draw(painter, QPointF(width() * 0.5 - offset.x, height() * 0.5 - offset.y), scale());
-				}
-			}
-		}
+		updateBackgroundLayers(QPointF(width() * 0.5 - offset.x, height() * 0.5 - offset.y));
+		painter.drawImage(0, 0, background_layers_image);
 
 		// make the unselected layers faded
 		painter.setPen(QColor(255, 255, 255, 160));
 		painter.setBrush(QColor(255, 255, 255, 160));
 		painter.drawRect(0, 0, width(), height());
 
-		// render selected layer
+		// render selected layer and currently drawing shape by the batched OpenGL overlay
+		glm::dvec2 origin(width() * 0.5 - offset.x, height() * 0.5 - offset.y);
+		canvas::BoundingBox view = visibleWorldBoundingBox();
+		overlay.clear();
 		for (int i = 0; i < layers[layer_id].shapes.size(); i++) {
-			layers[layer_id].shapes[i]->draw(painter, QPointF(width() * 0.5 - offset.x, height() * 0.5 - offset.y), scale());
+			drawShape(overlay, layers[layer_id].shapes[i], origin, view);
 		}
-
-		// render currently drawing shape
+		drawCollisions(overlay, origin);
 		if (current_shape) {
-			current_shape->draw(painter, QPointF(width() * 0.5 - offset.x, height() * 0.5 - offset.y), scale());
+			current_shape->draw(overlay, origin, scale());
 		}
+
+		painter.beginNativePainting();
+		overlay.render(width(), height());
+		painter.endNativePainting();
+	}
+	renderManager.profiler.addCPUTime(RenderProfiler::CPU_OVERLAY, timer.nsecsElapsed() * 1e-6);
+
+	// show the timings of the render passes
+	if (renderManager.profiler.showOverlay) {
+		renderManager.profiler.draw(painter, 10, 10);
 	}
 	painter.end();
 
+	renderManager.profiler.endFrame();
+
 	glEnable(GL_DEPTH_TEST);
 }
 
@@ -701,6 +1258,11 @@ void GLWidget3D::mousePressEvent(QMouseEvent *e) {
 	// This is necessary to get key event occured even after the user selects a menu.
 	setFocus();
 
+	// go back to the poses of the active layer before editing it
+	if (isAnimating() || animation_posed) {
+		stopAnimation();
+	}
+
 	if (e->buttons() & Qt::LeftButton) {
 		if (mode == MODE_SELECT) {
 			// hit test for rotation marker
@@ -851,6 +1413,11 @@ void GLWidget3D::mousePressEvent(QMouseEvent *e) {
 */
 
 void GLWidget3D::mouseMoveEvent(QMouseEvent *e) {
+	TRACE_SCOPE("GLWidget3D::mouseMoveEvent");
+
+	QElapsedTimer timer;
+	timer.start();
+
 	if (mode == MODE_MOVE) {
 		boost::shared_ptr<canvas::MoveOperation> op = boost::static_pointer_cast<canvas::MoveOperation>(operation);
 		glm::dvec2 dir = screenToWorldCoordinates(e->x(), e->y()) - op->pivot;
@@ -860,16 +1427,16 @@ void GLWidget3D::mouseMoveEvent(QMouseEvent *e) {
 
 				if (layers[layer_id].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
 					// update 3D geometry
-					QString obj_name = QString("object_%1").arg(i);
-					renderManager.removeObject(obj_name);
-					renderManager.addObject(obj_name, "", layers[layer_id].shapes[i]->getVertices(), true);
+					moveResidentObject(layers[layer_id].shapes[i]);
+					updateGhosts(layers[layer_id].shapes[i]);
 
 					// update shadow map
-					renderManager.updateShadowMap(this, light_dir, light_mvpMatrix);
+					renderManager.updateShadowMap(light_dir, light_mvpMatrix);
 				}
 			}
 		}
 		op->pivot = screenToWorldCoordinates(e->x(), e->y());
+		renderManager.profiler.addCPUTime(RenderProfiler::CPU_GEOMETRY, timer.nsecsElapsed() * 1e-6);
 		update();
 	}
 	else if (mode == MODE_ROTATION) {
@@ -883,16 +1450,16 @@ void GLWidget3D::mouseMoveEvent(QMouseEvent *e) {
 
 				if (layers[layer_id].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
 					// update 3D geometry
-					QString obj_name = QString("object_%1").arg(i);
-					renderManager.removeObject(obj_name);
-					renderManager.addObject(obj_name, "", layers[layer_id].shapes[i]->getVertices(), true);
+					moveResidentObject(layers[layer_id].shapes[i]);
+					updateGhosts(layers[layer_id].shapes[i]);
 
 					// update shadow map
-					renderManager.updateShadowMap(this, light_dir, light_mvpMatrix);
+					renderManager.updateShadowMap(light_dir, light_mvpMatrix);
 				}
 			}
 		}
 		op->pivot = screenToWorldCoordinates(e->x(), e->y());
+		renderManager.profiler.addCPUTime(RenderProfiler::CPU_GEOMETRY, timer.nsecsElapsed() * 1e-6);
 		update();
 	}
 	else if (mode == MODE_RESIZE) {
@@ -904,22 +1471,33 @@ void GLWidget3D::mouseMoveEvent(QMouseEvent *e) {
 		for (int i = 0; i < layers[layer_id].shapes.size(); ++i) {
 			if (layers[layer_id].shapes[i]->isSelected()) {
 				// resize the shape for all the layers in order to make the size of the shape the same across the layers
+				int id = layers[layer_id].shapes[i]->getId();
+				layers[layer_id].shapes[i]->resize(resize_scale, resize_center);
 				for (int l = 0; l < layers.size(); l++) {
-					layers[l].shapes[i]->resize(resize_scale, resize_center);
+					if (l == layer_id) continue;
+
+					boost::shared_ptr<canvas::Shape> shape = layers[l].findShape(id);
+					if (!shape) continue;
+					shape->resize(resize_scale, resize_center);
+
+					// keep a single copy of the resized outline across the layers
+					shape->shareGeometry(layers[layer_id].shapes[i]);
 				}
+				invalidateBackgroundLayers();
+				renderManager.shadow.invalidate();
 
 				if (layers[layer_id].shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
 					// update 3D geometry
-					QString obj_name = QString("object_%1").arg(i);
-					renderManager.removeObject(obj_name);
-					renderManager.addObject(obj_name, "", layers[layer_id].shapes[i]->getVertices(), true);
+					addResidentObject(layers[layer_id].shapes[i], true);
+					updateGhosts(layers[layer_id].shapes[i]);
 
 					// update shadow map
-					renderManager.updateShadowMap(this, light_dir, light_mvpMatrix);
+					renderManager.updateShadowMap(light_dir, light_mvpMatrix);
 				}
 			}
 		}
 		op->pivot = screenToWorldCoordinates(e->x(), e->y());
+		renderManager.profiler.addCPUTime(RenderProfiler::CPU_GEOMETRY, timer.nsecsElapsed() * 1e-6);
 		update();
 	}
 	else if (mode == MODE_RECTANGLE || mode == MODE_CIRCLE || mode == MODE_POLYGON) {
@@ -945,7 +1523,11 @@ void GLWidget3D::mouseMoveEvent(QMouseEvent *e) {
 void GLWidget3D::mouseReleaseEvent(QMouseEvent *e) {
 	if (mode == MODE_MOVE || mode == MODE_ROTATION || mode == MODE_RESIZE) {
 		history.push(layers);
+		journalEdit();
 		mode = MODE_SELECT;
+
+		// the dragged shapes go back to the static storage
+		renderManager.stopStreaming();
 	}
 	else if (e->button() == Qt::RightButton) {
 		//if (abs(camera.xrot) < 20 && abs(camera.yrot) < 20) {
@@ -969,10 +1551,34 @@ void GLWidget3D::mouseDoubleClickEvent(QMouseEvent* e) {
 		if (e->button() == Qt::LeftButton) {
 			if (current_shape) {
 				// The shape is created.
-				current_shape->completeDrawing();
+				// The redundant vertices of the traced outline are removed, but the ones shared with the linkage regions are kept.
+				int num_removed = 0;
+				if (simplify_tolerance > 0.0) {
+					num_removed = current_shape->simplify(simplify_tolerance, layers[layer_id].sharedVertices(current_shape));
+				}
+				int result = current_shape->completeDrawing();
+				if (result == glutils::PolygonValidator::DEGENERATE) {
+					// the outline has no area, so the shape is discarded
+					mainWin->statusBar()->showMessage("The polygon has no area, and was discarded.", 3000);
+					current_shape.reset();
+					operation.reset();
+					setMouseTracking(false);
+					update();
+					return;
+				}
+				else if (result == glutils::PolygonValidator::REPAIRED) {
+					mainWin->statusBar()->showMessage("The self-intersecting polygon was repaired.", 3000);
+				}
+				else if (result == glutils::PolygonValidator::CONVEX_HULL) {
+					mainWin->statusBar()->showMessage("The self-intersecting polygon was replaced by its convex hull.", 3000);
+				}
+				else if (num_removed > 0) {
+					mainWin->statusBar()->showMessage(QString("Removed %1 vertices from the polygon.").arg(num_removed), 3000);
+				}
 				for (int i = 0; i < layers.size(); i++) {
-					layers[i].shapes.push_back(current_shape->clone());
+					layers[i].addShape(current_shape->clone());
 				}
+				invalidateBackgroundLayers();
 
 				// update 3D geometry
 				update3DGeometry();
@@ -980,6 +1586,7 @@ void GLWidget3D::mouseDoubleClickEvent(QMouseEvent* e) {
 				layers[layer_id].shapes.back()->select();
 				mode = MODE_SELECT;
 				history.push(layers);
+				journalEdit();
 				current_shape.reset();
 				operation.reset();
 				mainWin->ui.actionSelect->setChecked(true);
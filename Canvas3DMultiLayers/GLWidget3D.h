@@ -6,9 +6,14 @@
 #include <QGLWidget>
 #include <QMouseEvent>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QLockFile>
 #include "Camera.h"
 #include "ShadowMapping.h"
 #include "RenderManager.h"
+#include "OverlayRenderer.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -16,12 +21,28 @@
 #include "Operation.h"
 #include "Layer.h"
 #include "History.h"
+#include "Journal.h"
+#include "CollisionAnalyzer.h"
 
 class MainWindow;
 
+/**
+ * The geometry which a mesh on the GPU was built from, and the inverse of its pose at that time
+ * (identity for the prism extruded on the GPU, which is built in the local coordinate system).
+ * The outline is a copy which is never modified, so it can be compared with the shapes of the other layers
+ * even after the shape which the mesh was built from has been edited.
+ */
+struct ResidentMesh {
+	int geometryVersion;
+	boost::shared_ptr<canvas::Shape> outline;
+	glm::mat4 invPoseMatrix;
+};
+
 class GLWidget3D : public QGLWidget {
 public:
 	static enum { MODE_SELECT = 0, MODE_MOVE, MODE_ROTATION, MODE_RESIZE, MODE_RECTANGLE, MODE_CIRCLE, MODE_POLYGON };
+	// the editor always has at least this number of layers
+	static const int MIN_NUM_LAYERS = 2;
 
 public:
 	MainWindow* mainWin;
@@ -35,6 +56,7 @@ public:
 
 	// rendering engine
 	RenderManager renderManager;
+	OverlayRenderer overlay;
 
 	// key status
 	bool shiftPressed;
@@ -51,11 +73,55 @@ public:
 	int layer_id;
 	canvas::History history;
 
+	// meshes kept on the GPU while switching the layers (keyed by the shape ID)
+	std::map<int, ResidentMesh> resident_meshes;
+
+	// cached image of the non-active layers, which are drawn as faded background
+	QImage background_layers_image;
+	bool background_layers_outdated;
+	QPointF background_layers_origin;
+	double background_layers_scale;
+
+	// saving the design in the background
+	QFutureWatcher<QString> save_watcher;
+	QAtomicInt save_progress;
+	QTimer save_progress_timer;
+	QString saving_filename;
+	QString pending_save_filename;
+
+	// journal of the committed edits for crash recovery (the lock tells the other instances that this session is alive)
+	canvas::Journal journal;
+	QLockFile journal_lock;
+	QTimer journal_flush_timer;
+	QTimer journal_recover_timer;
+	qint64 save_journal_position;
+	int save_journal_generation;
+	QString save_journal_base;
+	std::vector<canvas::Layer> save_journal_layers;
+
+	// playback of the poses of the layers (the time is measured in layers)
+	QTimer animation_timer;
+	QElapsedTimer animation_clock;
+	double animation_time;
+	double animation_speed;
+	bool animation_posed;
+
+	// tolerance of simplifying the outlines of the polygons (0 to keep all the vertices)
+	double simplify_tolerance;
+
+	// collisions and clearance violations of the bodies in the poses of the layers and in the motion between them
+	canvas::CollisionAnalyzer collisions;
+	bool show_collisions;
+	double clearance;
+	// the IDs and the geometry versions of the bodies of the layers at the last analysis (-1 ends a layer)
+	std::vector<int> analyzed_bodies;
+	double analyzed_clearance;
+
 public:
 	GLWidget3D(MainWindow *parent = 0);
+	~GLWidget3D();
 
-	void drawScene();
-	void render();
+	void drawGrid();
 	void clear();
 	void selectAll();
 	void unselectAll();
@@ -69,13 +135,44 @@ public:
 	void insertLayer();
 	void deleteLayer();
 	void setLayer(int layer_id);
+	void startAnimation();
+	void stopAnimation();
+	bool isAnimating() const;
+	void setAnimationTime(double time);
+	void setAnimationSpeed(double speed);
+	void updateAnimation();
+	void setOnionSkin(bool onion_skin);
+	void setGPUExtrusion(bool gpu_extrusion);
+	void setSimplifyTolerance(double tolerance);
+	void setCollisionCheck(bool show_collisions);
+	void setClearance(double clearance);
+	void setShadowMemoryBudget(int megabytes);
+	void updateCollisions();
+	void drawCollisions(OverlayRenderer& renderer, const glm::dvec2& origin);
+	void updateGhosts();
+	void updateGhosts(const boost::shared_ptr<canvas::Shape>& shape);
 	void open(const QString& filename);
 	void save(const QString& filename);
+	void setLayers(const std::vector<canvas::Layer>& layers);
+	void journalEdit();
+	void recoverJournal();
+	static QString journalFilename();
 	glm::dvec2 screenToWorldCoordinates(const glm::dvec2& p);
 	glm::dvec2 screenToWorldCoordinates(double x, double y);
 	glm::dvec2 worldToScreenCoordinates(const glm::dvec2& p);
 	double scale();
+	canvas::BoundingBox visibleWorldBoundingBox();
+	void drawShape(QPainter& painter, const boost::shared_ptr<canvas::Shape>& shape, const QPointF& origin, const canvas::BoundingBox& view);
+	void drawShape(OverlayRenderer& renderer, const boost::shared_ptr<canvas::Shape>& shape, const glm::dvec2& origin, const canvas::BoundingBox& view);
 	void update3DGeometry();
+	void showLayerGeometry();
+	void generateDeferredGeometry();
+	void addResidentObject(const boost::shared_ptr<canvas::Shape>& shape, bool streaming = false);
+	void moveResidentObject(const boost::shared_ptr<canvas::Shape>& shape);
+	glm::mat4 poseTransform(int id, const glm::dvec2& pos, double theta);
+	void updateObjectTransforms();
+	void invalidateBackgroundLayers();
+	void updateBackgroundLayers(const QPointF& origin);
 
 	void keyPressEvent(QKeyEvent* e);
 	void keyReleaseEvent(QKeyEvent* e);
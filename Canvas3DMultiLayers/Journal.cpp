@@ -0,0 +1,571 @@
+#include "Journal.h"
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <cstring>
+#include "DesignFile.h"
+#include "Rectangle.h"
+#include "Circle.h"
+#include "Polygon.h"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace canvas {
+
+	namespace {
+
+		const char journal_magic[4] = { 'C', 'J', 'N', '1' };
+
+		void initStream(QDataStream& stream) {
+			stream.setByteOrder(QDataStream::LittleEndian);
+			stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+		}
+
+		/**
+		 * Read the header of the journal file, i.e., the base file and the IDs of its shapes.
+		 * Return the size of the header, or -1 if it is not a journal file of this version.
+		 */
+		qint64 readHeader(const QByteArray& data, QString& base_filename, std::vector<std::vector<int> >& base_ids) {
+			if (data.size() < sizeof(journal_magic) || memcmp(data.constData(), journal_magic, sizeof(journal_magic)) != 0) return -1;
+
+			QDataStream in(data);
+			initStream(in);
+			in.skipRawData(sizeof(journal_magic));
+			quint32 version;
+			quint32 num_layers;
+			in >> version >> base_filename >> num_layers;
+			if (in.status() != QDataStream::Ok || version != Journal::VERSION || num_layers > data.size()) return -1;
+
+			base_ids.resize(num_layers);
+			for (int i = 0; i < num_layers; ++i) {
+				quint32 num_shapes;
+				in >> num_shapes;
+				if (in.status() != QDataStream::Ok || num_shapes > data.size()) return -1;
+
+				base_ids[i].resize(num_shapes);
+				for (int k = 0; k < num_shapes; ++k) {
+					qint32 id;
+					in >> id;
+					base_ids[i][k] = id;
+				}
+			}
+			if (in.status() != QDataStream::Ok) return -1;
+
+			return in.device()->pos();
+		}
+
+		/**
+		 * Return true if the shape is the same as the shape of the previous record.
+		 * The shapes of the records are never modified, so the same geometry version means the same shape.
+		 */
+		bool isSameShape(const boost::shared_ptr<Shape>& prev, const boost::shared_ptr<Shape>& shape) {
+			if (prev->getId() != shape->getId()) return false;
+			if (prev->getGeometryVersion() == shape->getGeometryVersion()) return true;
+
+			return prev->getPosition() == shape->getPosition() && prev->getRotation() == shape->getRotation() && prev->hasSameGeometry(shape);
+		}
+
+		bool isSameLayer(const Layer& prev, const Layer& layer) {
+			if (prev.shapes.size() != layer.shapes.size()) return false;
+
+			for (int k = 0; k < layer.shapes.size(); ++k) {
+				if (!isSameShape(prev.shapes[k], layer.shapes[k])) return false;
+			}
+			return true;
+		}
+
+		void writeShape(QDataStream& out, const boost::shared_ptr<Shape>& shape, int index) {
+			out << (qint32)shape->getId() << (quint32)index << (qint32)shape->getType() << (qint32)shape->getSubType();
+			out << shape->getPosition().x << shape->getPosition().y << shape->getRotation();
+			if (shape->getType() == Shape::TYPE_RECTANGLE) {
+				boost::shared_ptr<Rectangle> rectangle = boost::static_pointer_cast<Rectangle>(shape);
+				out << rectangle->getWidth() << rectangle->getHeight() << (quint32)0;
+			}
+			else if (shape->getType() == Shape::TYPE_CIRCLE) {
+				boost::shared_ptr<Circle> circle = boost::static_pointer_cast<Circle>(shape);
+				out << circle->getWidth() << circle->getHeight() << (quint32)0;
+			}
+			else {
+				const std::vector<glm::dvec2>& points = boost::static_pointer_cast<Polygon>(shape)->getLocalPoints();
+				out << 0.0 << 0.0 << (quint32)points.size();
+				for (int j = 0; j < points.size(); ++j) {
+					out << points[j].x << points[j].y;
+				}
+			}
+		}
+
+		/**
+		 * Write the change of the layer from the source layer of the previous record (NULL for an empty layer),
+		 * and make the layer of the new record, which shares the unchanged shapes with the source.
+		 * If the layer is implicitly made from the source, nothing is written when there is no change.
+		 * Return true if the change is written.
+		 */
+		bool writeLayerChange(QDataStream& out, int layer_index, int source_index, const Layer* source, const Layer& layer, bool implicit, Layer& snapshot) {
+			int num_shapes = layer.shapes.size();
+
+			QHash<int, int> source_indices;
+			QSet<int> ids;
+			bool consistent = true;
+			if (source != NULL) {
+				for (int k = 0; k < source->shapes.size(); ++k) {
+					if (source_indices.contains(source->shapes[k]->getId())) consistent = false;
+					source_indices.insert(source->shapes[k]->getId(), k);
+				}
+			}
+			for (int k = 0; k < num_shapes; ++k) {
+				if (ids.contains(layer.shapes[k]->getId())) consistent = false;
+				ids.insert(layer.shapes[k]->getId());
+			}
+
+			std::vector<int> removed_ids;
+			std::vector<int> order;
+			std::vector<bool> changed(num_shapes, true);
+			if (consistent && source != NULL) {
+				for (int k = 0; k < source->shapes.size(); ++k) {
+					if (ids.contains(source->shapes[k]->getId())) order.push_back(source->shapes[k]->getId());
+					else removed_ids.push_back(source->shapes[k]->getId());
+				}
+				for (int k = 0; k < num_shapes; ++k) {
+					QHash<int, int>::const_iterator it = source_indices.find(layer.shapes[k]->getId());
+					if (it != source_indices.end() && isSameShape(source->shapes[it.value()], layer.shapes[k])) changed[k] = false;
+				}
+
+				// the new shapes are inserted at their indices, which has to result in the order of the shapes of the layer
+				for (int k = 0; k < num_shapes && consistent; ++k) {
+					if (source_indices.contains(layer.shapes[k]->getId())) continue;
+					if (k > order.size()) consistent = false;
+					else order.insert(order.begin() + k, layer.shapes[k]->getId());
+				}
+				for (int k = 0; k < num_shapes && consistent; ++k) {
+					if (order[k] != layer.shapes[k]->getId()) consistent = false;
+				}
+			}
+
+			// otherwise, the whole layer is written
+			if (!consistent) {
+				source = NULL;
+				source_index = -1;
+				removed_ids.clear();
+				changed.assign(num_shapes, true);
+				implicit = false;
+			}
+
+			int num_changes = 0;
+			snapshot.shapes.resize(num_shapes);
+			for (int k = 0; k < num_shapes; ++k) {
+				if (changed[k]) {
+					snapshot.shapes[k] = layer.shapes[k]->cloneOutline();
+					num_changes++;
+				}
+				else {
+					snapshot.shapes[k] = source->shapes[source_indices.value(layer.shapes[k]->getId())];
+				}
+			}
+			if (implicit && removed_ids.empty() && num_changes == 0) return false;
+
+			out << (quint32)layer_index << (qint32)source_index << (quint32)removed_ids.size();
+			for (int k = 0; k < removed_ids.size(); ++k) {
+				out << (qint32)removed_ids[k];
+			}
+			out << (quint32)num_changes;
+			for (int k = 0; k < num_shapes; ++k) {
+				if (changed[k]) writeShape(out, layer.shapes[k], k);
+			}
+
+			return true;
+		}
+
+		/**
+		 * Return the ID in this session of the shape which had the ID when the journal was written.
+		 * A new ID is given to the shape which appears for the first time.
+		 */
+		int sessionId(int id, QHash<int, int>& ids) {
+			QHash<int, int>::iterator it = ids.find(id);
+			if (it == ids.end()) it = ids.insert(id, Shape::newId());
+			return it.value();
+		}
+
+	}
+
+	Journal::Journal() {
+		generation = 0;
+		dirty = false;
+	}
+
+	Journal::~Journal() {
+		close();
+	}
+
+	/**
+	 * Start a new journal on the base design file, discarding the existing records.
+	 * The layers have to be the same as the content of the base file (or empty for a new design).
+	 */
+	void Journal::start(const QString& filename, const QString& base_filename, const std::vector<Layer>& layers) {
+		close();
+
+		last_layers = base_filename.isEmpty() ? std::vector<Layer>() : cloneOutlines(layers);
+
+		file.setFileName(filename);
+		if (!file.open(QFile::WriteOnly | QFile::Truncate)) return;
+		file.write(header(base_filename, last_layers));
+		dirty = true;
+		flush();
+
+		this->base_filename = base_filename;
+		record_offsets.clear();
+		generation++;
+	}
+
+	/**
+	 * Append a record of the difference between the layers of the last record and the current layers.
+	 * Nothing is written if there is no difference.
+	 */
+	void Journal::append(const std::vector<Layer>& layers) {
+		if (!file.isOpen()) return;
+
+		std::vector<Layer> snapshot;
+		QByteArray payload = diff(last_layers, layers, snapshot);
+		last_layers.swap(snapshot);
+		if (payload.isEmpty()) return;
+
+		QByteArray record;
+		QDataStream out(&record, QIODevice::WriteOnly);
+		initStream(out);
+		out << (quint32)payload.size() << (quint32)qChecksum(payload.constData(), payload.size());
+		out.writeRawData(payload.constData(), payload.size());
+
+		record_offsets.push_back(file.size());
+		file.write(record);
+		dirty = true;
+	}
+
+	/**
+	 * Write the buffered records to the disk.
+	 * This is relatively expensive, so it should be called for a batch of records.
+	 */
+	void Journal::flush() {
+		if (!file.isOpen() || !dirty) return;
+
+		file.flush();
+#ifdef _WIN32
+		_commit(file.handle());
+#else
+		fsync(file.handle());
+#endif
+		dirty = false;
+	}
+
+	/**
+	 * Make the design file the new base of the journal.
+	 * The design file has to have the base layers, which are the layers at the specified position of the journal,
+	 * so only the records after it are kept.
+	 * Nothing is done if the journal has been restarted or rebased since the position was taken.
+	 */
+	void Journal::rebase(const QString& base_filename, const std::vector<Layer>& base_layers, qint64 position, int generation) {
+		if (!file.isOpen() || generation != this->generation) return;
+
+		flush();
+
+		file.seek(position);
+		QByteArray tail = file.readAll();
+		QByteArray new_header = header(base_filename, base_layers);
+
+		// replace the journal atomically, so that it is consistent even if the application crashes here
+		QString filename = file.fileName();
+		QSaveFile out(filename);
+		if (!out.open(QFile::WriteOnly)) return;
+		out.write(new_header);
+		out.write(tail);
+		file.close();
+		if (!out.commit()) {
+			file.open(QFile::ReadWrite | QFile::Append);
+			return;
+		}
+
+		file.open(QFile::ReadWrite | QFile::Append);
+		std::vector<qint64> offsets;
+		for (int i = 0; i < record_offsets.size(); ++i) {
+			if (record_offsets[i] >= position) {
+				offsets.push_back(record_offsets[i] - position + new_header.size());
+			}
+		}
+		record_offsets = offsets;
+		this->base_filename = base_filename;
+		this->generation++;
+	}
+
+	/**
+	 * Fold all the records into the snapshot file, which becomes the new base of the journal.
+	 */
+	void Journal::compact(const QString& snapshot_filename) {
+		if (!file.isOpen()) return;
+
+		try {
+			DesignFile::saveBinary(snapshot_filename, last_layers);
+		}
+		catch (const char* ex) {
+			return;
+		}
+		rebase(snapshot_filename, last_layers, file.size(), generation);
+	}
+
+	void Journal::close() {
+		if (file.isOpen()) {
+			flush();
+			file.close();
+		}
+	}
+
+	/**
+	 * Recover the layers by loading the base design file and applying the records of the journal.
+	 * The records after a broken one (e.g. written partially when the application crashed) are ignored.
+	 * The shapes get new IDs in this session.
+	 * Each layer has its own copies of the shapes, since the editor modifies the shapes in place.
+	 */
+	std::vector<Layer> Journal::replay(const QString& filename, int& num_records) {
+		num_records = 0;
+
+		QFile file(filename);
+		if (!file.open(QFile::ReadOnly)) throw "File cannot open.";
+		QByteArray data = file.readAll();
+
+		QString base_filename;
+		std::vector<std::vector<int> > base_ids;
+		qint64 offset = readHeader(data, base_filename, base_ids);
+		if (offset < 0) throw "Invalid file format.";
+
+		// the IDs of the shapes in the journal are mapped to the IDs in this session
+		std::vector<Layer> layers;
+		QHash<int, int> ids;
+		if (!base_filename.isEmpty()) {
+			layers = DesignFile::load(base_filename);
+			if (layers.size() != base_ids.size()) throw "Invalid file format.";
+			for (int i = 0; i < layers.size(); ++i) {
+				if (layers[i].shapes.size() != base_ids[i].size()) throw "Invalid file format.";
+				for (int k = 0; k < layers[i].shapes.size(); ++k) {
+					QHash<int, int>::iterator it = ids.find(base_ids[i][k]);
+					if (it == ids.end()) ids.insert(base_ids[i][k], layers[i].shapes[k]->getId());
+					else layers[i].shapes[k]->setId(it.value());
+				}
+			}
+		}
+
+		while (offset + sizeof(quint32) * 2 <= data.size()) {
+			quint32 size;
+			quint32 checksum;
+			memcpy(&size, data.constData() + offset, sizeof(quint32));
+			memcpy(&checksum, data.constData() + offset + sizeof(quint32), sizeof(quint32));
+			offset += sizeof(quint32) * 2;
+			if (offset + size > data.size()) break;
+
+			QByteArray payload = QByteArray::fromRawData(data.constData() + offset, size);
+			if (qChecksum(payload.constData(), payload.size()) != checksum) break;
+			if (!apply(payload, layers, ids)) break;
+
+			offset += size;
+			num_records++;
+		}
+
+		// the records share the unchanged shapes between the layers
+		for (int i = 0; i < layers.size(); ++i) {
+			layers[i] = layers[i].clone();
+		}
+
+		return layers;
+	}
+
+	/**
+	 * Encode the base file and the IDs of the shapes of its layers.
+	 */
+	QByteArray Journal::header(const QString& base_filename, const std::vector<Layer>& base_layers) {
+		QByteArray data;
+		QDataStream out(&data, QIODevice::WriteOnly);
+		initStream(out);
+		out.writeRawData(journal_magic, sizeof(journal_magic));
+		out << VERSION << (base_filename.isEmpty() ? QString() : QFileInfo(base_filename).absoluteFilePath());
+
+		int num_layers = base_filename.isEmpty() ? 0 : base_layers.size();
+		out << (quint32)num_layers;
+		for (int i = 0; i < num_layers; ++i) {
+			out << (quint32)base_layers[i].shapes.size();
+			for (int k = 0; k < base_layers[i].shapes.size(); ++k) {
+				out << (qint32)base_layers[i].shapes[k]->getId();
+			}
+		}
+		return data;
+	}
+
+	/**
+	 * Encode the difference between the layers of the previous record and the current layers,
+	 * and make the layers of the new record in the snapshot.
+	 * Return an empty array if they are the same.
+	 */
+	QByteArray Journal::diff(const std::vector<Layer>& previous, const std::vector<Layer>& layers, std::vector<Layer>& snapshot) {
+		int num_previous = previous.size();
+		int num_layers = layers.size();
+
+		// the layers are inserted or deleted in the middle, so the leading and the trailing layers are matched
+		int num_leading = num_layers;
+		int num_trailing = 0;
+		if (num_previous != num_layers) {
+			int num_common = std::min(num_previous, num_layers);
+			num_leading = 0;
+			while (num_leading < num_common && isSameLayer(previous[num_leading], layers[num_leading])) num_leading++;
+			while (num_trailing < num_common - num_leading && isSameLayer(previous[num_previous - 1 - num_trailing], layers[num_layers - 1 - num_trailing])) num_trailing++;
+		}
+
+		QByteArray changes;
+		QDataStream out(&changes, QIODevice::WriteOnly);
+		initStream(out);
+		quint32 num_layer_changes = 0;
+		snapshot.resize(num_layers);
+		for (int i = 0; i < num_layers; ++i) {
+			int source = i;
+			bool implicit = true;
+			if (i >= num_layers - num_trailing) {
+				source = i - num_layers + num_previous;
+			}
+			else if (i >= num_leading) {
+				// the layers in the middle are matched in order, and an inserted layer is made from the layer before it
+				implicit = false;
+				if (source >= num_previous - num_trailing) {
+					if (num_leading > 0) source = num_leading - 1;
+					else if (num_trailing > 0) source = num_previous - num_trailing;
+					else source = -1;
+				}
+			}
+
+			if (writeLayerChange(out, i, source, source >= 0 ? &previous[source] : NULL, layers[i], implicit, snapshot[i])) num_layer_changes++;
+		}
+		if (num_previous == num_layers && num_layer_changes == 0) return QByteArray();
+
+		QByteArray payload;
+		QDataStream out2(&payload, QIODevice::WriteOnly);
+		initStream(out2);
+		out2 << (quint32)num_layers << (quint32)num_leading << (quint32)num_trailing << num_layer_changes;
+		out2.writeRawData(changes.constData(), changes.size());
+
+		return payload;
+	}
+
+	/**
+	 * Apply the record to the layers. Return false if the record is broken.
+	 * The IDs of the shapes in the record are mapped to the IDs in this session.
+	 */
+	bool Journal::apply(const QByteArray& payload, std::vector<Layer>& layers, QHash<int, int>& ids) {
+		QDataStream in(payload);
+		initStream(in);
+
+		quint32 num_layers, num_leading, num_trailing, num_layer_changes;
+		in >> num_layers >> num_leading >> num_trailing >> num_layer_changes;
+		if (in.status() != QDataStream::Ok || num_layers > payload.size() || num_leading + num_trailing > num_layers || num_leading > layers.size() || num_trailing > layers.size()) return false;
+
+		// the leading and the trailing layers are the same as the previous ones unless they are in the changes
+		std::vector<Layer> new_layers(num_layers);
+		std::vector<bool> made(num_layers, false);
+		for (int i = 0; i < num_layers; ++i) {
+			if (i < num_leading) {
+				new_layers[i].shapes = layers[i].shapes;
+				made[i] = true;
+			}
+			else if (i >= num_layers - num_trailing) {
+				new_layers[i].shapes = layers[i - num_layers + layers.size()].shapes;
+				made[i] = true;
+			}
+		}
+
+		for (int n = 0; n < num_layer_changes; ++n) {
+			quint32 layer, num_removed;
+			qint32 source;
+			in >> layer >> source >> num_removed;
+			if (in.status() != QDataStream::Ok || layer >= num_layers || source < -1 || source >= (int)layers.size() || num_removed > payload.size()) return false;
+
+			std::vector<boost::shared_ptr<Shape> > shapes;
+			if (source >= 0) shapes = layers[source].shapes;
+
+			QSet<int> removed_ids;
+			for (int k = 0; k < num_removed; ++k) {
+				qint32 id;
+				in >> id;
+				removed_ids.insert(sessionId(id, ids));
+			}
+			QSet<int> kept_ids;
+			int num_kept = 0;
+			for (int k = 0; k < shapes.size(); ++k) {
+				if (removed_ids.contains(shapes[k]->getId())) continue;
+				kept_ids.insert(shapes[k]->getId());
+				shapes[num_kept++] = shapes[k];
+			}
+			shapes.resize(num_kept);
+
+			quint32 num_changes;
+			in >> num_changes;
+			if (in.status() != QDataStream::Ok || num_changes > payload.size()) return false;
+			for (int c = 0; c < num_changes; ++c) {
+				quint32 index, num_points;
+				qint32 id, type, subtype;
+				double x, y, theta, width, height;
+				in >> id >> index >> type >> subtype >> x >> y >> theta >> width >> height >> num_points;
+				if (in.status() != QDataStream::Ok || num_points > payload.size()) return false;
+
+				boost::shared_ptr<Shape> shape;
+				if (type == Shape::TYPE_RECTANGLE) {
+					shape = boost::shared_ptr<Shape>(new Rectangle(subtype, glm::dvec2(x, y), theta, width, height));
+				}
+				else if (type == Shape::TYPE_CIRCLE) {
+					shape = boost::shared_ptr<Shape>(new Circle(subtype, glm::dvec2(x, y), theta, width, height));
+				}
+				else {
+					std::vector<glm::dvec2> points(num_points);
+					for (int j = 0; j < num_points; ++j) {
+						in >> points[j].x >> points[j].y;
+					}
+					shape = boost::shared_ptr<Shape>(new Polygon(subtype, glm::dvec2(x, y), theta, points.data(), points.size()));
+				}
+				shape->setId(sessionId(id, ids));
+
+				// replace the shape of the source, or insert the new shape
+				bool replaced = false;
+				if (kept_ids.contains(shape->getId())) {
+					for (int k = 0; k < shapes.size() && !replaced; ++k) {
+						if (shapes[k]->getId() != shape->getId()) continue;
+						shapes[k] = shape;
+						replaced = true;
+					}
+				}
+				if (!replaced) {
+					if (index > shapes.size()) return false;
+					shapes.insert(shapes.begin() + index, shape);
+				}
+			}
+
+			new_layers[layer].shapes = shapes;
+			made[layer] = true;
+		}
+		if (in.status() != QDataStream::Ok) return false;
+
+		for (int i = 0; i < new_layers.size(); ++i) {
+			if (!made[i]) return false;
+		}
+
+		layers = new_layers;
+		return true;
+	}
+
+	/**
+	 * Copy the layers without the 3D geometry, so that the state of the journal is not affected by the later edits.
+	 */
+	std::vector<Layer> Journal::cloneOutlines(const std::vector<Layer>& layers) {
+		std::vector<Layer> copied_layers(layers.size());
+		for (int i = 0; i < layers.size(); ++i) {
+			copied_layers[i] = layers[i].cloneOutlines();
+		}
+		return copied_layers;
+	}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QFile>
+#include <QHash>
+#include "Layer.h"
+
+namespace canvas {
+
+	/**
+	 * Append-only journal of the committed edits for crash recovery.
+	 *
+	 * The journal refers to a base design file (empty for a new design), and each record has the difference
+	 * between the layers of the previous record and the current layers. The shapes are identified by their IDs,
+	 * so deleting a shape records only the deletion. The inserted or deleted layers are found by matching the
+	 * leading and the trailing layers which have not changed, and each of the other layers is recorded against
+	 * the previous layer it was made from. A shape is compared by its geometry version first, and only the changed
+	 * shapes are written and copied into the state of the last record, which shares the unchanged ones with the
+	 * previous state. The records are appended to the file and synced to the disk in batches by flush().
+	 * The design of the last session is recovered by loading the base file and replaying the records.
+	 *
+	 * When the journal gets long, compact() folds it into a fresh snapshot file, which becomes the new base.
+	 *
+	 * File format (little endian):
+	 *     header:  char magic[4] = "CJN1", uint32 version, QString base_filename, uint32 num_layers, base_layer[num_layers]
+	 *     base_layer: uint32 num_shapes, int32 ids[num_shapes] (the IDs of the shapes of the base file in this session)
+	 *     record:  uint32 size, uint32 checksum, payload (size bytes)
+	 *     payload: uint32 num_layers, uint32 num_leading, uint32 num_trailing, uint32 num_layer_changes, layer_change[num_layer_changes]
+	 *              (the leading layers and the trailing layers which are not in the changes are the same as the previous ones)
+	 *     layer_change: uint32 layer, int32 source, uint32 num_removed, int32 removed_ids[num_removed], uint32 num_changes, change[num_changes]
+	 *              (source is the previous layer which this layer was made from, or -1 for an empty layer)
+	 *     change:  int32 id, uint32 index, int32 type, int32 subtype, double x, y, theta, width, height, uint32 num_points, double points[num_points][2]
+	 *              (the shape is replaced if the source has its ID, or inserted at the index otherwise)
+	 */
+	class Journal {
+	public:
+		static const quint32 VERSION = 2;
+		static const int COMPACTION_THRESHOLD = 256;
+
+	private:
+		QFile file;
+		QString base_filename;
+		// the layers of the last record, whose shapes are never modified
+		std::vector<Layer> last_layers;
+		std::vector<qint64> record_offsets;
+		int generation;
+		bool dirty;
+
+	public:
+		Journal();
+		~Journal();
+
+		void start(const QString& filename, const QString& base_filename, const std::vector<Layer>& layers);
+		void append(const std::vector<Layer>& layers);
+		void flush();
+		void rebase(const QString& base_filename, const std::vector<Layer>& base_layers, qint64 position, int generation);
+		void compact(const QString& snapshot_filename);
+		void close();
+		bool isOpen() const { return file.isOpen(); }
+		int numRecords() const { return record_offsets.size(); }
+		qint64 position() const { return file.size(); }
+		int getGeneration() const { return generation; }
+		static std::vector<Layer> replay(const QString& filename, int& num_records);
+
+	private:
+		static QByteArray header(const QString& base_filename, const std::vector<Layer>& base_layers);
+		static QByteArray diff(const std::vector<Layer>& previous, const std::vector<Layer>& layers, std::vector<Layer>& snapshot);
+		static bool apply(const QByteArray& payload, std::vector<Layer>& layers, QHash<int, int>& ids);
+		static std::vector<Layer> cloneOutlines(const std::vector<Layer>& layers);
+	};
+
+}
@@ -2,9 +2,64 @@
 #include "Rectangle.h"
 #include "Circle.h"
 #include "Polygon.h"
+#include <map>
+#include <cmath>
 
 namespace canvas {
 
+	namespace {
+
+		/**
+		 * Vertex of a shape in the world coordinate system.
+		 */
+		struct ShapeVertex {
+			glm::dvec2 p;
+			int shape;
+			bool linkage;
+
+			bool operator<(const ShapeVertex& other) const { return p.x < other.p.x; }
+		};
+
+		// the vertices closer than this are considered to be shared
+		const double SHARED_VERTEX_TOLERANCE = 1e-6;
+
+		/**
+		 * Return the vertices of the shapes sorted by x.
+		 */
+		std::vector<ShapeVertex> sortedVertices(const std::vector<boost::shared_ptr<Shape> >& shapes) {
+			std::vector<ShapeVertex> vertices;
+			for (int i = 0; i < shapes.size(); ++i) {
+				std::vector<glm::dvec2> points = shapes[i]->getPoints();
+				for (int k = 0; k < points.size(); ++k) {
+					ShapeVertex v = { points[k], i, shapes[i]->getSubType() == Shape::TYPE_LINKAGE_REGION };
+					vertices.push_back(v);
+				}
+			}
+			std::sort(vertices.begin(), vertices.end());
+			return vertices;
+		}
+
+		/**
+		 * Mark the points of the specified shape which coincide with a vertex of another shape,
+		 * where either of the two shapes is a linkage region.
+		 */
+		void markSharedVertices(const std::vector<ShapeVertex>& vertices, const std::vector<glm::dvec2>& points, int shape, bool linkage, std::vector<bool>& shared) {
+			for (int i = 0; i < points.size(); ++i) {
+				ShapeVertex key = { glm::dvec2(points[i].x - SHARED_VERTEX_TOLERANCE, 0), -1, false };
+				for (std::vector<ShapeVertex>::const_iterator it = std::lower_bound(vertices.begin(), vertices.end(), key); it != vertices.end() && it->p.x <= points[i].x + SHARED_VERTEX_TOLERANCE; ++it) {
+					if (it->shape != shape && (linkage || it->linkage) && fabs(it->p.y - points[i].y) <= SHARED_VERTEX_TOLERANCE) {
+						shared[i] = true;
+						break;
+					}
+				}
+			}
+		}
+
+	}
+
+	Layer::Layer() : num_indexed_shapes(0) {
+	}
+
 	Layer Layer::clone() const {
 		Layer copied_layer;
 		for (int i = 0; i < shapes.size(); ++i) {
@@ -13,6 +68,18 @@ namespace canvas {
 		return copied_layer;
 	}
 
+	/**
+	 * Return a copy of the layer without the 3D geometry of the shapes.
+	 * The copy costs only the size of the outlines, so it is used for the snapshots written to files.
+	 */
+	Layer Layer::cloneOutlines() const {
+		Layer copied_layer;
+		for (int i = 0; i < shapes.size(); ++i) {
+			copied_layer.shapes.push_back(shapes[i]->cloneOutline());
+		}
+		return copied_layer;
+	}
+
 	void Layer::load(QDomElement& node) {
 		QDomNode shape_node = node.firstChild();
 		while (!shape_node.isNull()) {
@@ -35,6 +102,7 @@ namespace canvas {
 
 	void Layer::clear() {
 		shapes.clear();
+		updateIndex();
 	}
 
 	void Layer::selectAll() {
@@ -50,11 +118,11 @@ namespace canvas {
 	}
 
 	void Layer::deleteSelectedShapes() {
-		for (int i = shapes.size() - 1; i >= 0; --i) {
-			if (shapes[i]->isSelected()) {
-				shapes.erase(shapes.begin() + i);
-			}
+		QSet<int> ids;
+		for (int i = 0; i < shapes.size(); ++i) {
+			if (shapes[i]->isSelected()) ids.insert(shapes[i]->getId());
 		}
+		removeShapes(ids);
 	}
 
 	void Layer::copySelectedShapes(std::vector<boost::shared_ptr<Shape>>& copied_shapes) {
@@ -70,12 +138,13 @@ namespace canvas {
 		unselectAll();
 		for (int i = 0; i < copied_shapes.size(); ++i) {
 			boost::shared_ptr<Shape> shape = copied_shapes[i]->clone();
+			shape->setId(Shape::newId());
 			shape->select();
-			shapes.push_back(shape);
+			addShape(shape);
 		}
 	}
 
-	QDomElement Layer::toXml(QDomDocument& doc) {
+	QDomElement Layer::toXml(QDomDocument& doc) const {
 		QDomElement layer_node = doc.createElement("layer");
 
 		for (int i = 0; i < shapes.size(); ++i) {
@@ -87,4 +156,177 @@ namespace canvas {
 		return layer_node;
 	}
 
+	/**
+	 * Return the index of the shape which has the specified ID, or -1 if this layer does not have it.
+	 * The index is rebuilt only when it does not match the shapes any more because they were modified directly,
+	 * so looking up a shape which this layer does not have (e.g. a shape pasted into another layer) costs O(1).
+	 */
+	int Layer::indexOf(int id) const {
+		QHash<int, int>::const_iterator it = id_to_index.find(id);
+		if (it != id_to_index.end() && it.value() < shapes.size() && shapes[it.value()]->getId() == id) return it.value();
+		if (it == id_to_index.end() && num_indexed_shapes == shapes.size()) return -1;
+
+		updateIndex();
+		it = id_to_index.find(id);
+		if (it != id_to_index.end()) return it.value();
+		else return -1;
+	}
+
+	/**
+	 * Return the shape which has the specified ID, or NULL if this layer does not have it.
+	 */
+	boost::shared_ptr<Shape> Layer::findShape(int id) const {
+		int index = indexOf(id);
+		if (index >= 0) return shapes[index];
+		else return boost::shared_ptr<Shape>();
+	}
+
+	void Layer::addShape(const boost::shared_ptr<Shape>& shape) {
+		// keep the index up to date unless it is already stale
+		if (num_indexed_shapes == shapes.size()) {
+			id_to_index[shape->getId()] = shapes.size();
+			num_indexed_shapes++;
+		}
+		shapes.push_back(shape);
+	}
+
+	/**
+	 * Remove the shapes which have the specified IDs in a single pass.
+	 * The remaining shapes keep their order, so that the corresponding shapes of the other layers stay at the same index.
+	 */
+	void Layer::removeShapes(const QSet<int>& ids) {
+		if (ids.empty()) return;
+
+		int num_shapes = 0;
+		for (int i = 0; i < shapes.size(); ++i) {
+			if (ids.contains(shapes[i]->getId())) continue;
+			if (num_shapes != i) shapes[num_shapes] = shapes[i];
+			num_shapes++;
+		}
+		shapes.erase(shapes.begin() + num_shapes, shapes.end());
+
+		updateIndex();
+	}
+
+	/**
+	 * Return for each vertex of the shape whether it is shared with a linkage region of this layer
+	 * (or with any other shape if the shape itself is a linkage region). The shape does not have to belong to this layer.
+	 */
+	std::vector<bool> Layer::sharedVertices(const boost::shared_ptr<Shape>& shape) const {
+		int index = std::find(shapes.begin(), shapes.end(), shape) - shapes.begin();
+
+		std::vector<glm::dvec2> points = shape->getPoints();
+		std::vector<bool> shared(points.size(), false);
+		markSharedVertices(sortedVertices(shapes), points, index, shape->getSubType() == Shape::TYPE_LINKAGE_REGION, shared);
+
+		return shared;
+	}
+
+	/**
+	 * Give the shapes at the same index of the layers the ID of the shape in the first layer,
+	 * so that the corresponding shapes of the layers loaded from a file share the same ID.
+	 */
+	void Layer::assignIds(std::vector<Layer>& layers) {
+		if (layers.empty()) return;
+
+		for (int k = 0; k < layers[0].shapes.size(); ++k) {
+			int id = layers[0].shapes[k]->getId();
+			for (int i = 1; i < layers.size(); ++i) {
+				if (k < layers[i].shapes.size()) layers[i].shapes[k]->setId(id);
+			}
+		}
+
+		for (int i = 0; i < layers.size(); ++i) {
+			layers[i].updateIndex();
+		}
+	}
+
+	/**
+	 * Repair the outlines of the shapes which are not simple, so that they never reach the triangulation.
+	 * The corresponding polygons of the layers usually share their points, so each outline is validated only once,
+	 * and the repaired outline is shared again.
+	 * Return the number of the outlines which have been repaired.
+	 */
+	int Layer::repairShapes(std::vector<Layer>& layers) {
+		int num_repaired = 0;
+
+		// the first polygon of each outline
+		std::map<const std::vector<glm::dvec2>*, boost::shared_ptr<Polygon> > checked;
+		for (int i = 0; i < layers.size(); ++i) {
+			for (int k = 0; k < layers[i].shapes.size(); ++k) {
+				if (layers[i].shapes[k]->getType() != Shape::TYPE_POLYGON) continue;
+
+				boost::shared_ptr<Polygon> polygon = boost::static_pointer_cast<Polygon>(layers[i].shapes[k]);
+				const std::vector<glm::dvec2>* key = polygon->getSharedPoints().get();
+				std::map<const std::vector<glm::dvec2>*, boost::shared_ptr<Polygon> >::iterator it = checked.find(key);
+				if (it == checked.end()) {
+					checked[key] = polygon;
+					if (polygon->repair() != glutils::PolygonValidator::VALID) num_repaired++;
+				}
+				else if (it->second->getSharedPoints().get() != key) {
+					// the outline has been repaired in another layer
+					polygon->repair();
+					polygon->shareGeometry(it->second);
+				}
+			}
+		}
+
+		return num_repaired;
+	}
+
+	/**
+	 * Simplify the outlines of the polygons by the tolerance, keeping the vertices shared with the linkage regions in any layer.
+	 * As in repairShapes(), each shared outline is simplified only once, and the simplified outline is shared again.
+	 * Return the number of the removed vertices.
+	 */
+	int Layer::simplifyShapes(std::vector<Layer>& layers, double tolerance) {
+		int num_removed = 0;
+
+		// the vertices of each outline which are shared in any layer
+		std::map<const std::vector<glm::dvec2>*, std::vector<bool> > pinned;
+		for (int i = 0; i < layers.size(); ++i) {
+			std::vector<ShapeVertex> vertices = sortedVertices(layers[i].shapes);
+			for (int k = 0; k < layers[i].shapes.size(); ++k) {
+				if (layers[i].shapes[k]->getType() != Shape::TYPE_POLYGON) continue;
+
+				boost::shared_ptr<Polygon> polygon = boost::static_pointer_cast<Polygon>(layers[i].shapes[k]);
+				std::vector<bool>& shared = pinned[polygon->getSharedPoints().get()];
+				if (shared.empty()) shared.resize(polygon->getLocalPoints().size(), false);
+				markSharedVertices(vertices, polygon->getPoints(), k, polygon->getSubType() == Shape::TYPE_LINKAGE_REGION, shared);
+			}
+		}
+
+		// the first polygon of each outline
+		std::map<const std::vector<glm::dvec2>*, boost::shared_ptr<Polygon> > simplified;
+		for (int i = 0; i < layers.size(); ++i) {
+			for (int k = 0; k < layers[i].shapes.size(); ++k) {
+				if (layers[i].shapes[k]->getType() != Shape::TYPE_POLYGON) continue;
+
+				boost::shared_ptr<Polygon> polygon = boost::static_pointer_cast<Polygon>(layers[i].shapes[k]);
+				const std::vector<glm::dvec2>* key = polygon->getSharedPoints().get();
+				std::map<const std::vector<glm::dvec2>*, boost::shared_ptr<Polygon> >::iterator it = simplified.find(key);
+				if (it == simplified.end()) {
+					simplified[key] = polygon;
+					num_removed += polygon->simplify(tolerance, pinned[key]);
+				}
+				else if (it->second->getSharedPoints().get() != key) {
+					// the outline has been simplified in another layer
+					polygon->simplify(tolerance, pinned[key]);
+					polygon->shareGeometry(it->second);
+				}
+			}
+		}
+
+		return num_removed;
+	}
+
+	void Layer::updateIndex() const {
+		id_to_index.clear();
+		id_to_index.reserve(shapes.size());
+		for (int i = 0; i < shapes.size(); ++i) {
+			id_to_index[shapes[i]->getId()] = i;
+		}
+		num_indexed_shapes = shapes.size();
+	}
+
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <boost/shared_ptr.hpp>
 #include "Shape.h"
 #include <QDomDocument>
+#include <QHash>
+#include <QSet>
 #include "Vertex.h"
 #include <algorithm>
 #include <vector>
@@ -15,8 +17,15 @@ namespace canvas {
 	public:
 		std::vector<boost::shared_ptr<Shape>> shapes;
 
+	private:
+		mutable QHash<int, int> id_to_index;
+		// the number of the shapes when the index was built
+		mutable int num_indexed_shapes;
+
 	public:
+		Layer();
 		Layer clone() const;
+		Layer cloneOutlines() const;
 		void load(QDomElement& node);
 		void clear();
 		void selectAll();
@@ -24,7 +33,18 @@ namespace canvas {
 		void deleteSelectedShapes();
 		void copySelectedShapes(std::vector<boost::shared_ptr<Shape>>& copied_shapes);
 		void pasteCopiedShapes(std::vector<boost::shared_ptr<Shape>>& copied_shapes);
-		QDomElement toXml(QDomDocument& doc);
+		QDomElement toXml(QDomDocument& doc) const;
+		int indexOf(int id) const;
+		boost::shared_ptr<Shape> findShape(int id) const;
+		void addShape(const boost::shared_ptr<Shape>& shape);
+		void removeShapes(const QSet<int>& ids);
+		std::vector<bool> sharedVertices(const boost::shared_ptr<Shape>& shape) const;
+		static void assignIds(std::vector<Layer>& layers);
+		static int repairShapes(std::vector<Layer>& layers);
+		static int simplifyShapes(std::vector<Layer>& layers, double tolerance);
+
+	private:
+		void updateIndex() const;
 	};
 
 }
\ No newline at end of file
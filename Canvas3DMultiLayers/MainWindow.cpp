@@ -4,6 +4,10 @@
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 	ui.setupUi(this);
 
+	// the result of the collision check, which stays next to the temporary messages
+	labelCollisions = new QLabel(this);
+	statusBar()->addPermanentWidget(labelCollisions);
+
 	glWidget = new GLWidget3D(this);
 	setCentralWidget(glWidget);
 
@@ -17,6 +21,56 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 	groupLayer = new QActionGroup(this);
 	initLayerMenu(2);
 
+	// timeline to play the motion of the shapes through the layers
+	actionPlay = ui.mainToolBar->addAction(tr("Play"));
+	actionPlay->setCheckable(true);
+	actionPlay->setShortcut(QKeySequence(Qt::Key_Space));
+	sliderTimeline = new QSlider(Qt::Horizontal, this);
+	sliderTimeline->setRange(0, 1000);
+	ui.mainToolBar->addWidget(sliderTimeline);
+	spinAnimationSpeed = new QDoubleSpinBox(this);
+	spinAnimationSpeed->setRange(0.1, 100.0);
+	spinAnimationSpeed->setSingleStep(0.5);
+	spinAnimationSpeed->setValue(1.0);
+	spinAnimationSpeed->setSuffix(tr(" layers/s"));
+	ui.mainToolBar->addWidget(spinAnimationSpeed);
+
+	// show the other layers as translucent ghosts in 3D
+	ui.mainToolBar->addSeparator();
+	actionOnionSkin = ui.mainToolBar->addAction(tr("Onion Skin"));
+	actionOnionSkin->setCheckable(true);
+
+	// tolerance of simplifying the drawn and imported polygons
+	ui.mainToolBar->addSeparator();
+	spinSimplifyTolerance = new QDoubleSpinBox(this);
+	spinSimplifyTolerance->setRange(0.0, 100.0);
+	spinSimplifyTolerance->setSingleStep(0.5);
+	spinSimplifyTolerance->setValue(0.0);
+	spinSimplifyTolerance->setPrefix(tr("Simplify: "));
+	spinSimplifyTolerance->setSpecialValueText(tr("Simplify: Off"));
+	ui.mainToolBar->addWidget(spinSimplifyTolerance);
+
+	// check the bodies for the collisions and the clearance violations
+	ui.mainToolBar->addSeparator();
+	actionCollisions = ui.mainToolBar->addAction(tr("Collisions"));
+	actionCollisions->setCheckable(true);
+	spinClearance = new QDoubleSpinBox(this);
+	spinClearance->setRange(0.0, 100.0);
+	spinClearance->setSingleStep(0.5);
+	spinClearance->setValue(0.0);
+	spinClearance->setPrefix(tr("Clearance: "));
+	ui.mainToolBar->addWidget(spinClearance);
+
+	// GPU memory for keeping the shadow maps of the layers
+	ui.mainToolBar->addSeparator();
+	spinShadowMemory = new QSpinBox(this);
+	spinShadowMemory->setRange(0, 16384);
+	spinShadowMemory->setSingleStep(256);
+	spinShadowMemory->setValue(ShadowMapping::DEFAULT_MEMORY_BUDGET_MB);
+	spinShadowMemory->setPrefix(tr("Shadow cache: "));
+	spinShadowMemory->setSuffix(tr(" MB"));
+	ui.mainToolBar->addWidget(spinShadowMemory);
+
 	connect(ui.actionNew, SIGNAL(triggered()), this, SLOT(onNew()));
 	connect(ui.actionOpen, SIGNAL(triggered()), this, SLOT(onOpen()));
 	connect(ui.actionSave, SIGNAL(triggered()), this, SLOT(onSave()));
@@ -31,6 +85,14 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 	connect(ui.actionRectangle, SIGNAL(triggered()), this, SLOT(onModeChanged()));
 	connect(ui.actionCircle, SIGNAL(triggered()), this, SLOT(onModeChanged()));
 	connect(ui.actionPolygon, SIGNAL(triggered()), this, SLOT(onModeChanged()));
+	connect(actionPlay, SIGNAL(triggered()), this, SLOT(onPlay()));
+	connect(sliderTimeline, SIGNAL(valueChanged(int)), this, SLOT(onTimelineChanged(int)));
+	connect(spinAnimationSpeed, SIGNAL(valueChanged(double)), this, SLOT(onAnimationSpeedChanged(double)));
+	connect(actionOnionSkin, SIGNAL(triggered()), this, SLOT(onOnionSkin()));
+	connect(spinSimplifyTolerance, SIGNAL(valueChanged(double)), this, SLOT(onSimplifyToleranceChanged(double)));
+	connect(actionCollisions, SIGNAL(triggered()), this, SLOT(onCollisions()));
+	connect(spinClearance, SIGNAL(valueChanged(double)), this, SLOT(onClearanceChanged(double)));
+	connect(spinShadowMemory, SIGNAL(valueChanged(int)), this, SLOT(onShadowMemoryChanged(int)));
 }
 
 MainWindow::~MainWindow() {
@@ -60,7 +122,7 @@ void MainWindow::onNew() {
 }
 
 void MainWindow::onOpen() {
-	QString filename = QFileDialog::getOpenFileName(this, tr("Open design file..."), "", tr("Design files (*.xml)"));
+	QString filename = QFileDialog::getOpenFileName(this, tr("Open design file..."), "", tr("Design files (*.xml *.cdb);;XML design files (*.xml);;Binary design files (*.cdb)"));
 	if (filename.isEmpty()) return;
 
 	glWidget->open(filename);
@@ -68,7 +130,7 @@ void MainWindow::onOpen() {
 }
 
 void MainWindow::onSave() {
-	QString filename = QFileDialog::getSaveFileName(this, tr("Save design file..."), "", tr("Design files (*.xml)"));
+	QString filename = QFileDialog::getSaveFileName(this, tr("Save design file..."), "", tr("XML design files (*.xml);;Binary design files (*.cdb)"));
 	if (filename.isEmpty()) return;
 
 	glWidget->save(filename);
@@ -159,4 +221,54 @@ void MainWindow::onLayerChanged() {
 			break;
 		}
 	}
+}
+
+/**
+ * Reflect the state of the playback in the timeline.
+ *
+ * @param position	position in the timeline between 0 (the first layer) and 1 (the last layer)
+ * @param playing	true if the playback is running
+ */
+void MainWindow::updateAnimationControls(double position, bool playing) {
+	sliderTimeline->blockSignals(true);
+	sliderTimeline->setValue(position * sliderTimeline->maximum());
+	sliderTimeline->blockSignals(false);
+	actionPlay->setChecked(playing);
+}
+
+void MainWindow::onPlay() {
+	if (actionPlay->isChecked()) {
+		glWidget->startAnimation();
+	}
+	else {
+		glWidget->stopAnimation();
+	}
+}
+
+void MainWindow::onTimelineChanged(int value) {
+	glWidget->setAnimationTime((double)value / sliderTimeline->maximum() * (glWidget->layers.size() - 1));
+}
+
+void MainWindow::onAnimationSpeedChanged(double speed) {
+	glWidget->setAnimationSpeed(speed);
+}
+
+void MainWindow::onOnionSkin() {
+	glWidget->setOnionSkin(actionOnionSkin->isChecked());
+}
+
+void MainWindow::onSimplifyToleranceChanged(double tolerance) {
+	glWidget->setSimplifyTolerance(tolerance);
+}
+
+void MainWindow::onCollisions() {
+	glWidget->setCollisionCheck(actionCollisions->isChecked());
+}
+
+void MainWindow::onClearanceChanged(double clearance) {
+	glWidget->setClearance(clearance);
+}
+
+void MainWindow::onShadowMemoryChanged(int megabytes) {
+	glWidget->setShadowMemoryBudget(megabytes);
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 #define MAINWINDOW_H
 
 #include <QtWidgets/QMainWindow>
+#include <QSlider>
+#include <QDoubleSpinBox>
+#include <QSpinBox>
+#include <QLabel>
 #include "ui_MainWindow.h"
 #include "GLWidget3D.h"
 
@@ -13,12 +17,22 @@ public:
 	std::vector<QAction*> menuLayers;
 	QActionGroup* groupLayer;
 	GLWidget3D* glWidget;
+	QAction* actionPlay;
+	QAction* actionOnionSkin;
+	QAction* actionCollisions;
+	QSlider* sliderTimeline;
+	QDoubleSpinBox* spinAnimationSpeed;
+	QDoubleSpinBox* spinSimplifyTolerance;
+	QDoubleSpinBox* spinClearance;
+	QSpinBox* spinShadowMemory;
+	QLabel* labelCollisions;
 
 public:
 	MainWindow(QWidget *parent = 0);
 	~MainWindow();
 
 	void initLayerMenu(int num_layers);
+	void updateAnimationControls(double position, bool playing);
 
 protected:
 	void keyPressEvent(QKeyEvent* e);
@@ -39,6 +53,14 @@ public slots:
 	void onInsertLayer();
 	void onDeleteLayer();
 	void onLayerChanged();
+	void onPlay();
+	void onTimelineChanged(int value);
+	void onAnimationSpeedChanged(double speed);
+	void onOnionSkin();
+	void onSimplifyToleranceChanged(double tolerance);
+	void onCollisions();
+	void onClearanceChanged(double clearance);
+	void onShadowMemoryChanged(int megabytes);
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,86 @@
+#include "OffscreenRenderer.h"
+#include <QSurfaceFormat>
+
+OffscreenRenderer::OffscreenRenderer() {
+	fbo = NULL;
+	width = 0;
+	height = 0;
+
+	// the same light as GLWidget3D
+	light_dir = RenderManager::defaultLightDir();
+	light_mvpMatrix = RenderManager::lightMvpMatrixFor(light_dir);
+}
+
+OffscreenRenderer::~OffscreenRenderer() {
+	// the OpenGL resources have to be released while the context is current
+	if (context.isValid()) {
+		context.makeCurrent(&surface);
+		renderManager.removeObjects();
+		delete fbo;
+	}
+}
+
+/**
+ * Create the offscreen context and the rendering engine.
+ * This has to be called from the GUI thread.
+ */
+void OffscreenRenderer::init(int width, int height) {
+	this->width = width;
+	this->height = height;
+
+	// the shaders use the fixed function states as well, so the compatibility profile is required
+	QSurfaceFormat format;
+	format.setVersion(4, 2);
+	format.setProfile(QSurfaceFormat::CompatibilityProfile);
+	format.setDepthBufferSize(24);
+
+	surface.setFormat(format);
+	surface.create();
+	context.setFormat(format);
+	if (!context.create()) throw "OpenGL context cannot be created.";
+	if (!context.makeCurrent(&surface)) throw "OpenGL context cannot be made current.";
+
+	fbo = new QOpenGLFramebufferObject(width, height, QOpenGLFramebufferObject::Depth);
+
+	renderManager.init("", "", "", true, 8192);
+	renderManager.resize(width, height);
+	renderManager.defaultFramebuffer = fbo->handle();
+
+	camera.updatePMatrix(width, height);
+}
+
+/**
+ * Replace the objects to be rendered by the body shapes of the layer.
+ */
+void OffscreenRenderer::setLayer(const canvas::Layer& layer) {
+	renderManager.removeObjects();
+	for (int i = 0; i < layer.shapes.size(); i++) {
+		if (layer.shapes[i]->getSubType() == canvas::Shape::TYPE_BODY) {
+			QString obj_name = QString("object_%1").arg(layer.shapes[i]->getId());
+			renderManager.addObject(obj_name, "", layer.shapes[i]->getVertices(), true);
+		}
+	}
+
+	// upload the vertices now instead of at the first draw call
+	for (auto it = renderManager.objects.begin(); it != renderManager.objects.end(); ++it) {
+		for (auto it2 = it->begin(); it2 != it->end(); ++it2) {
+			it2->createVAO();
+		}
+	}
+}
+
+void OffscreenRenderer::updateShadowMap() {
+	renderManager.updateShadowMap(light_dir, light_mvpMatrix);
+}
+
+void OffscreenRenderer::render() {
+	glViewport(0, 0, width, height);
+	renderManager.render(camera, light_dir, light_mvpMatrix);
+}
+
+/**
+ * Read back the rendered image from the framebuffer object.
+ */
+QImage OffscreenRenderer::readImage() {
+	return fbo->toImage();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "glew.h"
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QImage>
+#include "RenderManager.h"
+#include "Camera.h"
+#include "Layer.h"
+
+/**
+ * Renderer of the designs without a window.
+ * The same rendering pipeline as GLWidget3D runs on an offscreen surface, and the final image is
+ * rendered into a framebuffer object instead of the window.
+ */
+class OffscreenRenderer {
+public:
+	QOffscreenSurface surface;
+	QOpenGLContext context;
+	QOpenGLFramebufferObject* fbo;
+	RenderManager renderManager;
+
+	// camera
+	Camera camera;
+	glm::vec3 light_dir;
+	glm::mat4 light_mvpMatrix;
+
+	int width;
+	int height;
+
+public:
+	OffscreenRenderer();
+	~OffscreenRenderer();
+
+	void init(int width, int height);
+	void setLayer(const canvas::Layer& layer);
+	void updateShadowMap();
+	void render();
+	QImage readImage();
+};
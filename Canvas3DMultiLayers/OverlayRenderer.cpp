@@ -0,0 +1,178 @@
+#include "OverlayRenderer.h"
+#include <QGLWidget>
+
+OverlayRenderer::OverlayRenderer() {
+	program = 0;
+	vao = 0;
+	vbo = 0;
+	vboCapacity = 0;
+	markerTexture = 0;
+}
+
+OverlayRenderer::~OverlayRenderer() {
+}
+
+/**
+ * Create the vao and the texture of the rotation marker.
+ * This has to be called after the OpenGL context is initialized.
+ */
+void OverlayRenderer::init(GLuint program, const QImage& marker) {
+	this->program = program;
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	// configure the attributes in the vao
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, color));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, texCoord));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, textured));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// upload the rotation marker
+	QImage GL_formatted_image = QGLWidget::convertToGLFormat(marker);
+	glGenTextures(1, &markerTexture);
+	glBindTexture(GL_TEXTURE_2D, markerTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, GL_formatted_image.width(), GL_formatted_image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, GL_formatted_image.bits());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	markerSize = glm::vec2(marker.width(), marker.height());
+}
+
+/**
+ * Discard the primitives accumulated for the previous frame.
+ */
+void OverlayRenderer::clear() {
+	vertices.clear();
+}
+
+/**
+ * Add filled triangles. Every three points in the list form a triangle.
+ */
+void OverlayRenderer::addTriangles(const std::vector<glm::vec2>& points, const glm::vec4& color) {
+	for (int i = 0; i + 2 < points.size(); i += 3) {
+		vertices.push_back(OverlayVertex(points[i], color));
+		vertices.push_back(OverlayVertex(points[i + 1], color));
+		vertices.push_back(OverlayVertex(points[i + 2], color));
+	}
+}
+
+/**
+ * Add a polyline of the specified width in pixels.
+ * Each segment is a quad extended by the half of the width at both ends so that the corners are filled.
+ */
+void OverlayRenderer::addPolyline(const std::vector<glm::vec2>& points, const glm::vec4& color, float lineWidth, bool closed) {
+	int num_segments = closed ? points.size() : (int)points.size() - 1;
+	float w = lineWidth * 0.5f;
+	for (int i = 0; i < num_segments; ++i) {
+		glm::vec2 p1 = points[i];
+		glm::vec2 p2 = points[(i + 1) % points.size()];
+		glm::vec2 dir = p2 - p1;
+		float len = glm::length(dir);
+		dir = len > 0 ? dir / len : glm::vec2(1, 0);
+		glm::vec2 n(-dir.y, dir.x);
+
+		addQuad(p1 - dir * w - n * w, p2 + dir * w - n * w, p2 + dir * w + n * w, p1 - dir * w + n * w, color);
+	}
+}
+
+/**
+ * Add a filled square with a one-pixel outline, which is used for the resize markers.
+ * The angle is in radian in the screen coordinate system.
+ */
+void OverlayRenderer::addSquare(const glm::vec2& center, float size, float angle, const glm::vec4& fillColor, const glm::vec4& lineColor) {
+	glm::vec2 u(cos(angle) * size * 0.5f, sin(angle) * size * 0.5f);
+	glm::vec2 v(-u.y, u.x);
+
+	std::vector<glm::vec2> corners(4);
+	corners[0] = center - u - v;
+	corners[1] = center + u - v;
+	corners[2] = center + u + v;
+	corners[3] = center - u + v;
+
+	addQuad(corners[0], corners[1], corners[2], corners[3], fillColor);
+	addPolyline(corners, lineColor, 1, true);
+}
+
+/**
+ * Add the rotation marker image centered at the specified point.
+ * The angle is in radian in the screen coordinate system.
+ */
+void OverlayRenderer::addMarker(const glm::vec2& center, float angle) {
+	glm::vec2 u = glm::vec2(cos(angle), sin(angle)) * markerSize.x * 0.5f;
+	glm::vec2 v = glm::vec2(-sin(angle), cos(angle)) * markerSize.y * 0.5f;
+	glm::vec4 white(1, 1, 1, 1);
+
+	// the image is flipped vertically by convertToGLFormat, so the top of the image is at t = 1
+	OverlayVertex v0(center - u - v, white, glm::vec2(0, 1), 1);
+	OverlayVertex v1(center + u - v, white, glm::vec2(1, 1), 1);
+	OverlayVertex v2(center + u + v, white, glm::vec2(1, 0), 1);
+	OverlayVertex v3(center - u + v, white, glm::vec2(0, 0), 1);
+
+	vertices.push_back(v0);
+	vertices.push_back(v1);
+	vertices.push_back(v2);
+	vertices.push_back(v0);
+	vertices.push_back(v2);
+	vertices.push_back(v3);
+}
+
+/**
+ * Draw all the accumulated primitives by a single draw call.
+ * The buffer is re-allocated only when it gets too small, and is otherwise updated in place.
+ */
+void OverlayRenderer::render(int width, int height) {
+	if (vertices.empty()) return;
+
+	glUseProgram(program);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glUniform2f(glGetUniformLocation(program, "viewportSize"), width, height);
+	glUniform1i(glGetUniformLocation(program, "tex0"), 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, markerTexture);
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	if (vertices.size() > vboCapacity) {
+		vboCapacity = vertices.size() * 2;
+		glBufferData(GL_ARRAY_BUFFER, sizeof(OverlayVertex) * vboCapacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(OverlayVertex) * vertices.size(), vertices.data());
+
+	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_BLEND);
+}
+
+glm::vec4 OverlayRenderer::color(const QColor& c) {
+	return glm::vec4(c.redF(), c.greenF(), c.blueF(), c.alphaF());
+}
+
+void OverlayRenderer::addQuad(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, const glm::vec4& color) {
+	vertices.push_back(OverlayVertex(p0, color));
+	vertices.push_back(OverlayVertex(p1, color));
+	vertices.push_back(OverlayVertex(p2, color));
+	vertices.push_back(OverlayVertex(p0, color));
+	vertices.push_back(OverlayVertex(p2, color));
+	vertices.push_back(OverlayVertex(p3, color));
+}
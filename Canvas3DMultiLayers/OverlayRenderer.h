@@ -0,0 +1,60 @@
+#pragma once
+
+#include "glew.h"
+#include <vector>
+#include <glm/glm.hpp>
+#include <QImage>
+#include <QColor>
+
+/**
+ * This structure defines a vertex of the 2D overlay.
+ * The position is in the screen coordinate system (pixels, the origin at the top-left corner).
+ */
+struct OverlayVertex {
+	glm::vec2 position;
+	glm::vec4 color;
+	glm::vec2 texCoord;
+	float textured;	// 0 -- plain color / 1 -- modulated by the rotation marker texture
+
+	OverlayVertex() {}
+
+	OverlayVertex(const glm::vec2& pos, const glm::vec4& c, const glm::vec2& tex = glm::vec2(), float textured = 0.0f) {
+		position = pos;
+		color = c;
+		texCoord = tex;
+		this->textured = textured;
+	}
+};
+
+/**
+ * Batch renderer of the 2D editing overlay.
+ * The outlines, fills, and markers of all the shapes are accumulated as triangles in the screen
+ * coordinate system, and are drawn by a single draw call instead of a QPainter call per primitive.
+ */
+class OverlayRenderer {
+public:
+	GLuint program;
+	GLuint vao;
+	GLuint vbo;
+	int vboCapacity;
+	GLuint markerTexture;
+	glm::vec2 markerSize;
+	std::vector<OverlayVertex> vertices;
+
+public:
+	OverlayRenderer();
+	~OverlayRenderer();
+
+	void init(GLuint program, const QImage& marker);
+	void clear();
+	void addTriangles(const std::vector<glm::vec2>& points, const glm::vec4& color);
+	void addPolyline(const std::vector<glm::vec2>& points, const glm::vec4& color, float lineWidth, bool closed);
+	void addSquare(const glm::vec2& center, float size, float angle, const glm::vec4& fillColor, const glm::vec4& lineColor);
+	void addMarker(const glm::vec2& center, float angle);
+	void render(int width, int height);
+
+	static glm::vec4 color(const QColor& c);
+
+private:
+	void addQuad(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, const glm::vec4& color);
+};
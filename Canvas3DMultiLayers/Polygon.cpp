@@ -1,4 +1,7 @@
 #include "Polygon.h"
+#include "OverlayRenderer.h"
+#include "Trace.h"
+#include "PolygonSimplifier.h"
 #include <boost/geometry.hpp>
 #include <boost/geometry/core/point_type.hpp>
 #include <boost/geometry/geometries/point.hpp>
@@ -11,14 +14,14 @@
 
 namespace canvas {
 
-	Polygon::Polygon(int subtype) : Shape(subtype) {
+	Polygon::Polygon(int subtype) : Shape(subtype), points(new std::vector<glm::dvec2>()) {
 		type = TYPE_POLYGON;
 		theta = 0;
 	}
 
-	Polygon::Polygon(int subtype, const glm::dvec2& point) : Shape(subtype) {
+	Polygon::Polygon(int subtype, const glm::dvec2& point) : Shape(subtype), points(new std::vector<glm::dvec2>()) {
 		type = TYPE_POLYGON;
-		points.push_back(glm::dvec2());
+		points->push_back(glm::dvec2());
 		pos = point;
 		theta = 0;
 
@@ -27,8 +30,9 @@ namespace canvas {
 
 	/**
 	* Construct a polygon from the xml dom node.
+	* The 3D geometry is not generated until it is used, so that the outline can be validated first.
 	*/
-	Polygon::Polygon(int subtype, QDomNode& node) : Shape(subtype) {
+	Polygon::Polygon(int subtype, QDomNode& node) : Shape(subtype), points(new std::vector<glm::dvec2>()) {
 		type = TYPE_POLYGON;
 		QDomNode params_node = node.firstChild();
 		while (!params_node.isNull()) {
@@ -41,13 +45,37 @@ namespace canvas {
 				double x = params_node.toElement().attribute("x").toDouble();
 				double y = params_node.toElement().attribute("y").toDouble();
 
-				points.push_back(glm::dvec2(x, y));
+				points->push_back(glm::dvec2(x, y));
 			}
 
 			params_node = params_node.nextSibling();
 		}
 
-		update3DGeometry();
+		geometry_outdated = true;
+	}
+
+	/**
+	 * Construct a polygon from the parameters read from a file.
+	 * The points are copied from the array, which can be a view into a memory-mapped file.
+	 * The 3D geometry is not generated until it is used.
+	 */
+	Polygon::Polygon(int subtype, const glm::dvec2& pos, double theta, const glm::dvec2* points, int num_points) : Shape(subtype) {
+		type = TYPE_POLYGON;
+		this->pos = pos;
+		this->theta = theta;
+		this->points = boost::shared_ptr<std::vector<glm::dvec2> >(new std::vector<glm::dvec2>(points, points + num_points));
+		geometry_outdated = true;
+	}
+
+	/**
+	 * Construct a polygon which shares the points with the polygons of the other layers.
+	 * The points are copied when this polygon is modified.
+	 */
+	Polygon::Polygon(int subtype, const glm::dvec2& pos, double theta, const boost::shared_ptr<std::vector<glm::dvec2> >& points) : Shape(subtype), points(points) {
+		type = TYPE_POLYGON;
+		this->pos = pos;
+		this->theta = theta;
+		geometry_outdated = true;
 	}
 
 	Polygon::~Polygon() {
@@ -57,6 +85,16 @@ namespace canvas {
 		return boost::shared_ptr<Shape>(new Polygon(*this));
 	}
 
+	/**
+	 * Return a copy of the polygon without the 3D geometry, e.g., for writing the design to a file.
+	 * The points are shared, and copied when either polygon is modified.
+	 */
+	boost::shared_ptr<Shape> Polygon::cloneOutline() const {
+		Polygon* new_polygon = new Polygon(subtype, pos, theta, points);
+		new_polygon->copyIdentity(*this);
+		return boost::shared_ptr<Shape>(new_polygon);
+	}
+
 	void Polygon::draw(QPainter& painter, const QPointF& origin, double scale) const {
 		painter.save();
 
@@ -64,10 +102,10 @@ namespace canvas {
 		painter.rotate(-theta / 3.14159265 * 180);
 
 		if (selected || currently_drawing) {
-			painter.setPen(QPen(QColor(0, 0, 255), 2));
+			painter.setPen(pens[1]);
 		}
 		else {
-			painter.setPen(QPen(QColor(0, 0, 0), 1));
+			painter.setPen(pens[0]);
 		}
 		if (currently_drawing) {
 			painter.setBrush(QBrush(QColor(0, 0, 0, 0)));
@@ -77,9 +115,12 @@ namespace canvas {
 		}
 
 		// draw edges
+		// (the vertices closer than a pixel to the previous one are skipped since they cannot be seen on the screen)
 		QPolygonF pol;
-		for (int i = 0; i < points.size(); ++i) {
-			pol.push_back(QPointF(points[i].x * scale, -points[i].y * scale));
+		for (int i = 0; i < points->size(); ++i) {
+			QPointF pt((*points)[i].x * scale, -(*points)[i].y * scale);
+			if (pol.size() > 0 && i < points->size() - 1 && abs(pt.x() - pol.back().x()) < 1 && abs(pt.y() - pol.back().y()) < 1) continue;
+			pol.push_back(pt);
 		}
 		if (currently_drawing) {
 			pol.push_back(QPointF(current_point.x * scale, -current_point.y * scale));
@@ -92,7 +133,7 @@ namespace canvas {
 		if (selected) {
 			// show resize marker
 			BoundingBox bbox = boundingBox();
-			painter.setPen(QPen(QColor(0, 0, 0), 1));
+			painter.setPen(pens[0]);
 			painter.setBrush(QBrush(QColor(0, 0, 0, 0)));
 			painter.drawRect(bbox.minPt.x * scale, -bbox.minPt.y * scale, bbox.width() * scale, -bbox.height() * scale);
 			painter.setBrush(QBrush(QColor(255, 255, 255)));
@@ -108,6 +149,39 @@ namespace canvas {
 		painter.restore();
 	}
 
+	/**
+	 * Add the polygon to the batch of the OpenGL overlay renderer.
+	 * While drawing, the polygon is shown as an open polyline ending at the current mouse position.
+	 */
+	void Polygon::draw(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const {
+		if (!currently_drawing) {
+			Shape::draw(renderer, origin, scale);
+			return;
+		}
+
+		std::vector<glm::vec2> pts;
+		for (int i = 0; i < points->size(); ++i) {
+			pts.push_back(screenCoordinate(worldCoordinate((*points)[i]), origin, scale));
+		}
+		pts.push_back(screenCoordinate(worldCoordinate(current_point), origin, scale));
+		renderer.addPolyline(pts, OverlayRenderer::color(pens[1].color()), pens[1].width(), false);
+	}
+
+	/**
+	 * Add the bounding box in addition to the resize and rotation markers.
+	 */
+	void Polygon::drawMarkers(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const {
+		BoundingBox bbox = boundingBox();
+		std::vector<glm::vec2> corners(4);
+		corners[0] = screenCoordinate(worldCoordinate(bbox.minPt), origin, scale);
+		corners[1] = screenCoordinate(worldCoordinate(glm::dvec2(bbox.maxPt.x, bbox.minPt.y)), origin, scale);
+		corners[2] = screenCoordinate(worldCoordinate(bbox.maxPt), origin, scale);
+		corners[3] = screenCoordinate(worldCoordinate(glm::dvec2(bbox.minPt.x, bbox.maxPt.y)), origin, scale);
+		renderer.addPolyline(corners, OverlayRenderer::color(pens[0].color()), pens[0].width(), true);
+
+		Shape::drawMarkers(renderer, origin, scale);
+	}
+
 	QDomElement Polygon::toXml(QDomDocument& doc) const {
 		QDomElement shape_node = doc.createElement("shape");
 		shape_node.setAttribute("type", "polygon");
@@ -119,10 +193,10 @@ namespace canvas {
 		pose_node.setAttribute("theta", theta);
 		shape_node.appendChild(pose_node);
 
-		for (int i = 0; i < points.size(); ++i) {
+		for (int i = 0; i < points->size(); ++i) {
 			QDomElement point_node = doc.createElement("point");
-			point_node.setAttribute("x", points[i].x);
-			point_node.setAttribute("y", points[i].y);
+			point_node.setAttribute("x", (*points)[i].x);
+			point_node.setAttribute("y", (*points)[i].y);
 			shape_node.appendChild(point_node);
 		}
 
@@ -131,8 +205,10 @@ namespace canvas {
 
 	void Polygon::addPoint(const glm::dvec2& point) {
 		//points.push_back(point);
-		points.push_back(current_point);
+		detachPoints();
+		points->push_back(current_point);
 		current_point = point;
+		updateGeometryVersion();
 	}
 
 	/**
@@ -140,8 +216,22 @@ namespace canvas {
 	*/
 	std::vector<glm::dvec2> Polygon::getPoints() const {
 		std::vector<glm::dvec2> pts;
-		for (int i = 0; i < points.size(); ++i) {
-			pts.push_back(worldCoordinate(points[i]));
+		for (int i = 0; i < points->size(); ++i) {
+			pts.push_back(worldCoordinate((*points)[i]));
+		}
+		return pts;
+	}
+
+	/**
+	 * Return the points of the outline drawn on the screen of the given scale.
+	 * The vertices closer than a pixel to the previous one are skipped since they cannot be seen on the screen.
+	 */
+	std::vector<glm::dvec2> Polygon::getOutline(double scale) const {
+		std::vector<glm::dvec2> pts;
+		for (int i = 0; i < points->size(); ++i) {
+			glm::dvec2 pt = worldCoordinate((*points)[i]);
+			if (pts.size() > 0 && i < points->size() - 1 && abs(pt.x - pts.back().x) * scale < 1 && abs(pt.y - pts.back().y) * scale < 1) continue;
+			pts.push_back(pt);
 		}
 		return pts;
 	}
@@ -149,11 +239,11 @@ namespace canvas {
 	void Polygon::updateByNewPoint(const glm::dvec2& point, bool shiftPressed) {
 		current_point = point;
 		if (shiftPressed) {
-			if (abs(point.x - points.back().x) > abs(point.y - points.back().y)) {
-				current_point.y = points.back().y;
+			if (abs(point.x - points->back().x) > abs(point.y - points->back().y)) {
+				current_point.y = points->back().y;
 			}
 			else {
-				current_point.x = points.back().x;
+				current_point.x = points->back().x;
 			}
 		}
 	}
@@ -164,7 +254,7 @@ namespace canvas {
 	bool Polygon::hit(const glm::dvec2& point) const {
 		glm::dvec2 pt = localCoordinate(point);
 
-		return withinPolygon(points, pt);
+		return withinPolygon(*points, pt);
 	}
 	
 	/**
@@ -172,12 +262,14 @@ namespace canvas {
 	* The resizing scale and the center of the resizing are specified as local coordinates.
 	*/
 	void Polygon::resize(const glm::dvec2& scale, const glm::dvec2& resize_center) {
+		TRACE_SCOPE("Polygon::resize");
 		BoundingBox bbox = boundingBox();
 		glm::dvec2 offset(resize_center.x * (1.0 - scale.x), resize_center.y * (1.0 - scale.y));
 				
-		for (int i = 0; i < points.size(); ++i) {
-			points[i].x = (points[i].x - resize_center.x) * scale.x + resize_center.x - offset.x;
-			points[i].y = (points[i].y - resize_center.y) * scale.y + resize_center.y - offset.y;
+		detachPoints();
+		for (int i = 0; i < points->size(); ++i) {
+			(*points)[i].x = ((*points)[i].x - resize_center.x) * scale.x + resize_center.x - offset.x;
+			(*points)[i].y = ((*points)[i].y - resize_center.y) * scale.y + resize_center.y - offset.y;
 		}
 
 		glm::dvec2 offset2(offset.x * cos(theta) - offset.y * sin(theta), offset.x * sin(theta) + offset.y * cos(theta));
@@ -191,16 +283,79 @@ namespace canvas {
 		double max_x = -std::numeric_limits<double>::max();
 		double min_y = std::numeric_limits<double>::max();
 		double max_y = -std::numeric_limits<double>::max();
-		for (int i = 0; i < points.size(); ++i) {
-			min_x = std::min(min_x, points[i].x);
-			max_x = std::max(max_x, points[i].x);
-			min_y = std::min(min_y, points[i].y);
-			max_y = std::max(max_y, points[i].y);
+		for (int i = 0; i < points->size(); ++i) {
+			min_x = std::min(min_x, (*points)[i].x);
+			max_x = std::max(max_x, (*points)[i].x);
+			min_y = std::min(min_y, (*points)[i].y);
+			max_y = std::max(max_y, (*points)[i].y);
 		}
 
 		return BoundingBox(glm::dvec2(min_x, min_y), glm::dvec2(max_x, max_y));
 	}
 
+	/**
+	 * Return true if the other shape is a polygon of the same outline regardless of its pose.
+	 */
+	bool Polygon::hasSameGeometry(const boost::shared_ptr<Shape>& other) const {
+		if (other->getType() != TYPE_POLYGON || other->getSubType() != subtype) return false;
+
+		boost::shared_ptr<Polygon> polygon = boost::static_pointer_cast<Polygon>(other);
+		return polygon->points == points || *polygon->points == *points;
+	}
+
+	/**
+	 * Share the points with the other polygon if they are the same, so that the corresponding polygons
+	 * of the layers keep a single copy of the outline.
+	 * Return true if the points are shared.
+	 */
+	bool Polygon::shareGeometry(const boost::shared_ptr<Shape>& other) {
+		if (!hasSameGeometry(other)) return false;
+
+		points = boost::static_pointer_cast<Polygon>(other)->points;
+		return true;
+	}
+
+	/**
+	 * Repair the outline if it has duplicate vertices or self-intersections.
+	 * The repaired points are a new copy, so that the polygons of the other layers which share the points are not affected.
+	 * Return the result of PolygonValidator::repair().
+	 */
+	int Polygon::repair() {
+		if (points->size() >= 3 && glutils::PolygonValidator::validate(*points, true).isValid()) return glutils::PolygonValidator::VALID;
+
+		boost::shared_ptr<std::vector<glm::dvec2> > repaired(new std::vector<glm::dvec2>(*points));
+		int result = glutils::PolygonValidator::repair(*repaired);
+		points = repaired;
+		invalidate3DGeometry();
+
+		return result;
+	}
+
+	/**
+	 * Remove the vertices which deviate from the outline by less than the tolerance, but keep the pinned vertices.
+	 * As in repair(), the simplified points are a new copy.
+	 * Return the number of the removed vertices.
+	 */
+	int Polygon::simplify(double tolerance, const std::vector<bool>& pinned) {
+		boost::shared_ptr<std::vector<glm::dvec2> > simplified(new std::vector<glm::dvec2>(*points));
+		int num_removed = glutils::PolygonSimplifier::simplify(*simplified, tolerance, pinned);
+		if (num_removed == 0) return 0;
+
+		points = simplified;
+		invalidate3DGeometry();
+
+		return num_removed;
+	}
+
+	/**
+	 * Make a copy of the points if they are shared with other polygons before modifying them.
+	 */
+	void Polygon::detachPoints() {
+		if (!points.unique()) {
+			points = boost::shared_ptr<std::vector<glm::dvec2> >(new std::vector<glm::dvec2>(*points));
+		}
+	}
+
 	bool Polygon::withinPolygon(const std::vector<glm::dvec2>& points, const glm::dvec2& pt) const {
 		typedef boost::geometry::model::d2::point_xy<double> point_2d;
 
@@ -7,25 +7,42 @@ namespace canvas {
 
 	class Polygon : public Shape {
 	private:
-		std::vector<glm::dvec2> points;
+		boost::shared_ptr<std::vector<glm::dvec2> > points;
 		glm::dvec2 current_point;
 
 	public:
 		Polygon(int subtype);
 		Polygon(int subtype, const glm::dvec2& point);
 		Polygon(int subtype, QDomNode& node);
+		Polygon(int subtype, const glm::dvec2& pos, double theta, const glm::dvec2* points, int num_points);
+		Polygon(int subtype, const glm::dvec2& pos, double theta, const boost::shared_ptr<std::vector<glm::dvec2> >& points);
 		~Polygon();
 
 		boost::shared_ptr<Shape> clone() const;
+		boost::shared_ptr<Shape> cloneOutline() const;
 		void draw(QPainter& painter, const QPointF& origin, double scale) const;
+		void draw(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const;
 		QDomElement toXml(QDomDocument& doc) const;
 		void addPoint(const glm::dvec2& point);
 		std::vector<glm::dvec2> getPoints() const;
+		std::vector<glm::dvec2> getOutline(double scale) const;
+		const std::vector<glm::dvec2>& getLocalPoints() const { return *points; }
+		const boost::shared_ptr<std::vector<glm::dvec2> >& getSharedPoints() const { return points; }
 		void updateByNewPoint(const glm::dvec2& point, bool shiftPressed);
 		bool hit(const glm::dvec2& point) const;
 		void resize(const glm::dvec2& scale, const glm::dvec2& resize_center);
 		BoundingBox boundingBox() const;
+		bool hasSameGeometry(const boost::shared_ptr<Shape>& other) const;
+		bool shareGeometry(const boost::shared_ptr<Shape>& other);
+		int repair();
+		int simplify(double tolerance, const std::vector<bool>& pinned);
 		bool withinPolygon(const std::vector<glm::dvec2>& points, const glm::dvec2& pt) const;
+
+	protected:
+		void drawMarkers(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const;
+
+	private:
+		void detachPoints();
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include "PolygonClipper.h"
+#include "GLUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/geometries/multi_polygon.hpp>
+
+namespace glutils {
+
+	namespace {
+
+		// the polygons are counter-clockwise and closed, so the holes are clockwise
+		typedef boost::geometry::model::d2::point_xy<long long> GridPoint;
+		typedef boost::geometry::model::polygon<GridPoint, false> GridPolygon;
+		typedef boost::geometry::model::multi_polygon<GridPolygon> GridMultiPolygon;
+		typedef boost::geometry::model::d2::point_xy<double> BufferPoint;
+		typedef boost::geometry::model::polygon<BufferPoint, false> BufferPolygon;
+		typedef boost::geometry::model::multi_polygon<BufferPolygon> BufferMultiPolygon;
+
+		/**
+		 * Snap the path to the grid, and remove the points which fall on the same grid point as the previous one.
+		 * The ring is closed. Return false if the ring has less than 3 points.
+		 */
+		template<typename Ring>
+		bool toGridRing(const PolygonClipper::Path& path, double resolution, Ring& ring) {
+			ring.clear();
+			for (int i = 0; i < path.size(); ++i) {
+				GridPoint p((long long)floor(path[i].x / resolution + 0.5), (long long)floor(path[i].y / resolution + 0.5));
+				if (!ring.empty() && boost::geometry::equals(ring.back(), p)) continue;
+				ring.push_back(p);
+			}
+			while (ring.size() > 1 && boost::geometry::equals(ring.front(), ring.back())) ring.pop_back();
+			if (ring.size() < 3) return false;
+
+			ring.push_back(ring.front());
+			return true;
+		}
+
+		/**
+		 * Merge the polygons, which may overlap each other, into a valid multi polygon.
+		 * The overlay requires valid multi polygons, so the polygons are merged by a balanced tree of the unions,
+		 * which touches each vertex only a logarithmic number of times.
+		 */
+		void mergePolygons(const std::vector<GridPolygon>& polygons, GridMultiPolygon& merged) {
+			std::vector<GridMultiPolygon> parts(polygons.size());
+			for (int i = 0; i < polygons.size(); ++i) {
+				parts[i].push_back(polygons[i]);
+			}
+
+			while (parts.size() > 1) {
+				std::vector<GridMultiPolygon> next_parts((parts.size() + 1) / 2);
+				for (int i = 0; i + 1 < parts.size(); i += 2) {
+					boost::geometry::union_(parts[i], parts[i + 1], next_parts[i / 2]);
+				}
+				if (parts.size() % 2 == 1) next_parts.back().swap(parts.back());
+				parts.swap(next_parts);
+			}
+
+			merged.clear();
+			if (!parts.empty()) merged.swap(parts[0]);
+		}
+
+		/**
+		 * Convert the rings to a valid multi polygon on the grid.
+		 * Each clockwise ring becomes a hole of the smallest counter-clockwise ring which contains it.
+		 * A polygon which is not valid after the snapping, e.g., one whose edges cross each other because the snapping
+		 * moved its vertices, is dropped, since the overlay cannot handle it.
+		 * Return false if any polygon is dropped.
+		 */
+		bool toGrid(const PolygonClipper::Paths& paths, double resolution, GridMultiPolygon& polygons) {
+			polygons.clear();
+
+			std::vector<GridPolygon::ring_type> rings;
+			std::vector<double> areas;
+			bool has_outer = false;
+			for (int i = 0; i < paths.size(); ++i) {
+				GridPolygon::ring_type ring;
+				if (!toGridRing(paths[i], resolution, ring)) continue;
+
+				double area = boost::geometry::area(ring);
+				if (area == 0.0) continue;
+				if (area > 0.0) has_outer = true;
+
+				rings.push_back(ring);
+				areas.push_back(area);
+			}
+
+			// a clockwise outline is an outer ring
+			if (!has_outer) {
+				for (int i = 0; i < rings.size(); ++i) {
+					std::reverse(rings[i].begin(), rings[i].end());
+					areas[i] = -areas[i];
+				}
+			}
+
+			std::vector<GridPolygon> outers;
+			std::vector<double> outer_areas;
+			for (int i = 0; i < rings.size(); ++i) {
+				if (areas[i] < 0.0) continue;
+
+				GridPolygon polygon;
+				polygon.outer() = rings[i];
+				outers.push_back(polygon);
+				outer_areas.push_back(areas[i]);
+			}
+
+			for (int i = 0; i < rings.size(); ++i) {
+				if (areas[i] > 0.0) continue;
+
+				int parent = -1;
+				for (int k = 0; k < outers.size(); ++k) {
+					if (outer_areas[k] < -areas[i]) continue;
+					if (parent >= 0 && outer_areas[k] >= outer_areas[parent]) continue;
+					if (!boost::geometry::covered_by(rings[i][0], outers[k].outer())) continue;
+					parent = k;
+				}
+				if (parent >= 0) outers[parent].inners().push_back(rings[i]);
+			}
+
+			bool valid = true;
+			std::vector<GridPolygon> valid_outers;
+			for (int i = 0; i < outers.size(); ++i) {
+				boost::geometry::correct(outers[i]);
+				if (boost::geometry::is_valid(outers[i])) valid_outers.push_back(outers[i]);
+				else valid = false;
+			}
+
+			try {
+				mergePolygons(valid_outers, polygons);
+			}
+			catch (const boost::geometry::exception&) {
+				polygons.clear();
+				return false;
+			}
+
+			return valid;
+		}
+
+		void fromGridRing(const GridPolygon::ring_type& ring, double resolution, PolygonClipper::Path& path) {
+			path.clear();
+			for (int i = 0; i + 1 < ring.size(); ++i) {
+				path.push_back(glm::dvec2(ring[i].x() * resolution, ring[i].y() * resolution));
+			}
+		}
+
+		void fromGrid(const GridMultiPolygon& polygons, double resolution, PolygonClipper::Paths& paths) {
+			paths.clear();
+			for (int i = 0; i < polygons.size(); ++i) {
+				paths.push_back(PolygonClipper::Path());
+				fromGridRing(polygons[i].outer(), resolution, paths.back());
+				for (int k = 0; k < polygons[i].inners().size(); ++k) {
+					paths.push_back(PolygonClipper::Path());
+					fromGridRing(polygons[i].inners()[k], resolution, paths.back());
+				}
+			}
+		}
+
+		/**
+		 * Snap the ring of the buffer back to the grid. Return false if the ring collapses.
+		 */
+		bool snapRing(const BufferPolygon::ring_type& ring, GridPolygon::ring_type& grid_ring) {
+			grid_ring.clear();
+			for (int i = 0; i < ring.size(); ++i) {
+				GridPoint p((long long)floor(ring[i].x() + 0.5), (long long)floor(ring[i].y() + 0.5));
+				if (!grid_ring.empty() && boost::geometry::equals(grid_ring.back(), p)) continue;
+				grid_ring.push_back(p);
+			}
+			return grid_ring.size() >= 4 && boost::geometry::area(grid_ring) != 0.0;
+		}
+
+		/**
+		 * Apply the boolean operation to the valid multi polygons on the grid.
+		 */
+		void overlay(int operation, const GridMultiPolygon& subject_polygons, const GridMultiPolygon& clip_polygons, GridMultiPolygon& result) {
+			if (operation == PolygonClipper::UNION) {
+				if (subject_polygons.empty()) {
+					result = clip_polygons;
+				}
+				else if (clip_polygons.empty()) {
+					result = subject_polygons;
+				}
+				else {
+					boost::geometry::union_(subject_polygons, clip_polygons, result);
+				}
+			}
+			else if (operation == PolygonClipper::INTERSECTION) {
+				if (!subject_polygons.empty() && !clip_polygons.empty()) {
+					boost::geometry::intersection(subject_polygons, clip_polygons, result);
+				}
+			}
+			else if (operation == PolygonClipper::DIFFERENCE) {
+				if (clip_polygons.empty()) {
+					result = subject_polygons;
+				}
+				else if (!subject_polygons.empty()) {
+					boost::geometry::difference(subject_polygons, clip_polygons, result);
+				}
+			}
+			else {
+				throw "Unknown clipping operation";
+			}
+		}
+
+	}
+
+	/**
+	 * Create a clipper which snaps the coordinates to the grid of the resolution.
+	 * The arcs of the round joins of the offset deviate from the true arcs by at most the arc tolerance.
+	 */
+	PolygonClipper::PolygonClipper(double resolution, double arc_tolerance) {
+		this->resolution = resolution;
+		this->arc_tolerance = arc_tolerance;
+	}
+
+	/**
+	 * Compute the union, the intersection, or the difference of the subject and the clip polygons.
+	 * The overlapping rings of the subject (and of the clip) are merged first.
+	 * The polygons which are not valid on the grid are left out. If the overlay fails anyway, the solution is
+	 * the subject on the grid without clipping.
+	 * Return false if any polygon is left out or the overlay fails.
+	 */
+	bool PolygonClipper::execute(int operation, const Paths& subject, const Paths& clip, Paths& solution) const {
+		GridMultiPolygon subject_polygons;
+		GridMultiPolygon clip_polygons;
+		bool valid = toGrid(subject, resolution, subject_polygons);
+		valid = toGrid(clip, resolution, clip_polygons) && valid;
+
+		GridMultiPolygon result;
+		try {
+			overlay(operation, subject_polygons, clip_polygons, result);
+		}
+		catch (const boost::geometry::exception&) {
+			fromGrid(subject_polygons, resolution, solution);
+			return false;
+		}
+
+		fromGrid(result, resolution, solution);
+		return valid;
+	}
+
+	/**
+	 * Offset the polygons by the distance with round joins. The polygons shrink if the distance is negative.
+	 * The polygons which are not valid on the grid are left out. If the buffer fails anyway, the solution is
+	 * the polygons on the grid without the offset.
+	 * Return false if any polygon is left out or the buffer fails.
+	 */
+	bool PolygonClipper::offset(const Paths& paths, double delta, Paths& solution) const {
+		GridMultiPolygon polygons;
+		bool valid = toGrid(paths, resolution, polygons);
+
+		if (fabs(delta) < resolution || polygons.empty()) {
+			fromGrid(polygons, resolution, solution);
+			return valid;
+		}
+
+		// the buffer is computed in the grid units
+		BufferMultiPolygon input;
+		boost::geometry::convert(polygons, input);
+
+		int points_per_circle = circleSegments(fabs(delta), arc_tolerance);
+		boost::geometry::strategy::buffer::distance_symmetric<double> distance_strategy(delta / resolution);
+		boost::geometry::strategy::buffer::join_round join_strategy(points_per_circle);
+		boost::geometry::strategy::buffer::end_round end_strategy(points_per_circle);
+		boost::geometry::strategy::buffer::point_circle point_strategy(points_per_circle);
+		boost::geometry::strategy::buffer::side_straight side_strategy;
+
+		BufferMultiPolygon buffered;
+		try {
+			boost::geometry::buffer(input, buffered, distance_strategy, side_strategy, join_strategy, end_strategy, point_strategy);
+		}
+		catch (const boost::geometry::exception&) {
+			fromGrid(polygons, resolution, solution);
+			return false;
+		}
+
+		GridMultiPolygon result;
+		for (int i = 0; i < buffered.size(); ++i) {
+			GridPolygon polygon;
+			if (!snapRing(buffered[i].outer(), polygon.outer())) continue;
+			for (int k = 0; k < buffered[i].inners().size(); ++k) {
+				GridPolygon::ring_type hole;
+				if (snapRing(buffered[i].inners()[k], hole)) polygon.inners().push_back(hole);
+			}
+			result.push_back(polygon);
+		}
+
+		fromGrid(result, resolution, solution);
+		return valid;
+	}
+
+	/**
+	 * Return the area of the polygons, where the holes count negative.
+	 */
+	double PolygonClipper::area(const Paths& paths) {
+		double total = 0.0;
+		for (int i = 0; i < paths.size(); ++i) {
+			for (int k = 0; k < paths[i].size(); ++k) {
+				const glm::dvec2& p = paths[i][k];
+				const glm::dvec2& q = paths[i][(k + 1) % paths[i].size()];
+				total += p.x * q.y - q.x * p.y;
+			}
+		}
+		return total * 0.5;
+	}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace glutils {
+
+	/**
+	 * Boolean operations and offsetting of polygons on an integer grid.
+	 *
+	 * The coordinates are snapped to the grid of the given resolution, so that the orientation tests of the overlay
+	 * are exact and the results do not depend on the rounding of the floating point coordinates. The polygons are
+	 * represented by their rings: the outer rings are counter-clockwise and the holes are clockwise, as in the results.
+	 * The orientation of the rings of the input is corrected if all of them are clockwise, e.g., a single clockwise outline.
+	 * The snapped polygons which are not valid (e.g., collapsed to a line or self-intersecting) are dropped. If an
+	 * operation still fails, execute() returns the snapped subject, offset() returns the snapped input, and both return false.
+	 */
+	class PolygonClipper {
+	public:
+		static enum { UNION = 0, INTERSECTION, DIFFERENCE };
+
+		typedef std::vector<glm::dvec2> Path;
+		typedef std::vector<Path> Paths;
+
+	private:
+		double resolution;
+		double arc_tolerance;
+
+	public:
+		PolygonClipper(double resolution = 1.0 / 1024.0, double arc_tolerance = 0.25);
+
+		double getResolution() const { return resolution; }
+		bool execute(int operation, const Paths& subject, const Paths& clip, Paths& solution) const;
+		bool offset(const Paths& paths, double delta, Paths& solution) const;
+		static double area(const Paths& paths);
+	};
+
+}
@@ -0,0 +1,114 @@
+#include "PolygonSimplifier.h"
+#include "PolygonValidator.h"
+#include <algorithm>
+#include <utility>
+
+namespace glutils {
+
+	/**
+	 * Simplify the outline in place.
+	 * Return the number of the removed vertices.
+	 */
+	int PolygonSimplifier::simplify(std::vector<glm::dvec2>& points, double tolerance, const std::vector<bool>& pinned) {
+		int n = points.size();
+		if (n <= 3 || tolerance <= 0.0) return 0;
+
+		std::vector<bool> keep(n, false);
+		std::vector<int> anchors;
+		for (int i = 0; i < n; ++i) {
+			if (i < pinned.size() && pinned[i]) {
+				keep[i] = true;
+				anchors.push_back(i);
+			}
+		}
+
+		// a closed outline needs two anchors to be split into open chains
+		if (anchors.empty()) {
+			keep[0] = true;
+			anchors.push_back(0);
+		}
+		if (anchors.size() == 1) {
+			int farthest = anchors[0];
+			double max_dist = 0.0;
+			for (int i = 0; i < n; ++i) {
+				double dist = glm::length(points[i] - points[anchors[0]]);
+				if (dist > max_dist) {
+					max_dist = dist;
+					farthest = i;
+				}
+			}
+			if (farthest == anchors[0]) return 0;
+
+			keep[farthest] = true;
+			anchors.push_back(farthest);
+			std::sort(anchors.begin(), anchors.end());
+		}
+
+		for (int i = 0; i < anchors.size(); ++i) {
+			simplifyChain(points, anchors[i], anchors[(i + 1) % anchors.size()], tolerance, keep);
+		}
+
+		std::vector<glm::dvec2> simplified;
+		for (int i = 0; i < n; ++i) {
+			if (keep[i]) simplified.push_back(points[i]);
+		}
+		if (simplified.size() < 3 || simplified.size() == n) return 0;
+
+		// removing the vertices must not make the outline self-intersecting
+		if (!PolygonValidator::validate(simplified, true).isValid()) return 0;
+
+		points.swap(simplified);
+		return n - points.size();
+	}
+
+	/**
+	 * Mark the vertices of the chain from the first vertex to the last vertex which have to be kept.
+	 * The chain wraps around the end of the outline if the last index is not greater than the first one.
+	 */
+	void PolygonSimplifier::simplifyChain(const std::vector<glm::dvec2>& points, int first, int last, double tolerance, std::vector<bool>& keep) {
+		int n = points.size();
+		int length = (last - first + n) % n;
+		if (length == 0) length = n;
+
+		// ranges of the chain, which are represented by the offsets from the first vertex
+		std::vector<std::pair<int, int> > stack;
+		stack.push_back(std::make_pair(0, length));
+		while (!stack.empty()) {
+			int start = stack.back().first;
+			int end = stack.back().second;
+			stack.pop_back();
+			if (end - start < 2) continue;
+
+			const glm::dvec2& a = points[(first + start) % n];
+			const glm::dvec2& b = points[(first + end) % n];
+			int farthest = -1;
+			double max_dist = tolerance;
+			for (int i = start + 1; i < end; ++i) {
+				double dist = distance(a, b, points[(first + i) % n]);
+				if (dist > max_dist) {
+					max_dist = dist;
+					farthest = i;
+				}
+			}
+
+			if (farthest >= 0) {
+				keep[(first + farthest) % n] = true;
+				stack.push_back(std::make_pair(start, farthest));
+				stack.push_back(std::make_pair(farthest, end));
+			}
+		}
+	}
+
+	/**
+	 * Return the distance between the point p and the segment ab.
+	 */
+	double PolygonSimplifier::distance(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& p) {
+		glm::dvec2 ab = b - a;
+		double len2 = glm::dot(ab, ab);
+		if (len2 == 0.0) return glm::length(p - a);
+
+		double t = std::max(0.0, std::min(1.0, glm::dot(p - a, ab) / len2));
+		return glm::length(p - (a + ab * t));
+	}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace glutils {
+
+	/**
+	 * Remove the vertices of a closed outline which deviate from it by less than the tolerance.
+	 *
+	 * The outline is split at the pinned vertices into open chains, and each chain is simplified by Douglas-Peucker,
+	 * so that the pinned vertices are always kept. If no vertex is pinned, the outline is split at the first vertex
+	 * and the vertex farthest from it. The simplification is discarded if it makes the outline self-intersecting.
+	 */
+	class PolygonSimplifier {
+	public:
+		static int simplify(std::vector<glm::dvec2>& points, double tolerance, const std::vector<bool>& pinned);
+
+	private:
+		static void simplifyChain(const std::vector<glm::dvec2>& points, int first, int last, double tolerance, std::vector<bool>& keep);
+		static double distance(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& p);
+	};
+
+}
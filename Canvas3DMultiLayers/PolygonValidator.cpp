@@ -0,0 +1,420 @@
+#include "PolygonValidator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <set>
+
+namespace glutils {
+
+	namespace {
+
+		/**
+		 * Edge of the polygon whose end points are sorted from left to right.
+		 */
+		struct Segment {
+			glm::dvec2 a;
+			glm::dvec2 b;
+			int edge;
+		};
+
+		enum { EVENT_RIGHT = 0, EVENT_CROSS, EVENT_LEFT };
+
+		/**
+		 * Event of the sweep. The events at the same point are processed in the order of removing the segments
+		 * which end there, swapping the segments which cross there, and then inserting the segments which start there.
+		 */
+		struct Event {
+			glm::dvec2 p;
+			int type;
+			int s1;
+			int s2;
+
+			Event(const glm::dvec2& p, int type, int s1, int s2 = -1) : p(p), type(type), s1(s1), s2(s2) {}
+		};
+
+		bool lessXY(const glm::dvec2& p, const glm::dvec2& q) {
+			return p.x < q.x || (p.x == q.x && p.y < q.y);
+		}
+
+		struct EventGreater {
+			bool operator()(const Event& e1, const Event& e2) const {
+				if (e1.p != e2.p) return lessXY(e2.p, e1.p);
+				if (e1.type != e2.type) return e1.type > e2.type;
+				if (e1.s1 != e2.s1) return e1.s1 > e2.s1;
+				return e1.s2 > e2.s2;
+			}
+		};
+
+		int orientation(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c) {
+			double d = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			return (0.0 < d) - (d < 0.0);
+		}
+
+		bool onSegment(const glm::dvec2& a, const glm::dvec2& p, const glm::dvec2& b) {
+			return p.x <= (std::max)(a.x, b.x) && p.x >= (std::min)(a.x, b.x) && p.y <= (std::max)(a.y, b.y) && p.y >= (std::min)(a.y, b.y);
+		}
+
+		/**
+		 * Check whether the segments intersect or touch each other.
+		 * If they cross at a single interior point, the point is returned by crossing and proper is set to true.
+		 */
+		bool intersects(const Segment& s1, const Segment& s2, glm::dvec2& crossing, bool& proper) {
+			int o1 = orientation(s1.a, s1.b, s2.a);
+			int o2 = orientation(s1.a, s1.b, s2.b);
+			int o3 = orientation(s2.a, s2.b, s1.a);
+			int o4 = orientation(s2.a, s2.b, s1.b);
+
+			proper = false;
+			if (o1 * o2 < 0 && o3 * o4 < 0) {
+				glm::dvec2 d1 = s1.b - s1.a;
+				glm::dvec2 d2 = s2.b - s2.a;
+				double t = ((s2.a.x - s1.a.x) * d2.y - (s2.a.y - s1.a.y) * d2.x) / (d1.x * d2.y - d1.y * d2.x);
+				crossing = s1.a + d1 * t;
+				proper = true;
+				return true;
+			}
+
+			if (o1 == 0 && onSegment(s1.a, s2.a, s1.b)) return true;
+			if (o2 == 0 && onSegment(s1.a, s2.b, s1.b)) return true;
+			if (o3 == 0 && onSegment(s2.a, s1.a, s2.b)) return true;
+			if (o4 == 0 && onSegment(s2.a, s1.b, s2.b)) return true;
+
+			return false;
+		}
+
+		/**
+		 * Sweep line which moves from left to right. The active segments are ordered by their y coordinates
+		 * at the current event point, and the ties are broken by their slopes, i.e., by the order just after the point.
+		 */
+		class Sweep {
+		public:
+			const std::vector<Segment>& segments;
+			glm::dvec2 point;
+			double eps;
+
+		public:
+			Sweep(const std::vector<Segment>& segments, double eps) : segments(segments), eps(eps) {}
+
+			double yAt(int s) const {
+				const Segment& seg = segments[s];
+				if (seg.a.x == seg.b.x) return (std::min)((std::max)(point.y, seg.a.y), seg.b.y);
+				return seg.a.y + (point.x - seg.a.x) * (seg.b.y - seg.a.y) / (seg.b.x - seg.a.x);
+			}
+
+			double slope(int s) const {
+				const Segment& seg = segments[s];
+				if (seg.a.x == seg.b.x) return (std::numeric_limits<double>::max)();
+				return (seg.b.y - seg.a.y) / (seg.b.x - seg.a.x);
+			}
+
+			bool less(int s1, int s2) const {
+				if (s1 == s2) return false;
+
+				double y1 = yAt(s1);
+				double y2 = yAt(s2);
+				if (std::abs(y1 - y2) > eps) return y1 < y2;
+
+				double m1 = slope(s1);
+				double m2 = slope(s2);
+				if (m1 != m2) return m1 < m2;
+
+				return s1 < s2;
+			}
+		};
+
+		struct StatusLess {
+			const Sweep* sweep;
+
+			StatusLess(const Sweep* sweep) : sweep(sweep) {}
+			bool operator()(int s1, int s2) const { return sweep->less(s1, s2); }
+		};
+
+	}
+
+	/**
+	 * Find the duplicate vertices and the intersecting edges of the polygon.
+	 * If stop_at_first is true, the search stops when the first problem is found, which is enough to know whether the polygon is valid.
+	 */
+	PolygonValidator::Result PolygonValidator::validate(const std::vector<glm::dvec2>& points, bool stop_at_first) {
+		Result result;
+		if (points.size() < 3) return result;
+
+		findDuplicateVertices(points, stop_at_first, result);
+		if (stop_at_first && !result.isValid()) return result;
+
+		findSpikes(points, stop_at_first, result);
+		if (stop_at_first && !result.isValid()) return result;
+
+		findIntersections(points, stop_at_first, result);
+
+		return result;
+	}
+
+	/**
+	 * Repair the polygon if it is not simple.
+	 * The duplicate vertices and the spikes (the vertices where the outline turns back on itself) are removed, and
+	 * the crossing edges are untangled by reversing the chain of the vertices between them. Since the reversal
+	 * always shortens the outline, it does not loop forever. If the polygon is still invalid after 10n reversals, it is
+	 * replaced by its convex hull, so that the result is always simple unless it has less than three vertices.
+	 * Return VALID if the polygon has not been changed, REPAIRED, CONVEX_HULL, or DEGENERATE if the polygon has
+	 * less than three distinct vertices which are not collinear.
+	 */
+	int PolygonValidator::repair(std::vector<glm::dvec2>& points) {
+		if (points.size() >= 3 && validate(points, true).isValid()) return VALID;
+
+		removeDuplicateVertices(points);
+		removeSpikes(points);
+		if (points.size() < 3) return DEGENERATE;
+
+		int max_iterations = points.size() * 10;
+		for (int iter = 0; iter < max_iterations; ++iter) {
+			Result result = validate(points, true);
+			if (result.isValid()) return REPAIRED;
+
+			if (!result.intersections.empty()) {
+				// reconnect the edges (i, i+1) and (j, j+1) to (i, j) and (i+1, j+1)
+				int i = (std::min)(result.intersections[0].first, result.intersections[0].second);
+				int j = (std::max)(result.intersections[0].first, result.intersections[0].second);
+				std::reverse(points.begin() + i + 1, points.begin() + j + 1);
+			}
+
+			removeSpikes(points);
+			if (points.size() < 3) return DEGENERATE;
+		}
+
+		convexHull(points);
+		return points.size() >= 3 ? CONVEX_HULL : DEGENERATE;
+	}
+
+	/**
+	 * Find the points at the same position by sorting them.
+	 */
+	void PolygonValidator::findDuplicateVertices(const std::vector<glm::dvec2>& points, bool stop_at_first, Result& result) {
+		std::vector<int> order(points.size());
+		for (int i = 0; i < points.size(); ++i) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&points](int i, int j) {
+			return lessXY(points[i], points[j]) || (points[i] == points[j] && i < j);
+		});
+
+		for (int i = 1; i < order.size(); ++i) {
+			if (points[order[i - 1]] == points[order[i]]) {
+				result.duplicate_vertices.push_back(std::make_pair(order[i - 1], order[i]));
+				if (stop_at_first) return;
+			}
+		}
+	}
+
+	/**
+	 * Find the vertices where the outline turns back on itself, which makes the two edges of the vertex overlap.
+	 * The sweep does not test the adjacent edges, so they are found here.
+	 */
+	void PolygonValidator::findSpikes(const std::vector<glm::dvec2>& points, bool stop_at_first, Result& result) {
+		int n = points.size();
+		for (int i = 0; i < n; ++i) {
+			const glm::dvec2& prev = points[(i + n - 1) % n];
+			const glm::dvec2& next = points[(i + 1) % n];
+			if (orientation(prev, points[i], next) == 0 && glm::dot(points[i] - prev, next - points[i]) < 0) {
+				result.intersections.push_back(std::make_pair((i + n - 1) % n, i));
+				if (stop_at_first) return;
+			}
+		}
+	}
+
+	/**
+	 * Find the pairs of the non-adjacent edges which intersect or touch each other by the Bentley-Ottmann sweep.
+	 * Two segments are tested whenever they become neighbors on the sweep line, and a crossing which is found
+	 * ahead of the sweep line is queued as an event to swap them.
+	 */
+	void PolygonValidator::findIntersections(const std::vector<glm::dvec2>& points, bool stop_at_first, Result& result) {
+		int n = points.size();
+
+		glm::dvec2 minPt = points[0];
+		glm::dvec2 maxPt = points[0];
+		for (int i = 1; i < n; ++i) {
+			minPt = glm::min(minPt, points[i]);
+			maxPt = glm::max(maxPt, points[i]);
+		}
+		double extent = (std::max)(maxPt.x - minPt.x, maxPt.y - minPt.y);
+
+		// the edges of zero length are skipped since they are reported as the duplicate vertices
+		std::vector<Segment> segments;
+		segments.reserve(n);
+		for (int i = 0; i < n; ++i) {
+			const glm::dvec2& p = points[i];
+			const glm::dvec2& q = points[(i + 1) % n];
+			if (p == q) continue;
+
+			Segment seg;
+			seg.a = lessXY(p, q) ? p : q;
+			seg.b = lessXY(p, q) ? q : p;
+			seg.edge = i;
+			segments.push_back(seg);
+		}
+
+		std::priority_queue<Event, std::vector<Event>, EventGreater> events;
+		for (int i = 0; i < segments.size(); ++i) {
+			events.push(Event(segments[i].a, EVENT_LEFT, i));
+			events.push(Event(segments[i].b, EVENT_RIGHT, i));
+		}
+
+		Sweep sweep(segments, extent * 1e-12);
+		typedef std::set<int, StatusLess> Status;
+		Status status = Status(StatusLess(&sweep));
+		std::vector<Status::iterator> positions(segments.size(), status.end());
+		std::set<std::pair<int, int> > reported;
+
+		// test the pair of the neighbors, and report and queue their intersection
+		auto check = [&](int s1, int s2) {
+			int e1 = segments[s1].edge;
+			int e2 = segments[s2].edge;
+			if ((e1 + 1) % n == e2 || (e2 + 1) % n == e1) return;
+
+			std::pair<int, int> pair((std::min)(e1, e2), (std::max)(e1, e2));
+			if (reported.find(pair) != reported.end()) return;
+
+			glm::dvec2 crossing;
+			bool proper;
+			if (!intersects(segments[s1], segments[s2], crossing, proper)) return;
+
+			reported.insert(pair);
+			result.intersections.push_back(pair);
+			if (proper && lessXY(sweep.point, crossing)) {
+				events.push(Event(crossing, EVENT_CROSS, s1, s2));
+			}
+		};
+
+		while (!events.empty()) {
+			if (stop_at_first && !result.intersections.empty()) return;
+
+			Event event = events.top();
+			events.pop();
+			sweep.point = event.p;
+
+			if (event.type == EVENT_LEFT) {
+				Status::iterator it = status.insert(event.s1).first;
+				positions[event.s1] = it;
+
+				if (it != status.begin()) {
+					Status::iterator below = it;
+					--below;
+					check(*below, event.s1);
+				}
+				Status::iterator above = it;
+				++above;
+				if (above != status.end()) {
+					check(event.s1, *above);
+				}
+			}
+			else if (event.type == EVENT_RIGHT) {
+				Status::iterator it = positions[event.s1];
+				if (it == status.end()) continue;
+
+				Status::iterator above = it;
+				++above;
+				if (it != status.begin() && above != status.end()) {
+					Status::iterator below = it;
+					--below;
+					check(*below, *above);
+				}
+
+				status.erase(it);
+				positions[event.s1] = status.end();
+			}
+			else {
+				// swap the crossing segments by inserting them again in the order just after the crossing
+				if (positions[event.s1] == status.end() || positions[event.s2] == status.end()) continue;
+				status.erase(positions[event.s1]);
+				status.erase(positions[event.s2]);
+				positions[event.s1] = status.insert(event.s1).first;
+				positions[event.s2] = status.insert(event.s2).first;
+
+				bool swapped = sweep.less(event.s1, event.s2);
+				Status::iterator lower = swapped ? positions[event.s1] : positions[event.s2];
+				Status::iterator upper = swapped ? positions[event.s2] : positions[event.s1];
+				if (lower != status.begin()) {
+					Status::iterator below = lower;
+					--below;
+					check(*below, *lower);
+				}
+				Status::iterator above = upper;
+				++above;
+				if (above != status.end()) {
+					check(*upper, *above);
+				}
+			}
+		}
+	}
+
+	/**
+	 * Remove the points at the same position as an earlier point.
+	 */
+	void PolygonValidator::removeDuplicateVertices(std::vector<glm::dvec2>& points) {
+		Result result;
+		findDuplicateVertices(points, false, result);
+		if (result.duplicate_vertices.empty()) return;
+
+		std::vector<bool> removed(points.size(), false);
+		for (int i = 0; i < result.duplicate_vertices.size(); ++i) {
+			removed[(std::max)(result.duplicate_vertices[i].first, result.duplicate_vertices[i].second)] = true;
+		}
+
+		int count = 0;
+		for (int i = 0; i < points.size(); ++i) {
+			if (!removed[i]) {
+				points[count++] = points[i];
+			}
+		}
+		points.resize(count);
+	}
+
+	/**
+	 * Remove the vertices where the outline turns back on itself until there is none.
+	 */
+	void PolygonValidator::removeSpikes(std::vector<glm::dvec2>& points) {
+		bool removed = true;
+		while (removed && points.size() >= 3) {
+			removed = false;
+			int n = points.size();
+			for (int i = 0; i < n; ++i) {
+				const glm::dvec2& prev = points[(i + n - 1) % n];
+				const glm::dvec2& next = points[(i + 1) % n];
+				if (orientation(prev, points[i], next) == 0 && glm::dot(points[i] - prev, next - points[i]) <= 0) {
+					points.erase(points.begin() + i);
+					removed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	/**
+	 * Replace the points with their convex hull in counter clockwise order by Andrew's monotone chain.
+	 */
+	void PolygonValidator::convexHull(std::vector<glm::dvec2>& points) {
+		std::sort(points.begin(), points.end(), lessXY);
+		points.erase(std::unique(points.begin(), points.end()), points.end());
+		if (points.size() < 3) return;
+
+		std::vector<glm::dvec2> hull(points.size() * 2);
+		int k = 0;
+
+		// lower hull
+		for (int i = 0; i < points.size(); ++i) {
+			while (k >= 2 && orientation(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+			hull[k++] = points[i];
+		}
+
+		// upper hull
+		for (int i = points.size() - 2, t = k + 1; i >= 0; --i) {
+			while (k >= t && orientation(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+			hull[k++] = points[i];
+		}
+
+		hull.resize(k - 1);
+		points = hull;
+	}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <glm/glm.hpp>
+
+namespace glutils {
+
+	/**
+	 * Check whether a polygon is simple, and repair it if it is not.
+	 *
+	 * The self-intersections are found by a Bentley-Ottmann sweep over the edges in O((n + k) log n), where k is
+	 * the number of the intersections, and the duplicate vertices by sorting them. The edge i connects the point i
+	 * and the point i + 1 (the last edge connects the last point and the first point).
+	 *
+	 * The polygons are validated before they are triangulated, since a self-intersecting outline makes the
+	 * triangulation invalid or very slow.
+	 */
+	class PolygonValidator {
+	public:
+		static enum { VALID = 0, REPAIRED, CONVEX_HULL, DEGENERATE };
+
+		struct Result {
+			// pairs of the indices of the points at the same position
+			std::vector<std::pair<int, int> > duplicate_vertices;
+			// pairs of the indices of the edges which intersect or touch each other
+			std::vector<std::pair<int, int> > intersections;
+
+			bool isValid() const { return duplicate_vertices.empty() && intersections.empty(); }
+		};
+
+	public:
+		static Result validate(const std::vector<glm::dvec2>& points, bool stop_at_first = false);
+		static int repair(std::vector<glm::dvec2>& points);
+
+	private:
+		static void findDuplicateVertices(const std::vector<glm::dvec2>& points, bool stop_at_first, Result& result);
+		static void findSpikes(const std::vector<glm::dvec2>& points, bool stop_at_first, Result& result);
+		static void findIntersections(const std::vector<glm::dvec2>& points, bool stop_at_first, Result& result);
+		static void removeDuplicateVertices(std::vector<glm::dvec2>& points);
+		static void removeSpikes(std::vector<glm::dvec2>& points);
+		static void convexHull(std::vector<glm::dvec2>& points);
+	};
+
+}
@@ -1,4 +1,5 @@
 #include "Rectangle.h"
+#include "Trace.h"
 
 namespace canvas {
 
@@ -40,6 +41,19 @@ namespace canvas {
 		update3DGeometry();
 	}
 
+	/**
+	 * Construct a rectangle from the parameters read from a file.
+	 * The 3D geometry is not generated until it is used.
+	 */
+	Rectangle::Rectangle(int subtype, const glm::dvec2& pos, double theta, double width, double height) : Shape(subtype) {
+		type = TYPE_RECTANGLE;
+		this->pos = pos;
+		this->theta = theta;
+		this->width = width;
+		this->height = height;
+		geometry_outdated = true;
+	}
+
 	Rectangle::~Rectangle() {
 	}
 
@@ -48,6 +62,15 @@ namespace canvas {
 		return boost::shared_ptr<Shape>(new_rec);
 	}
 
+	/**
+	 * Return a copy of the rectangle without the 3D geometry, e.g., for writing the design to a file.
+	 */
+	boost::shared_ptr<Shape> Rectangle::cloneOutline() const {
+		Rectangle* new_rec = new Rectangle(subtype, pos, theta, width, height);
+		new_rec->copyIdentity(*this);
+		return boost::shared_ptr<Shape>(new_rec);
+	}
+
 	void Rectangle::draw(QPainter& painter, const QPointF& origin, double scale) const {
 		painter.save();
 
@@ -55,10 +78,10 @@ namespace canvas {
 		painter.rotate(-theta / 3.14159265 * 180);
 
 		if (selected || currently_drawing) {
-			painter.setPen(QPen(QColor(0, 0, 255), 2));
+			painter.setPen(pens[1]);
 		}
 		else {
-			painter.setPen(QPen(QColor(0, 0, 0), 1));
+			painter.setPen(pens[0]);
 		}
 		if (currently_drawing) {
 			painter.setBrush(QBrush(QColor(0, 0, 0, 0)));
@@ -77,7 +100,7 @@ namespace canvas {
 
 		if (selected) {
 			// show resize marker
-			painter.setPen(QPen(QColor(0, 0, 0), 1));
+			painter.setPen(pens[0]);
 			painter.setBrush(QBrush(QColor(255, 255, 255)));
 			painter.drawRect(-3, -3, 6, 6);
 			painter.drawRect(width * scale - 3, -3, 6, 6);
@@ -136,6 +159,7 @@ namespace canvas {
 			if (height * width >= 0) height = width;
 			else height = -width;
 		}
+		updateGeometryVersion();
 	}
 
 	/**
@@ -153,11 +177,22 @@ namespace canvas {
 		else return true;
 	}
 	
+	/**
+	 * Return true if the other shape is a rectangle of the same size regardless of its pose.
+	 */
+	bool Rectangle::hasSameGeometry(const boost::shared_ptr<Shape>& other) const {
+		if (other->getType() != type || other->getSubType() != subtype) return false;
+
+		boost::shared_ptr<Rectangle> rectangle = boost::static_pointer_cast<Rectangle>(other);
+		return rectangle->width == width && rectangle->height == height;
+	}
+
 	/**
 	 * Resize the rectangle by the specified scale.
 	 * The resizing scale and the center of the resizing are specified as local coordinates.
 	 */
 	void Rectangle::resize(const glm::dvec2& scale, const glm::dvec2& resize_center) {
+		TRACE_SCOPE("Rectangle::resize");
 		glm::dvec2 dir(resize_center.x * (1.0 - scale.x), resize_center.y * (1.0 - scale.y));
 		
 		pos.x += dir.x * cos(theta) - dir.y * sin(theta);
@@ -13,15 +13,20 @@ namespace canvas {
 		Rectangle(int subtype);
 		Rectangle(int subtype, const glm::dvec2& point);
 		Rectangle(int subtype, QDomNode& node);
+		Rectangle(int subtype, const glm::dvec2& pos, double theta, double width, double height);
 		~Rectangle();
 
 		boost::shared_ptr<Shape> clone() const;
+		boost::shared_ptr<Shape> cloneOutline() const;
 		void draw(QPainter& painter, const QPointF& origin, double scale) const;
 		QDomElement toXml(QDomDocument& doc) const;
 		void addPoint(const glm::dvec2& point);
 		std::vector<glm::dvec2> getPoints() const;
+		double getWidth() const { return width; }
+		double getHeight() const { return height; }
 		void updateByNewPoint(const glm::dvec2& point, bool shiftPressed);
 		bool hit(const glm::dvec2& point) const;
+		bool hasSameGeometry(const boost::shared_ptr<Shape>& other) const;
 		void resize(const glm::dvec2& scale, const glm::dvec2& resize_center);
 		BoundingBox boundingBox() const;
 	};
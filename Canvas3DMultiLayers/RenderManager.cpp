@@ -4,10 +4,15 @@
 #include <QImage>
 #include <QGLWidget>
 #include <sstream>
+#include "Trace.h"
 
 GeometryObject::GeometryObject() {
 	vaoCreated = false;
 	vaoOutdated = true;
+	stream = NULL;
+	streamFrame = 0;
+	ghostVBO = 0;
+	ghostsOutdated = false;
 }
 
 GeometryObject::GeometryObject(const std::vector<Vertex>& vertices, bool lighting) {
@@ -15,6 +20,28 @@ GeometryObject::GeometryObject(const std::vector<Vertex>& vertices, bool lightin
 	this->lighting = lighting;
 	vaoCreated = false;
 	vaoOutdated = true;
+	stream = NULL;
+	streamFrame = 0;
+	ghostVBO = 0;
+	ghostsOutdated = false;
+}
+
+/**
+ * Create an object which is extruded from the cap triangles and the outline by the geometry shader.
+ * Only the 2D data is uploaded, and the bottom, the top, and the color are given to the shader as uniforms.
+ */
+GeometryObject::GeometryObject(const std::vector<glm::vec3>& extrusion, float bottom, float top, const glm::vec4& color) {
+	this->extrusion = extrusion;
+	this->lighting = true;
+	extrusionBottom = bottom;
+	extrusionTop = top;
+	extrusionColor = color;
+	vaoCreated = false;
+	vaoOutdated = true;
+	stream = NULL;
+	streamFrame = 0;
+	ghostVBO = 0;
+	ghostsOutdated = false;
 }
 
 void GeometryObject::addVertices(const std::vector<Vertex>& vertices) {
@@ -24,10 +51,15 @@ void GeometryObject::addVertices(const std::vector<Vertex>& vertices) {
 
 /**
  * Create VAO according to the vertices.
+ * While the object is streamed, the vertices are copied to the ring buffer instead of reallocating the VBO,
+ * and they are copied again in every frame since the region of the ring buffer is reused a few frames later.
  */
 void GeometryObject::createVAO() {
+	TRACE_SCOPE("GeometryObject::createVAO");
+
 	// VAOが作成済みで、最新なら、何もしないで終了
-	if (vaoCreated && !vaoOutdated) return;
+	bool restream = stream != NULL && streamFrame != stream->currentFrame();
+	if (vaoCreated && !vaoOutdated && !restream) return;
 
 	if (!vaoCreated) {
 		// create vao and bind it
@@ -44,25 +76,88 @@ void GeometryObject::createVAO() {
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	}
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	const void* data = vertices.data();
+	GLsizeiptr size = sizeof(Vertex) * vertices.size();
+	if (isExtruded()) {
+		data = extrusion.data();
+		size = sizeof(glm::vec3) * extrusion.size();
+	}
+
+	GLintptr offset;
+	if (stream != NULL && stream->write(data, size, offset)) {
+		// point the attributes to the copy in the ring buffer
+		glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+		setAttributes(offset);
+		streamFrame = stream->currentFrame();
+	}
+	else {
+		// the ring buffer is full, or the object is not streamed
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+		setAttributes(0);
+		stream = NULL;
+	}
+		
+	// unbind the vao
+	glBindVertexArray(0); 
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	vaoOutdated = false;
+}
+
+/**
+ * Configure the attributes in the vao for the vertices at the offset of the buffer bound to GL_ARRAY_BUFFER.
+ */
+void GeometryObject::setAttributes(GLintptr offset) {
+	if (isExtruded()) {
+		// only the 2D position and the kind of the primitive
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)(offset));
+		for (int i = 1; i <= 4; ++i) {
+			glDisableVertexAttribArray(i);
+		}
+		return;
+	}
 
-	// configure the attributes in the vao
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset));
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, normal)));
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, color)));
 	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, texCoord)));
 	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, drawEdge));
-		
-	// unbind the vao
-	glBindVertexArray(0); 
+	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, drawEdge)));
+}
+
+/**
+ * Upload the per-instance attributes of the ghosts, and attach them to the VAO.
+ * The VAO has to be created before calling this function.
+ */
+void GeometryObject::updateGhostVBO() {
+	if (!ghostsOutdated) return;
+
+	glBindVertexArray(vao);
+	if (ghostVBO == 0) {
+		glGenBuffers(1, &ghostVBO);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, ghostVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GhostInstance) * ghosts.size(), ghosts.data(), GL_DYNAMIC_DRAW);
+
+	// the model matrix occupies four attribute locations, one for each column
+	for (int i = 0; i < 4; ++i) {
+		glEnableVertexAttribArray(5 + i);
+		glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(GhostInstance), (void*)(offsetof(GhostInstance, modelMatrix) + sizeof(glm::vec4) * i));
+		glVertexAttribDivisor(5 + i, 1);
+	}
+	glEnableVertexAttribArray(9);
+	glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(GhostInstance), (void*)offsetof(GhostInstance, color));
+	glVertexAttribDivisor(9, 1);
+
+	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	vaoOutdated = false;
+	ghostsOutdated = false;
 }
 
 RenderManager::RenderManager() {
@@ -70,6 +165,11 @@ RenderManager::RenderManager() {
 	uKernelSize = 64;// 16;
 	uRadius = 1;// 17.0f;
 	uPower = 2.0f;
+
+	width = 0;
+	height = 0;
+	defaultFramebuffer = 0;
+	showGhosts = false;
 }
 
 RenderManager::~RenderManager() {
@@ -115,8 +215,25 @@ void RenderManager::init(const std::string& vertex_file, const std::string& geom
 	// Shadow mapping
 	programs["shadow"] = shader.createProgram("../shaders/lc_vert_shadow.glsl", "../shaders/lc_frag_shadow.glsl");
 
+	// Grid of the 2D editor
+	programs["grid"] = shader.createProgram("../shaders/lc_vert_grid.glsl", "../shaders/lc_frag_grid.glsl");
+
+	// 2D editing overlay
+	programs["overlay"] = shader.createProgram("../shaders/lc_vert_overlay.glsl", "../shaders/lc_frag_overlay.glsl");
+
+	// Onion skin
+	programs["ghost"] = shader.createProgram("../shaders/lc_vert_ghost.glsl", "../shaders/lc_frag_ghost.glsl");
+	programs["ghost_extrude"] = shader.createProgram("../shaders/lc_vert_ghost_extrude.glsl", "../shaders/lc_geom_ghost_extrude.glsl", "../shaders/lc_frag_ghost.glsl", std::vector<QString>());
+
+	// Prisms extruded from the 2D outlines by the geometry shader
+	programs["pass1_extrude"] = shader.createProgram("../shaders/lc_vert_extrude.glsl", "../shaders/lc_geom_extrude.glsl", "../shaders/lc_frag_pass1.glsl", fragDataNamesP1);
+	programs["shadow_extrude"] = shader.createProgram("../shaders/lc_vert_extrude.glsl", "../shaders/lc_geom_extrude.glsl", "../shaders/lc_frag_shadow.glsl", std::vector<QString>());
+
 	glUseProgram(programs["pass1"]);
 
+	// ring buffer of 3 x 4MB for the vertices of the shapes being dragged
+	stream.init(4 * 1024 * 1024);
+
 
 	//////////////////////////////////////////////
 	// INIT SECOND PASS
@@ -164,6 +281,8 @@ void RenderManager::init(const std::string& vertex_file, const std::string& geom
 }
 
 void RenderManager::resize(int winWidth, int winHeight){
+	width = winWidth;
+	height = winHeight;
 		
 	if(fragDataTex.size()>0){
 		glDeleteTextures(fragDataTex.size(),&fragDataTex[0]);
@@ -356,6 +475,8 @@ void RenderManager::addFaces(const std::vector<boost::shared_ptr<glutils::Face>
 }
 
 void RenderManager::addObject(const QString& object_name, const QString& texture_file, const std::vector<Vertex>& vertices, bool lighting) {
+	TRACE_SCOPE("RenderManager::addObject");
+
 	GLuint texId;
 	
 	if (texture_file.length() > 0) {
@@ -381,6 +502,14 @@ void RenderManager::addObject(const QString& object_name, const QString& texture
 	}
 }
 
+/**
+ * Add an object which is extruded by the geometry shader.
+ * The object is drawn by renderExtrudedObjects() instead of render().
+ */
+void RenderManager::addExtrudedObject(const QString& object_name, const std::vector<glm::vec3>& extrusion, float bottom, float top, const glm::vec4& color) {
+	objects[object_name][0] = GeometryObject(extrusion, bottom, top, color);
+}
+
 void RenderManager::removeObjects() {
 	for (auto it = objects.begin(); it != objects.end(); ++it) {
 		removeObject(it.key());
@@ -392,11 +521,78 @@ void RenderManager::removeObject(const QString& object_name) {
 	for (auto it = objects[object_name].begin(); it != objects[object_name].end(); ++it) {
 		glDeleteBuffers(1, &it->vbo);
 		glDeleteVertexArrays(1, &it->vao);
+		if (it->ghostVBO != 0) glDeleteBuffers(1, &it->ghostVBO);
 	}
 
 	objects[object_name].clear();
 }
 
+/**
+ * Replace the vertices of the object being edited.
+ * The object keeps its VAO and streams the vertices through the persistently mapped ring buffer, so that
+ * updating it in every mouse move does not reallocate the GPU storage. Call stopStreaming() when the edit finishes.
+ * If the ring buffer is not available, the vertices are uploaded to the VBO of the object as usual.
+ */
+void RenderManager::streamObject(const QString& object_name, const std::vector<Vertex>& vertices) {
+	GeometryObject* object = streamingTarget(object_name);
+	if (object == NULL) {
+		removeObject(object_name);
+		addObject(object_name, "", vertices, true);
+		return;
+	}
+
+	object->vertices = vertices;
+	object->extrusion.clear();
+}
+
+/**
+ * Replace the outline of the extruded object being edited in the same way as streamObject().
+ */
+void RenderManager::streamExtrudedObject(const QString& object_name, const std::vector<glm::vec3>& extrusion, float bottom, float top, const glm::vec4& color) {
+	GeometryObject* object = streamingTarget(object_name);
+	if (object == NULL) {
+		removeObject(object_name);
+		addExtrudedObject(object_name, extrusion, bottom, top, color);
+		return;
+	}
+
+	object->vertices.clear();
+	object->extrusion = extrusion;
+	object->extrusionBottom = bottom;
+	object->extrusionTop = top;
+	object->extrusionColor = color;
+}
+
+/**
+ * Return the object whose VAO is reused to stream the new geometry, or NULL if the object has to be created again.
+ */
+GeometryObject* RenderManager::streamingTarget(const QString& object_name) {
+	if (!objects.contains(object_name) || objects[object_name].size() != 1 || !objects[object_name].contains(0)) return NULL;
+
+	GeometryObject& object = objects[object_name][0];
+	object.vaoOutdated = true;
+	object.modelMatrix = glm::mat4();
+	if (stream.isAvailable()) {
+		object.stream = &stream;
+	}
+
+	return &object;
+}
+
+/**
+ * Move the streamed objects back to the static storage.
+ */
+void RenderManager::stopStreaming() {
+	for (auto it = objects.begin(); it != objects.end(); ++it) {
+		for (auto it2 = it->begin(); it2 != it->end(); ++it2) {
+			if (it2->stream != NULL) {
+				it2->stream = NULL;
+				it2->vaoOutdated = true;
+			}
+		}
+	}
+}
+
 void RenderManager::centerObjects() {
 	glm::vec3 minPt((std::numeric_limits<float>::max)(), (std::numeric_limits<float>::max)(), (std::numeric_limits<float>::max)());
 	glm::vec3 maxPt = -minPt;
@@ -447,6 +643,9 @@ void RenderManager::renderAllExcept(const QString& object_name) {
 void RenderManager::render(const QString& object_name) {
 	for (auto it = objects[object_name].begin(); it != objects[object_name].end(); ++it) {
 		GLuint texId = it.key();
+
+		// the extruded objects are drawn by renderExtrudedObjects()
+		if (it->isExtruded()) continue;
 		
 		// vaoを作成
 		it->createVAO();
@@ -480,6 +679,11 @@ void RenderManager::render(const QString& object_name) {
 			glUniform1i(glGetUniformLocation(programs["pass1"], "useShadow"), 0);
 		}
 
+		// the instance transform of the object, which moves the mesh without rebuilding it
+		GLint program;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "modelMatrix"), 1, false, &it->modelMatrix[0][0]);
+
 		// 描画
 		glBindVertexArray(it->vao);
 		glDrawArrays(GL_TRIANGLES, 0, it->vertices.size());
@@ -488,12 +692,452 @@ void RenderManager::render(const QString& object_name) {
 	}
 }
 
-void RenderManager::updateShadowMap(GLWidget3D* glWidget3D, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix) {
+/**
+ * Set the transform which is applied to the vertices of the object when it is rendered.
+ * The vertices on the GPU are not changed, so this is cheap enough to be called for every object in every frame.
+ */
+/**
+ * Draw the objects which are extruded by the geometry shader.
+ * They are drawn by the extrusion variant of the current program (pass1 or shadow), and the program is restored afterwards.
+ * Since the mesh is generated on the GPU from the outline in the local coordinate system, only the outline has to be
+ * uploaded when the outline of a shape is edited, and the pose, the bottom and the top are just uniforms.
+ */
+void RenderManager::renderExtrudedObjects() {
+	GLint program;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+	GLuint extrusion_program;
+	glm::mat4 mvpMatrix;
+	if (program == programs["pass1"]) {
+		extrusion_program = programs["pass1_extrude"];
+		mvpMatrix = cameraMvpMatrix;
+	} else if (program == programs["shadow"]) {
+		extrusion_program = programs["shadow_extrude"];
+		mvpMatrix = lightMvpMatrix;
+	} else {
+		return;
+	}
+
+	glUseProgram(extrusion_program);
+	glUniformMatrix4fv(glGetUniformLocation(extrusion_program, "mvpMatrix"), 1, false, &mvpMatrix[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(extrusion_program, "light_mvpMatrix"), 1, false, &lightMvpMatrix[0][0]);
+	glUniform3f(glGetUniformLocation(extrusion_program, "lightDir"), lightDir.x, lightDir.y, lightDir.z);
+	glUniform1i(glGetUniformLocation(extrusion_program, "shadowMap"), 6);
+	glUniform1i(glGetUniformLocation(extrusion_program, "textureEnabled"), 0);
+	glUniform1i(glGetUniformLocation(extrusion_program, "lighting"), 1);
+	glUniform1i(glGetUniformLocation(extrusion_program, "useShadow"), useShadow ? 1 : 0);
+	glUniform1i(glGetUniformLocation(extrusion_program, "softShadow"), softShadow ? 1 : 0);
+
+	for (auto it = objects.begin(); it != objects.end(); ++it) {
+		for (auto it2 = it->begin(); it2 != it->end(); ++it2) {
+			if (!it2->isExtruded()) continue;
+
+			it2->createVAO();
+
+			glUniformMatrix4fv(glGetUniformLocation(extrusion_program, "modelMatrix"), 1, false, &it2->modelMatrix[0][0]);
+			glUniform1f(glGetUniformLocation(extrusion_program, "zBottom"), it2->extrusionBottom);
+			glUniform1f(glGetUniformLocation(extrusion_program, "zTop"), it2->extrusionTop);
+			glUniform4f(glGetUniformLocation(extrusion_program, "color"), it2->extrusionColor.r, it2->extrusionColor.g, it2->extrusionColor.b, it2->extrusionColor.a);
+
+			glBindVertexArray(it2->vao);
+			glDrawArrays(GL_TRIANGLES, 0, it2->extrusion.size());
+		}
+	}
+	glBindVertexArray(0);
+
+	glUseProgram(program);
+}
+
+void RenderManager::setObjectTransform(const QString& object_name, const glm::mat4& modelMatrix) {
+	if (!objects.contains(object_name)) return;
+
+	for (auto it = objects[object_name].begin(); it != objects[object_name].end(); ++it) {
+		it->modelMatrix = modelMatrix;
+	}
+}
+
+/**
+ * Set the translucent copies of the object, which are drawn by renderGhosts() when the onion skin is shown.
+ */
+void RenderManager::setObjectGhosts(const QString& object_name, const std::vector<GhostInstance>& ghosts) {
+	if (!objects.contains(object_name)) return;
+
+	for (auto it = objects[object_name].begin(); it != objects[object_name].end(); ++it) {
+		it->ghosts = ghosts;
+		it->ghostsOutdated = true;
+	}
+}
+
+/**
+ * Draw the ghosts of all the objects into the default framebuffer with alpha blending.
+ * All the ghosts of an object share its mesh, so each object needs only one instanced draw call regardless of the number of ghosts.
+ * The ghosts of the extruded objects are extruded by the geometry shader in the same way.
+ * The ghosts behind the solid objects are discarded by comparing with the depth buffer of the first pass.
+ */
+void RenderManager::renderGhosts(const Camera& camera, const glm::vec3& light_dir) {
+	TRACE_SCOPE("RenderManager::renderGhosts");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+	glActiveTexture(GL_TEXTURE8);
+	glBindTexture(GL_TEXTURE_2D, fragDepthTex);
+
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	const char* program_names[2] = { "ghost", "ghost_extrude" };
+	for (int k = 0; k < 2; ++k) {
+		GLuint program = programs[program_names[k]];
+		bool extruded = k == 1;
+
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "mvpMatrix"), 1, false, &camera.mvpMatrix[0][0]);
+		glUniform3f(glGetUniformLocation(program, "lightDir"), light_dir.x, light_dir.y, light_dir.z);
+		glUniform2f(glGetUniformLocation(program, "pixelSize"), 1.0f / width, 1.0f / height);
+		glUniform1i(glGetUniformLocation(program, "depthTex"), 8);
+
+		for (auto it = objects.begin(); it != objects.end(); ++it) {
+			for (auto it2 = it->begin(); it2 != it->end(); ++it2) {
+				if (it2->ghosts.empty() || it2->isExtruded() != extruded) continue;
+
+				it2->createVAO();
+				it2->updateGhostVBO();
+
+				glBindVertexArray(it2->vao);
+				if (extruded) {
+					glUniform1f(glGetUniformLocation(program, "zBottom"), it2->extrusionBottom);
+					glUniform1f(glGetUniformLocation(program, "zTop"), it2->extrusionTop);
+					glDrawArraysInstanced(GL_TRIANGLES, 0, it2->extrusion.size(), it2->ghosts.size());
+				}
+				else {
+					glDrawArraysInstanced(GL_TRIANGLES, 0, it2->vertices.size(), it2->ghosts.size());
+				}
+			}
+		}
+	}
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+	glDepthFunc(GL_LEQUAL);
+}
+
+void RenderManager::updateShadowMap(const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix) {
+	TRACE_SCOPE("RenderManager::updateShadowMap");
+
 	if (useShadow) {
-		shadow.update(glWidget3D, light_dir, light_mvpMatrix);
+		lightDir = light_dir;
+		lightMvpMatrix = light_mvpMatrix;
+		shadow.update(this, light_dir, light_mvpMatrix);
 	}
 }
 
+/**
+ * Return the direction of the directional light which the editor and the offscreen renderer use.
+ */
+glm::vec3 RenderManager::defaultLightDir() {
+	return glm::normalize(glm::vec3(-4, -5, -8));
+}
+
+/**
+ * Return the model/view/projection matrix of the shadow map for the directional light,
+ * which covers the area of 100x100 around the origin.
+ */
+glm::mat4 RenderManager::lightMvpMatrixFor(const glm::vec3& light_dir) {
+	glm::mat4 light_pMatrix = glm::ortho<float>(-50, 50, -50, 50, 0.1, 200);
+	glm::mat4 light_mvMatrix = glm::lookAt(-light_dir * 50.0f, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	return light_pMatrix * light_mvMatrix;
+}
+
+/**
+ * Draw the scene.
+ */
+void RenderManager::drawScene() {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(true);
+
+	renderAll();
+	renderExtrudedObjects();
+}
+
+/**
+ * Render all the objects by the current rendering mode into the default framebuffer.
+ * This does not depend on the widget, so that the same pipeline can be used for offscreen rendering.
+ */
+void RenderManager::render(const Camera& camera, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix) {
+	TRACE_SCOPE("RenderManager::render");
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glMatrixMode(GL_MODELVIEW);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// PASS 1: Render to texture
+	profiler.begin(RenderProfiler::GPU_PASS1);
+	glUseProgram(programs["pass1"]);
+	
+	glBindFramebuffer(GL_FRAMEBUFFER, fragDataFB);
+	glClearColor(1, 1, 1, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fragDataTex[0], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, fragDataTex[1], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, fragDataTex[2], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, fragDataTex[3], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fragDepthTex, 0);
+
+	// Set the list of draw buffers.
+	GLenum DrawBuffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	glDrawBuffers(4, DrawBuffers); // "3" is the size of DrawBuffers
+	// Always check that our framebuffer is ok
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("+ERROR: GL_FRAMEBUFFER_COMPLETE false\n");
+		exit(0);
+	}
+
+	cameraMvpMatrix = camera.mvpMatrix;
+	lightMvpMatrix = light_mvpMatrix;
+	lightDir = light_dir;
+	glUniformMatrix4fv(glGetUniformLocation(programs["pass1"], "mvpMatrix"), 1, false, &camera.mvpMatrix[0][0]);
+	glUniform3f(glGetUniformLocation(programs["pass1"], "lightDir"), light_dir.x, light_dir.y, light_dir.z);
+	glUniformMatrix4fv(glGetUniformLocation(programs["pass1"], "light_mvpMatrix"), 1, false, &light_mvpMatrix[0][0]);
+
+	glUniform1i(glGetUniformLocation(programs["pass1"], "shadowMap"), 6);
+	glActiveTexture(GL_TEXTURE6);
+	glBindTexture(GL_TEXTURE_2D, shadow.textureDepth);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	drawScene();
+	profiler.end();
+	
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// PASS 2: Create AO
+	if (renderingMode == RenderManager::RENDERING_MODE_SSAO) {
+		profiler.begin(RenderProfiler::GPU_SSAO);
+		glUseProgram(programs["ssao"]);
+		glBindFramebuffer(GL_FRAMEBUFFER, fragDataFB_AO);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fragAOTex, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fragDepthTex_AO, 0);
+		GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
+		glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
+
+		glClearColor(1, 1, 1, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Always check that our framebuffer is ok
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("++ERROR: GL_FRAMEBUFFER_COMPLETE false\n");
+			exit(0);
+		}
+
+		glDisable(GL_DEPTH_TEST);
+		glDepthFunc(GL_ALWAYS);
+
+		glUniform2f(glGetUniformLocation(programs["ssao"], "pixelSize"), 2.0f / width, 2.0f / height);
+
+		glUniform1i(glGetUniformLocation(programs["ssao"], "tex0"), 1);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[0]);
+
+		glUniform1i(glGetUniformLocation(programs["ssao"], "tex1"), 2);
+		glActiveTexture(GL_TEXTURE2);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[1]);
+
+		glUniform1i(glGetUniformLocation(programs["ssao"], "tex2"), 3);
+		glActiveTexture(GL_TEXTURE3);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[2]);
+
+		glUniform1i(glGetUniformLocation(programs["ssao"], "depthTex"), 8);
+		glActiveTexture(GL_TEXTURE8);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDepthTex);
+
+		glUniform1i(glGetUniformLocation(programs["ssao"], "noiseTex"), 7);
+		glActiveTexture(GL_TEXTURE7);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragNoiseTex);
+
+		{
+			glUniformMatrix4fv(glGetUniformLocation(programs["ssao"], "mvpMatrix"), 1, false, &camera.mvpMatrix[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(programs["ssao"], "pMatrix"), 1, false, &camera.pMatrix[0][0]);
+		}
+
+		glUniform1i(glGetUniformLocation(programs["ssao"], "uKernelSize"), uKernelSize);
+		glUniform3fv(glGetUniformLocation(programs["ssao"], "uKernelOffsets"), uKernelOffsets.size(), (const GLfloat*)uKernelOffsets.data());
+
+		glUniform1f(glGetUniformLocation(programs["ssao"], "uPower"), uPower);
+		glUniform1f(glGetUniformLocation(programs["ssao"], "uRadius"), uRadius);
+
+		glBindVertexArray(secondPassVAO);
+
+		glDrawArrays(GL_QUADS, 0, 4);
+		glBindVertexArray(0);
+		glDepthFunc(GL_LEQUAL);
+		profiler.end();
+	}
+	else if (renderingMode == RenderManager::RENDERING_MODE_LINE || renderingMode == RenderManager::RENDERING_MODE_HATCHING || renderingMode == RenderManager::RENDERING_MODE_SKETCHY) {
+		profiler.begin(RenderProfiler::GPU_LINE);
+		glUseProgram(programs["line"]);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+		glClearColor(1, 1, 1, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		glDisable(GL_DEPTH_TEST);
+		glDepthFunc(GL_ALWAYS);
+
+		glUniform2f(glGetUniformLocation(programs["line"], "pixelSize"), 1.0f / width, 1.0f / height);
+		glUniformMatrix4fv(glGetUniformLocation(programs["line"], "pMatrix"), 1, false, &camera.pMatrix[0][0]);
+		if (renderingMode == RenderManager::RENDERING_MODE_HATCHING) {
+			glUniform1i(glGetUniformLocation(programs["line"], "useHatching"), 1);
+		}
+		else {
+			glUniform1i(glGetUniformLocation(programs["line"], "useHatching"), 0);
+		}
+
+		glUniform1i(glGetUniformLocation(programs["line"], "tex0"), 1);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[0]);
+
+		glUniform1i(glGetUniformLocation(programs["line"], "tex1"), 2);
+		glActiveTexture(GL_TEXTURE2);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[1]);
+
+		glUniform1i(glGetUniformLocation(programs["line"], "tex2"), 3);
+		glActiveTexture(GL_TEXTURE3);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[2]);
+
+		glUniform1i(glGetUniformLocation(programs["line"], "tex3"), 4);
+		glActiveTexture(GL_TEXTURE4);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[3]);
+
+		glUniform1i(glGetUniformLocation(programs["line"], "depthTex"), 8);
+		glActiveTexture(GL_TEXTURE8);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDepthTex);
+
+		glUniform1i(glGetUniformLocation(programs["line"], "hatchingTexture"), 5);
+		glActiveTexture(GL_TEXTURE5);
+		glBindTexture(GL_TEXTURE_3D, hatchingTextures);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		
+		glBindVertexArray(secondPassVAO);
+
+		glDrawArrays(GL_QUADS, 0, 4);
+		glBindVertexArray(0);
+		glDepthFunc(GL_LEQUAL);
+		profiler.end();
+	}
+	else if (renderingMode == RenderManager::RENDERING_MODE_CONTOUR) {
+		profiler.begin(RenderProfiler::GPU_CONTOUR);
+		glUseProgram(programs["contour"]);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+		glClearColor(1, 1, 1, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		glDisable(GL_DEPTH_TEST);
+		glDepthFunc(GL_ALWAYS);
+
+		glUniform2f(glGetUniformLocation(programs["contour"], "pixelSize"), 1.0f / width, 1.0f / height);
+
+		glUniform1i(glGetUniformLocation(programs["contour"], "depthTex"), 8);
+		glActiveTexture(GL_TEXTURE8);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDepthTex);
+
+		glBindVertexArray(secondPassVAO);
+
+		glDrawArrays(GL_QUADS, 0, 4);
+		glBindVertexArray(0);
+		glDepthFunc(GL_LEQUAL);
+		profiler.end();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Blur
+
+	if (renderingMode == RenderManager::RENDERING_MODE_BASIC || renderingMode == RenderManager::RENDERING_MODE_SSAO) {
+		profiler.begin(RenderProfiler::GPU_BLUR);
+		glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+		glClearColor(1, 1, 1, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		glDisable(GL_DEPTH_TEST);
+		glDepthFunc(GL_ALWAYS);
+
+		glUseProgram(programs["blur"]);
+		glUniform2f(glGetUniformLocation(programs["blur"], "pixelSize"), 2.0f / width, 2.0f / height);
+		//printf("pixelSize loc %d\n", glGetUniformLocation(vboRenderManager.programs["blur"], "pixelSize"));
+
+		glUniform1i(glGetUniformLocation(programs["blur"], "tex0"), 1);//COLOR
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[0]);
+
+		glUniform1i(glGetUniformLocation(programs["blur"], "tex1"), 2);//NORMAL
+		glActiveTexture(GL_TEXTURE2);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[1]);
+
+		/*glUniform1i(glGetUniformLocation(programs["blur"], "tex2"), 3);
+		glActiveTexture(GL_TEXTURE3);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDataTex[2]);*/
+
+		glUniform1i(glGetUniformLocation(programs["blur"], "depthTex"), 8);
+		glActiveTexture(GL_TEXTURE8);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragDepthTex);
+
+		glUniform1i(glGetUniformLocation(programs["blur"], "tex3"), 4);//AO
+		glActiveTexture(GL_TEXTURE4);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, fragAOTex);
+
+		if (renderingMode == RenderManager::RENDERING_MODE_SSAO) {
+			glUniform1i(glGetUniformLocation(programs["blur"], "ssao_used"), 1); // ssao used
+		}
+		else {
+			glUniform1i(glGetUniformLocation(programs["blur"], "ssao_used"), 0); // no ssao
+		}
+
+		glBindVertexArray(secondPassVAO);
+
+		glDrawArrays(GL_QUADS, 0, 4);
+		glBindVertexArray(0);
+		glDepthFunc(GL_LEQUAL);
+		profiler.end();
+
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Onion skin
+	if (showGhosts) {
+		profiler.begin(RenderProfiler::GPU_GHOSTS);
+		renderGhosts(camera, light_dir);
+		profiler.end();
+	}
+
+	// the streamed vertices of this frame can be overwritten after the GPU finishes drawing
+	stream.endFrame();
+
+	// REMOVE
+	glActiveTexture(GL_TEXTURE0);
+}
+
+
 GLuint RenderManager::loadTexture(const QString& filename) {
 	QImage img;
 	if (!img.load(filename)) {
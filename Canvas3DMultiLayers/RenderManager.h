@@ -8,8 +8,22 @@
 #include "GLUtils.h"
 #include <boost/shared_ptr.hpp>
 #include "Shader.h"
+#include "Camera.h"
+#include "RenderProfiler.h"
+#include "StreamingBuffer.h"
 #include <map>
 
+/**
+ * Per-instance attributes of a translucent copy of an object.
+ */
+struct GhostInstance {
+	glm::mat4 modelMatrix;
+	glm::vec4 color;
+
+	GhostInstance() {}
+	GhostInstance(const glm::mat4& modelMatrix, const glm::vec4& color) : modelMatrix(modelMatrix), color(color) {}
+};
+
 class GeometryObject {
 public:
 	GLuint vao;
@@ -18,12 +32,34 @@ public:
 	bool lighting;
 	bool vaoCreated;
 	bool vaoOutdated;
+	glm::mat4 modelMatrix;
+
+	// the ring buffer which the vertices are streamed to while the object is being edited (NULL for the static storage)
+	StreamingBuffer* stream;
+	unsigned int streamFrame;
+
+	// translucent copies which are drawn by a single instanced call
+	GLuint ghostVBO;
+	std::vector<GhostInstance> ghosts;
+	bool ghostsOutdated;
+
+	// the cap triangles and the outline of a prism which is extruded by the geometry shader (empty for an ordinary mesh)
+	std::vector<glm::vec3> extrusion;
+	float extrusionBottom;
+	float extrusionTop;
+	glm::vec4 extrusionColor;
 
 public:
 	GeometryObject();
 	GeometryObject(const std::vector<Vertex>& vertices, bool lighting = true);
+	GeometryObject(const std::vector<glm::vec3>& extrusion, float bottom, float top, const glm::vec4& color);
+	bool isExtruded() const { return !extrusion.empty(); }
 	void addVertices(const std::vector<Vertex>& vertices);
 	void createVAO();
+	void updateGhostVBO();
+
+private:
+	void setAttributes(GLintptr offset);
 };
 
 class RenderManager {
@@ -43,6 +79,22 @@ public:
 	GLuint hatchingTextures;
 
 	int renderingMode;
+	RenderProfiler profiler;
+	StreamingBuffer stream;
+
+	// onion skin (draw the ghosts of the objects on top of the rendered image)
+	bool showGhosts;
+
+	// the matrices of the current frame, which are needed again to draw the extruded objects
+	glm::mat4 cameraMvpMatrix;
+	glm::mat4 lightMvpMatrix;
+	glm::vec3 lightDir;
+
+	// size of the viewport, and the framebuffer which the final image is rendered into
+	// (0 for the window, or a framebuffer object for offscreen rendering)
+	int width;
+	int height;
+	GLuint defaultFramebuffer;
 
 	// SSAO
 	std::vector<QString> fragDataNamesP1;//Multi target fragmebuffer names P1
@@ -77,16 +129,29 @@ public:
 
 	void addFaces(const std::vector<boost::shared_ptr<glutils::Face> >& faces, bool lighting);
 	void addObject(const QString& object_name, const QString& texture_file, const std::vector<Vertex>& vertices, bool lighting);
+	void addExtrudedObject(const QString& object_name, const std::vector<glm::vec3>& extrusion, float bottom, float top, const glm::vec4& color);
 	void removeObjects();
 	void removeObject(const QString& object_name);
+	void streamObject(const QString& object_name, const std::vector<Vertex>& vertices);
+	void streamExtrudedObject(const QString& object_name, const std::vector<glm::vec3>& extrusion, float bottom, float top, const glm::vec4& color);
+	void stopStreaming();
 	void centerObjects();
 	void renderAll();
 	void renderAllExcept(const QString& object_name);
 	void render(const QString& object_name);
-	void updateShadowMap(GLWidget3D* glWidget3D, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix);
+	void renderExtrudedObjects();
+	void setObjectTransform(const QString& object_name, const glm::mat4& modelMatrix);
+	void setObjectGhosts(const QString& object_name, const std::vector<GhostInstance>& ghosts);
+	void renderGhosts(const Camera& camera, const glm::vec3& light_dir);
+	void updateShadowMap(const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix);
+	void drawScene();
+	void render(const Camera& camera, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix);
+	static glm::vec3 defaultLightDir();
+	static glm::mat4 lightMvpMatrixFor(const glm::vec3& light_dir);
 	
 
 private:
+	GeometryObject* streamingTarget(const QString& object_name);
 	GLuint loadTexture(const QString& filename);
 	GLuint load3DTexture(const std::vector<QString> & pathes);
 };
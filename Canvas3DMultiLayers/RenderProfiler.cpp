@@ -0,0 +1,179 @@
+#include "RenderProfiler.h"
+#include <QFontMetrics>
+
+const char* RenderProfiler::names[RenderProfiler::NUM_TIMERS] = { "shadow", "pass1", "ssao", "line", "contour", "blur", "ghosts", "cpu_geometry", "cpu_overlay" };
+
+RenderProfiler::RenderProfiler() {
+	showOverlay = false;
+	windowSize = 60;
+	frame = 0;
+	current = -1;
+	for (int i = 0; i < NUM_TIMERS; ++i) {
+		latest[i] = -1;
+	}
+}
+
+RenderProfiler::~RenderProfiler() {
+	stopRecording();
+}
+
+bool RenderProfiler::isEnabled() const {
+	return showOverlay || csv.isOpen();
+}
+
+/**
+ * Start measuring the GPU time of the pass. The queries cannot be nested.
+ * The measurement is skipped if too many queries are still waiting for their results.
+ */
+void RenderProfiler::begin(int timer) {
+	if (!isEnabled()) return;
+	if ((int)pendingQueries.size() >= MAX_PENDING_QUERIES) return;
+
+	PendingQuery pending;
+	pending.timer = timer;
+	if (freeQueries.empty()) {
+		glGenQueries(1, &pending.query);
+	}
+	else {
+		pending.query = freeQueries.back();
+		freeQueries.pop_back();
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, pending.query);
+	pendingQueries.push_back(pending);
+	current = timer;
+}
+
+void RenderProfiler::end() {
+	if (current < 0) return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	current = -1;
+}
+
+void RenderProfiler::addCPUTime(int timer, double ms) {
+	if (!isEnabled()) return;
+
+	addSample(timer, ms);
+}
+
+/**
+ * Call this function at the end of each frame.
+ * The results of the queries which are available are collected, and a line is written to the CSV file.
+ */
+void RenderProfiler::endFrame() {
+	if (!isEnabled()) return;
+
+	frame++;
+	collect();
+
+	if (csv.isOpen()) {
+		QString line = QString::number(frame);
+		for (int i = 0; i < NUM_TIMERS; ++i) {
+			line += ",";
+			if (latest[i] >= 0) line += QString::number(latest[i], 'f', 4);
+		}
+		csv.write((line + "\n").toUtf8());
+	}
+
+	for (int i = 0; i < NUM_TIMERS; ++i) {
+		latest[i] = -1;
+	}
+}
+
+/**
+ * Return the average time in milliseconds over the sliding window.
+ */
+double RenderProfiler::average(int timer) const {
+	if (samples[timer].empty()) return 0.0;
+
+	double sum = 0.0;
+	for (int i = 0; i < samples[timer].size(); ++i) {
+		sum += samples[timer][i];
+	}
+	return sum / samples[timer].size();
+}
+
+/**
+ * Draw the average timings at the specified position of the screen.
+ */
+void RenderProfiler::draw(QPainter& painter, int x, int y) const {
+	QFontMetrics fm = painter.fontMetrics();
+	int line_height = fm.height();
+
+	painter.save();
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(QColor(0, 0, 0, 160));
+	painter.drawRect(x, y, 180, line_height * (NUM_TIMERS + 1) + 8);
+
+	painter.setPen(QColor(255, 255, 255));
+	int y2 = y + 4 + fm.ascent();
+	painter.drawText(x + 6, y2, QString("frame time (avg of %1)").arg(windowSize));
+	for (int i = 0; i < NUM_TIMERS; ++i) {
+		y2 += line_height;
+		painter.drawText(x + 6, y2, names[i]);
+		painter.drawText(x + 110, y2, QString("%1 ms").arg(average(i), 0, 'f', 3));
+	}
+	painter.restore();
+}
+
+/**
+ * Start streaming the timings of each frame to the CSV file.
+ */
+bool RenderProfiler::startRecording(const QString& filename) {
+	stopRecording();
+
+	csv.setFileName(filename);
+	if (!csv.open(QFile::WriteOnly | QFile::Text)) return false;
+
+	QString header = "frame";
+	for (int i = 0; i < NUM_TIMERS; ++i) {
+		header += QString(",") + names[i];
+	}
+	csv.write((header + "\n").toUtf8());
+
+	return true;
+}
+
+void RenderProfiler::stopRecording() {
+	if (csv.isOpen()) {
+		csv.close();
+	}
+}
+
+bool RenderProfiler::isRecording() const {
+	return csv.isOpen();
+}
+
+/**
+ * Read the results of the pending queries which are available, and return the queries to the pool.
+ * The others are kept pending until a later frame, so this function never waits for the GPU.
+ */
+void RenderProfiler::collect() {
+	int num_pending = 0;
+	for (int i = 0; i < pendingQueries.size(); ++i) {
+		GLint available = 0;
+		glGetQueryObjectiv(pendingQueries[i].query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			pendingQueries[num_pending++] = pendingQueries[i];
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(pendingQueries[i].query, GL_QUERY_RESULT, &elapsed);
+		freeQueries.push_back(pendingQueries[i].query);
+
+		addSample(pendingQueries[i].timer, elapsed * 1e-6);
+	}
+	pendingQueries.resize(num_pending);
+}
+
+void RenderProfiler::addSample(int timer, double ms) {
+	samples[timer].push_back(ms);
+	while (samples[timer].size() > windowSize) {
+		samples[timer].pop_front();
+	}
+
+	// a timer can be measured more than once a frame (e.g. the shadow map), so the times are added up
+	latest[timer] = latest[timer] < 0 ? ms : latest[timer] + ms;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "glew.h"
+#include <deque>
+#include <vector>
+#include <QPainter>
+#include <QFile>
+#include <QString>
+
+/**
+ * Profiler of the render passes and the CPU-side work of a frame.
+ * The GPU time of each pass is measured by a GL_TIME_ELAPSED query taken from a pool for each measurement,
+ * since a pass may run several times a frame. The queries are resolved at the end of the frames once their
+ * results are available, so the pipeline is never stalled. The timings are averaged
+ * over a sliding window, and can be shown as an overlay or streamed to a CSV file.
+ * Nothing is measured while neither the overlay nor the CSV recording is active.
+ */
+class RenderProfiler {
+public:
+	static enum { GPU_SHADOW = 0, GPU_PASS1, GPU_SSAO, GPU_LINE, GPU_CONTOUR, GPU_BLUR, GPU_GHOSTS, CPU_GEOMETRY, CPU_OVERLAY, NUM_TIMERS };
+	static const int NUM_GPU_TIMERS = CPU_GEOMETRY;
+	static const char* names[NUM_TIMERS];
+	// the measurements are dropped while this many queries are waiting for their results
+	static const int MAX_PENDING_QUERIES = 64;
+
+public:
+	bool showOverlay;
+	int windowSize;
+
+private:
+	struct PendingQuery {
+		GLuint query;
+		int timer;
+	};
+
+	std::vector<GLuint> freeQueries;
+	std::vector<PendingQuery> pendingQueries;
+	int frame;
+	int current;
+	std::deque<double> samples[NUM_TIMERS];
+	double latest[NUM_TIMERS];
+	QFile csv;
+
+public:
+	RenderProfiler();
+	~RenderProfiler();
+
+	bool isEnabled() const;
+	void begin(int timer);
+	void end();
+	void addCPUTime(int timer, double ms);
+	void endFrame();
+	double average(int timer) const;
+	void draw(QPainter& painter, int x, int y) const;
+	bool startRecording(const QString& filename);
+	void stopRecording();
+	bool isRecording() const;
+
+private:
+	void collect();
+	void addSample(int timer, double ms);
+};
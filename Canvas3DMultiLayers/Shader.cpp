@@ -29,12 +29,34 @@ uint Shader::createProgram(const string& vertex_file, const string& fragment_fil
 }
 
 uint Shader::createProgram(const string& vertex_file, const string& fragment_file, const std::vector<QString>& fragDataNamesP1) {
+	return createProgram(vertex_file, "", fragment_file, fragDataNamesP1);
+}
+
+/**
+ * Create a program which has a geometry shader between the vertex shader and the fragment shader.
+ * The geometry shader is not used if geometry_file is empty.
+ *
+ * @param vertex_file		vertex shader file
+ * @param geometry_file		geometry shader file
+ * @param fragment_file		frament shader file
+ * @param fragDataNamesP1	names of the outputs of the fragment shader
+ * @return					program id
+ */
+uint Shader::createProgram(const string& vertex_file, const string& geometry_file, const string& fragment_file, const std::vector<QString>& fragDataNamesP1) {
 	std::cout << "Compiling " << vertex_file << std::endl;
 
 	std::string source;
 	loadTextFile(vertex_file, source);
 	GLuint vertex_shader = compileShader(source, GL_VERTEX_SHADER);
 
+	GLuint geometry_shader = 0;
+	if (!geometry_file.empty()) {
+		std::cout << "Compiling " << geometry_file << std::endl;
+
+		loadTextFile(geometry_file, source);
+		geometry_shader = compileShader(source, GL_GEOMETRY_SHADER);
+	}
+
 	std::cout << "Compiling " << fragment_file << std::endl;
 
 	loadTextFile(fragment_file, source);
@@ -43,6 +65,9 @@ uint Shader::createProgram(const string& vertex_file, const string& fragment_fil
 	// create program
 	GLuint program = glCreateProgram();
 	glAttachShader(program, vertex_shader);
+	if (geometry_shader != 0) {
+		glAttachShader(program, geometry_shader);
+	}
 	glAttachShader(program, fragment_shader);
 	if (fragDataNamesP1.size() == 0) {
 		glBindFragDataLocation(program, 0, "outputF");
@@ -71,6 +96,7 @@ uint Shader::createProgram(const string& vertex_file, const string& fragment_fil
 	
 	programs.push_back(program);
 	vertex_shaders.push_back(vertex_shader);
+	geometry_shaders.push_back(geometry_shader);
 	fragment_shaders.push_back(fragment_shader);
 
 	return program;
@@ -80,12 +106,17 @@ void Shader::cleanShaders() {
 	for (int pN = 0; pN<programs.size(); pN++){
 		glDetachShader(programs[pN], vertex_shaders[pN]);
 		glDetachShader(programs[pN], fragment_shaders[pN]);
+		if (geometry_shaders[pN] != 0) {
+			glDetachShader(programs[pN], geometry_shaders[pN]);
+			glDeleteShader(geometry_shaders[pN]);
+		}
 		glDeleteShader(vertex_shaders[pN]);
 		glDeleteShader(fragment_shaders[pN]);
 		glDeleteProgram(programs[pN]);
 	}
 	programs.clear();
 	vertex_shaders.clear();
+	geometry_shaders.clear();
 	fragment_shaders.clear();
 }
 
@@ -11,6 +11,7 @@ public:
 
 	uint createProgram(const std::string& vertex_file, const std::string& fragment_file);
 	uint createProgram(const std::string& vertex_file, const std::string& fragment_file, const std::vector<QString>& fragDataNamesP1);
+	uint createProgram(const std::string& vertex_file, const std::string& geometry_file, const std::string& fragment_file, const std::vector<QString>& fragDataNamesP1);
 	void cleanShaders();
 
 private:
@@ -20,6 +21,7 @@ private:
 private:
 	std::vector<GLuint> programs;
 	std::vector<GLuint> vertex_shaders;
+	std::vector<GLuint> geometry_shaders;
 	std::vector<GLuint> fragment_shaders;
 };
 
@@ -1,13 +1,18 @@
 ﻿#include "ShadowMapping.h"
-#include "GLWidget3D.h"
+#include "RenderManager.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <algorithm>
 
 #ifndef M_PI
 #define M_PI	3.1415926535
 #endif
 
 ShadowMapping::ShadowMapping() {
+	width = 0;
+	height = 0;
+	memoryBudget = (size_t)DEFAULT_MEMORY_BUDGET_MB * 1024 * 1024;
+	numKeys = 1;
 }
 
 /**
@@ -30,12 +35,33 @@ void ShadowMapping::init(int programId, int width, int height) {
 	glBindFramebuffer(GL_FRAMEBUFFER, fboDepth);
 		
 	// 影のデプスバッファを保存するための2Dテクスチャを作成
-	glGenTextures(1, &textureDepth);
+	textureDepth = createTexture();
+
+	// the first shadow map is used for the first layer
+	CachedShadowMap map = { 0, textureDepth, false };
+	cachedMaps.push_back(map);
+
+	// 生成した2Dテクスチャを、デプスバッファとしてfboに括り付ける。
+	// 以後、このfboに対するレンダリングを実施すると、デプスバッファのデータは
+	// この2Dテクスチャに自動的に保存される。
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textureDepth, 0);
+
+	glActiveTexture(GL_TEXTURE0);
+		
+	glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+/**
+ * Create a depth texture of the size of the shadow map.
+ */
+uint ShadowMapping::createTexture() {
+	uint texture;
+	glGenTextures(1, &texture);
 
 	// GL_TEXTURE6に、このデプスバッファをbindすることで、
 	// シェーダからは6番でアクセスできる
 	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, textureDepth);
+	glBindTexture(GL_TEXTURE_2D, texture);
 
 	// テクスチャパラメータの設定
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -46,25 +72,18 @@ void ShadowMapping::init(int programId, int width, int height) {
     // テクスチャ領域の確保(GL_DEPTH_COMPONENTを用いる)
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
-	// 生成した2Dテクスチャを、デプスバッファとしてfboに括り付ける。
-	// 以後、このfboに対するレンダリングを実施すると、デプスバッファのデータは
-	// この2Dテクスチャに自動的に保存される。
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textureDepth, 0);
-
-	glActiveTexture(GL_TEXTURE0);
-		
-	glBindFramebuffer(GL_FRAMEBUFFER,0);
+	return texture;
 }
 
 /**
  * シャドウマップを作成し、GL_TEXTURE6にテクスチャとして保存する。
  *
- * @param glWidget3D		GLWidget3Dクラス。このクラスのdrawScene(1)を呼び出してシーンを描画し、シャドウマップを生成する。
+ * @param renderManager	RenderManagerクラス。このクラスのdrawScene()を呼び出してシーンを描画し、シャドウマップを生成する。
  * @param light_dir			光の進行方向
  */
-void ShadowMapping::update(GLWidget3D* glWidget3D, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix) {
-	int origWidth = glWidget3D->width();
-	int origHeigh = glWidget3D->height();
+void ShadowMapping::update(RenderManager* renderManager, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix) {
+	int origWidth = renderManager->width;
+	int origHeigh = renderManager->height;
 				
 	glUseProgram(programId);
 
@@ -72,6 +91,7 @@ void ShadowMapping::update(GLWidget3D* glWidget3D, const glm::vec3& light_dir, c
 	// この結果、デプスバッファはtextureDepthに保存される。
     glBindFramebuffer(GL_FRAMEBUFFER, fboDepth);
     glEnable(GL_TEXTURE_2D);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textureDepth, 0);
 
 	// ビューポートをシャドウマップの大きさに変更
 	glViewport(0, 0, width, height);
@@ -94,15 +114,103 @@ void ShadowMapping::update(GLWidget3D* glWidget3D, const glm::vec3& light_dir, c
 	glDepthFunc(GL_LEQUAL);
 
 	//RENDER
-	glWidget3D->drawScene();
+	renderManager->profiler.begin(RenderProfiler::GPU_SHADOW);
+	renderManager->drawScene();
+	renderManager->profiler.end();
 	
 	// この時点で、textureDepthにデプス情報が格納されている
+	cachedMaps.front().valid = true;
 	
-	glBindFramebuffer(GL_FRAMEBUFFER,0);
+	glBindFramebuffer(GL_FRAMEBUFFER, renderManager->defaultFramebuffer);
 	glDisable(GL_TEXTURE_2D);
 	glDisable(GL_POLYGON_OFFSET_FILL);
-	glDrawBuffer(GL_BACK);
+	glDrawBuffer(renderManager->defaultFramebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
 
 	// ビューポートを戻す
 	glViewport(0, 0, origWidth, origHeigh);
 }
+
+/**
+ * Make the shadow map of the key (the layer) current.
+ * When the key does not have a shadow map yet, the least recently used one is recycled if the memory budget does not allow
+ * another one.
+ *
+ * @param key	key of the shadow map
+ * @return		true if the shadow map is up to date, or false if update() has to be called
+ */
+bool ShadowMapping::select(int key) {
+	for (std::list<CachedShadowMap>::iterator it = cachedMaps.begin(); it != cachedMaps.end(); ++it) {
+		if (it->key == key) {
+			cachedMaps.splice(cachedMaps.begin(), cachedMaps, it);
+			textureDepth = cachedMaps.front().texture;
+			return cachedMaps.front().valid;
+		}
+	}
+
+	CachedShadowMap map = { key, 0, false };
+	if (!cachedMaps.empty() && (int)cachedMaps.size() >= maxCachedMaps()) {
+		map.texture = cachedMaps.back().texture;
+		cachedMaps.pop_back();
+	}
+	else {
+		map.texture = createTexture();
+		glActiveTexture(GL_TEXTURE0);
+	}
+	cachedMaps.push_front(map);
+	textureDepth = map.texture;
+
+	return false;
+}
+
+/**
+ * Mark all the shadow maps as outdated. The textures are kept for reuse.
+ */
+void ShadowMapping::invalidate() {
+	for (std::list<CachedShadowMap>::iterator it = cachedMaps.begin(); it != cachedMaps.end(); ++it) {
+		it->valid = false;
+	}
+}
+
+void ShadowMapping::invalidate(int key) {
+	for (std::list<CachedShadowMap>::iterator it = cachedMaps.begin(); it != cachedMaps.end(); ++it) {
+		if (it->key == key) it->valid = false;
+	}
+}
+
+/**
+ * Set the GPU memory in bytes which the shadow maps of the layers may use.
+ * The least recently used shadow maps which no longer fit are deleted.
+ */
+void ShadowMapping::setMemoryBudget(size_t memoryBudget) {
+	this->memoryBudget = memoryBudget;
+	trim();
+}
+
+/**
+ * Set the number of the keys (the layers), since keeping more shadow maps than the layers is just a waste of memory.
+ * The least recently used shadow maps which are no longer needed are deleted.
+ */
+void ShadowMapping::setNumKeys(int numKeys) {
+	this->numKeys = numKeys;
+	trim();
+}
+
+/**
+ * Return the number of the shadow maps which can be kept, i.e., the number of the maps of this size which fit in
+ * the memory budget, but not more than the number of the keys. The current shadow map is always kept.
+ */
+int ShadowMapping::maxCachedMaps() const {
+	size_t size = (size_t)width * height * 4;
+	size_t num_maps = size > 0 ? memoryBudget / size : 1;
+	return (std::max)(1, (int)(std::min)(num_maps, (size_t)numKeys));
+}
+
+/**
+ * Delete the least recently used shadow maps beyond the limit.
+ */
+void ShadowMapping::trim() {
+	while ((int)cachedMaps.size() > maxCachedMaps()) {
+		glDeleteTextures(1, &cachedMaps.back().texture);
+		cachedMaps.pop_back();
+	}
+}
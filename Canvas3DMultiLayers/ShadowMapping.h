@@ -3,10 +3,23 @@
 #include <glew.h>
 #include <QGLWidget>
 #include <glm/glm.hpp>
+#include <list>
 
-class GLWidget3D;
+class RenderManager;
+
+/**
+ * A shadow map kept on the GPU for a layer.
+ */
+struct CachedShadowMap {
+	int key;
+	uint texture;
+	bool valid;
+};
 
 class ShadowMapping {
+public:
+	static const int DEFAULT_MEMORY_BUDGET_MB = 512;
+
 public:
 	int width;
 	int height;
@@ -16,11 +29,27 @@ public:
 	uint fboDepth;
 	uint textureDepth;
 
+	// shadow maps of the layers, the most recently used first
+	// (at most as many as the layers, and as many as the memory budget allows, but at least the current one)
+	std::list<CachedShadowMap> cachedMaps;
+	size_t memoryBudget;
+	int numKeys;
+
 public:
 	ShadowMapping();
 
 	void init(int programId, int width, int height);
-	void update(GLWidget3D* glWidget3D, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix);
+	void update(RenderManager* renderManager, const glm::vec3& light_dir, const glm::mat4& light_mvpMatrix);
+	bool select(int key);
+	void invalidate();
+	void invalidate(int key);
+	void setMemoryBudget(size_t memoryBudget);
+	void setNumKeys(int numKeys);
+
+private:
+	uint createTexture();
+	int maxCachedMaps() const;
+	void trim();
 };
 
 
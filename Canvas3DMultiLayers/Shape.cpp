@@ -1,21 +1,38 @@
 #include "Shape.h"
 #include <QImage>
 #include "GLUtils.h"
+#include "OverlayRenderer.h"
+#include "Trace.h"
 
 namespace canvas {
 
 	QImage Shape::rotation_marker = QImage("resources/rotation_marker.png").scaled(16, 16);
 	std::vector<QBrush> Shape::brushes = { QBrush(QColor(0, 255, 0, 60)), QBrush(QColor(0, 0, 255, 30)) };
+	std::vector<QPen> Shape::pens = { QPen(QColor(0, 0, 0), 1), QPen(QColor(0, 0, 255), 2) };
+	QAtomicInt Shape::next_id(0);
+	QAtomicInt Shape::next_geometry_version(0);
+	bool Shape::gpu_extrusion = false;
 
 	Shape::Shape(int subtype) {
+		id = newId();
 		this->subtype = subtype;
 		selected = false;
 		currently_drawing = false;
+		geometry_outdated = false;
+		updateGeometryVersion();
 	}
 	
 	Shape::~Shape() {
 	}
 
+	/**
+	 * Return a new ID for a logical shape.
+	 * The copies of the shape in the other layers share the same ID, so it can be used to find the corresponding shape in any layer.
+	 */
+	int Shape::newId() {
+		return next_id.fetchAndAddOrdered(1);
+	}
+
 	/**
 	* Return a model matrix which transform the local coordinates to the world coordinates.
 	*/
@@ -39,19 +56,28 @@ namespace canvas {
 		currently_drawing = true;
 	}
 
-	void Shape::completeDrawing() {
+	/**
+	 * Finish drawing the shape, and repair its geometry if it is invalid.
+	 * Return the result of repair().
+	 */
+	int Shape::completeDrawing() {
 		currently_drawing = false;
+		int result = repair();
 
 		update3DGeometry();
+
+		return result;
 	}
 
 	void Shape::translate(const glm::dvec2& vec) {
+		TRACE_SCOPE("Shape::translate");
 		pos += vec;
 
-		update3DGeometry();
+		updatePose();
 	}
 
 	void Shape::rotate(double angle) {
+		TRACE_SCOPE("Shape::rotate");
 		glm::dvec2 c = boundingBox().center();
 		glm::dvec2 c2(cos(theta) * c.x - sin(theta) * c.y, sin(theta) * c.x + cos(theta) * c.y);
 
@@ -60,13 +86,89 @@ namespace canvas {
 
 		theta += angle;
 
-		update3DGeometry();
+		updatePose();
 	}
 
 	glm::dvec2 Shape::getCenter() const {
 		return boundingBox().center();
 	}
 	
+	/**
+	 * Return the axis aligned bounding box in the world coordinate system.
+	 */
+	BoundingBox Shape::worldBoundingBox() const {
+		BoundingBox bbox = boundingBox();
+
+		glm::dvec2 corners[4] = { bbox.minPt, glm::dvec2(bbox.maxPt.x, bbox.minPt.y), bbox.maxPt, glm::dvec2(bbox.minPt.x, bbox.maxPt.y) };
+		glm::dvec2 minPt((std::numeric_limits<double>::max)(), (std::numeric_limits<double>::max)());
+		glm::dvec2 maxPt = -minPt;
+		for (int i = 0; i < 4; ++i) {
+			glm::dvec2 pt = worldCoordinate(corners[i]);
+			minPt = glm::min(minPt, pt);
+			maxPt = glm::max(maxPt, pt);
+		}
+
+		return BoundingBox(minPt, maxPt);
+	}
+
+	/**
+	 * Add the shape to the batch of the OpenGL overlay renderer.
+	 * This draws the same thing as draw(QPainter&, ...), but the primitives are only accumulated
+	 * in the renderer, which draws all of them at once.
+	 */
+	void Shape::draw(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const {
+		// fill
+		if (!currently_drawing) {
+			ensure3DGeometry();
+			std::vector<glm::vec2> triangles(fill_triangles.size());
+			for (int i = 0; i < fill_triangles.size(); ++i) {
+				triangles[i] = screenCoordinate(worldCoordinate(glm::dvec2(fill_triangles[i])), origin, scale);
+			}
+			renderer.addTriangles(triangles, OverlayRenderer::color(brushes[subtype].color()));
+		}
+
+		// edges
+		std::vector<glm::dvec2> points = getOutline(scale);
+		std::vector<glm::vec2> pts(points.size());
+		for (int i = 0; i < points.size(); ++i) {
+			pts[i] = screenCoordinate(points[i], origin, scale);
+		}
+		const QPen& pen = (selected || currently_drawing) ? pens[1] : pens[0];
+		renderer.addPolyline(pts, OverlayRenderer::color(pen.color()), pen.width(), true);
+
+		if (selected) {
+			drawMarkers(renderer, origin, scale);
+		}
+	}
+
+	/**
+	 * Add the resize markers at the corners of the bounding box and the rotation marker.
+	 */
+	void Shape::drawMarkers(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const {
+		BoundingBox bbox = boundingBox();
+		glm::dvec2 corners[4] = { bbox.minPt, glm::dvec2(bbox.maxPt.x, bbox.minPt.y), bbox.maxPt, glm::dvec2(bbox.minPt.x, bbox.maxPt.y) };
+		for (int i = 0; i < 4; ++i) {
+			renderer.addSquare(screenCoordinate(worldCoordinate(corners[i]), origin, scale), 6, -theta, glm::vec4(1, 1, 1, 1), OverlayRenderer::color(pens[0].color()));
+		}
+
+		renderer.addMarker(screenCoordinate(worldCoordinate(getRotationMarkerPosition(scale)), origin, scale), -theta);
+	}
+
+	/**
+	 * Return the screen coordinates of the point in the world coordinate system.
+	 */
+	glm::vec2 Shape::screenCoordinate(const glm::dvec2& point, const glm::dvec2& origin, double scale) {
+		return glm::vec2(origin.x + point.x * scale, origin.y - point.y * scale);
+	}
+
+	/**
+	 * Return the points of the outline in the world coordinate system, which is drawn on the screen of the given scale.
+	 * The shapes that are approximated by polygons can adapt the number of points to the scale.
+	 */
+	std::vector<glm::dvec2> Shape::getOutline(double scale) const {
+		return getPoints();
+	}
+
 	glm::dvec2 Shape::getRotationMarkerPosition(double scale) const {
 		BoundingBox bbox = boundingBox();
 
@@ -81,9 +183,58 @@ namespace canvas {
 		return glm::dvec2(point.x * cos(theta) - point.y * sin(theta) + pos.x, point.x * sin(theta) + point.y * cos(theta) + pos.y);
 	}
 
+	/**
+	 * Generate the 3D geometry of the shape.
+	 * When the prisms are extruded on the GPU, only the outline and the triangles of the cap are generated in the local
+	 * coordinate system, and the full mesh is built later in the world coordinate system only if someone asks for it.
+	 */
 	void Shape::update3DGeometry() {
+		// the update follows a change of the geometry or the pose
+		updateGeometryVersion();
+		build3DGeometry();
+	}
+
+	/**
+	 * Update the 3D geometry after the pose has changed.
+	 * The prism extruded on the GPU is placed by the model matrix, so it is kept as it is, and only the mesh which has
+	 * been built in the world coordinate system for someone else is discarded.
+	 */
+	void Shape::updatePose() {
+		if (gpu_extrusion && !geometry_outdated && !extrusion.empty()) {
+			updateGeometryVersion();
+			vertices.clear();
+		}
+		else {
+			update3DGeometry();
+		}
+	}
+
+	/**
+	 * Generate the 3D geometry without changing the version, e.g., when the deferred generation catches up.
+	 */
+	void Shape::build3DGeometry() {
 		vertices.clear();
+		extrusion.clear();
 
+		if (gpu_extrusion) {
+			std::vector<glm::dvec2> points = getPoints();
+			std::vector<glm::vec2> pts(points.size());
+			for (int i = 0; i < pts.size(); i++) {
+				pts[i] = glm::vec2(localCoordinate(points[i]));
+			}
+			glutils::buildExtrusion(pts, extrusion);
+		}
+		else {
+			buildMesh();
+		}
+
+		updateFillTriangles();
+	}
+
+	/**
+	 * Generate the triangles of the prism whose base is the shape.
+	 */
+	void Shape::buildMesh() {
 		std::vector<glm::dvec2> points = getPoints();
 		std::vector<glm::vec2> pts(points.size());
 		for (int i = 0; i < pts.size(); i++) {
@@ -91,4 +242,67 @@ namespace canvas {
 		}
 		glutils::drawPrism(pts, 10, glm::vec4(0.7, 1, 0.7, 1), glm::translate(glm::mat4(), glm::vec3(0, 0, -10)), vertices);
 	}
-}
\ No newline at end of file
+
+	/**
+	 * Generate the 3D geometry if it has been deferred.
+	 * The shapes loaded from a file are not tessellated until their geometry is used for the first time,
+	 * so that the layers which are never shown do not pay for it.
+	 */
+	void Shape::ensure3DGeometry() const {
+		if (geometry_outdated) {
+			const_cast<Shape*>(this)->build3DGeometry();
+		}
+	}
+
+	/**
+	 * Generate the triangles of the prism if only the input of the GPU extrusion has been generated.
+	 */
+	void Shape::ensureMesh() const {
+		ensure3DGeometry();
+		if (vertices.empty() && !extrusion.empty()) {
+			const_cast<Shape*>(this)->buildMesh();
+		}
+	}
+
+	/**
+	 * Keep the triangles of the top face of the 3D geometry in the local coordinate system to fill the shape in the 2D editor.
+	 */
+	void Shape::updateFillTriangles() {
+		fill_triangles.clear();
+		if (!extrusion.empty()) {
+			for (int i = 0; i + 2 < extrusion.size(); i += 3) {
+				if (extrusion[i].z != 0.0f) continue;
+				for (int k = 0; k < 3; ++k) {
+					fill_triangles.push_back(glm::vec2(extrusion[i + k]));
+				}
+			}
+		}
+		else {
+			for (int i = 0; i + 2 < vertices.size(); i += 3) {
+				if (vertices[i].normal.z < 0.5f || vertices[i + 1].normal.z < 0.5f || vertices[i + 2].normal.z < 0.5f) continue;
+				for (int k = 0; k < 3; ++k) {
+					fill_triangles.push_back(glm::vec2(localCoordinate(glm::dvec2(vertices[i + k].position))));
+				}
+			}
+		}
+
+		geometry_outdated = false;
+	}
+
+	/**
+	 * Give the geometry a new version, which is unique among all the shapes.
+	 * The copies of a shape share the version until either of them is changed, so the version can be used
+	 * as the key of the results computed from the outline in the world coordinate system.
+	 */
+	void Shape::updateGeometryVersion() {
+		geometry_version = next_geometry_version.fetchAndAddOrdered(1);
+	}
+
+	/**
+	 * Take over the ID and the geometry version of the other shape, whose outline this shape has been copied from.
+	 */
+	void Shape::copyIdentity(const Shape& other) {
+		id = other.id;
+		geometry_version = other.geometry_version;
+	}
+}
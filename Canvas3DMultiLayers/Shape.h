@@ -6,9 +6,13 @@
 #include <QPainter>
 #include <QDomDocument>
 #include <QImage>
+#include <QAtomicInt>
 #include <boost/shared_ptr.hpp>
 #include "BoundingBox.h"
 #include "Vertex.h"
+#include "PolygonValidator.h"
+
+class OverlayRenderer;
 
 namespace canvas {
 
@@ -19,6 +23,7 @@ namespace canvas {
 		static enum { RESIZE_TOP_LEFT = 0, RESIZE_TOP_RIGHT, RESIZE_BOTTOM_LEFT, RESIZE_BOTTOM_RIGHT };
 
 	protected:
+		int id;
 		int type;
 		int subtype;
 		bool selected;
@@ -26,39 +31,79 @@ namespace canvas {
 		glm::dvec2 pos;
 		double theta;
 		std::vector<Vertex> vertices;
+		std::vector<glm::vec2> fill_triangles;
+		std::vector<glm::vec3> extrusion;
+		bool geometry_outdated;
+		int geometry_version;
+		static bool gpu_extrusion;
 		static QImage rotation_marker;
 		static std::vector<QBrush> brushes;
+		static std::vector<QPen> pens;
+		static QAtomicInt next_id;
+		static QAtomicInt next_geometry_version;
 
 	public:
 		Shape(int subtype);
 		~Shape();
 
+		int getId() const { return id; }
+		void setId(int id) { this->id = id; }
+		static int newId();
 		int getType() { return type; }
 		int getSubType() { return subtype; }
+		glm::dvec2 getPosition() const { return pos; }
+		double getRotation() const { return theta; }
 		virtual boost::shared_ptr<Shape> clone() const = 0;
+		virtual boost::shared_ptr<Shape> cloneOutline() const = 0;
 		virtual void draw(QPainter& painter, const QPointF& origin, double scale) const = 0;
+		virtual void draw(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const;
 		virtual QDomElement toXml(QDomDocument& doc) const = 0;
 		glm::dmat3x3 getModelMatrix() const;
 		virtual void addPoint(const glm::dvec2& point) = 0;
 		virtual std::vector<glm::dvec2> getPoints() const = 0;
+		virtual std::vector<glm::dvec2> getOutline(double scale) const;
 		virtual void updateByNewPoint(const glm::dvec2& point, bool shiftPressed) = 0;
 		void select();
 		void unselect();
 		bool isSelected() const;
 		void startDrawing();
-		void completeDrawing();
-		std::vector<Vertex>& getVertices() { return vertices; }
-		std::vector<Vertex> getVertices() const { return vertices; }
+		int completeDrawing();
+		std::vector<Vertex>& getVertices() { ensureMesh(); return vertices; }
+		std::vector<Vertex> getVertices() const { ensureMesh(); return vertices; }
+		const std::vector<glm::vec3>& getExtrusion() const { ensure3DGeometry(); return extrusion; }
+		static void setGPUExtrusion(bool gpu_extrusion) { Shape::gpu_extrusion = gpu_extrusion; }
+		static bool isGPUExtrusion() { return gpu_extrusion; }
 		virtual bool hit(const glm::dvec2& point) const = 0;
 		void translate(const glm::dvec2& vec);
 		virtual void resize(const glm::dvec2& scale, const glm::dvec2& resize_center) = 0;
 		void rotate(double angle);
 		glm::dvec2 getCenter() const;
 		virtual BoundingBox boundingBox() const = 0;
+		BoundingBox worldBoundingBox() const;
 		glm::dvec2 getRotationMarkerPosition(double scale) const;
 		glm::dvec2 localCoordinate(const glm::dvec2& point) const; 
 		glm::dvec2 worldCoordinate(const glm::dvec2& point) const;
-		void update3DGeometry();
+		virtual void update3DGeometry();
+		virtual bool hasSameGeometry(const boost::shared_ptr<Shape>& other) const = 0;
+		virtual bool shareGeometry(const boost::shared_ptr<Shape>& other) { return false; }
+		virtual int repair() { return glutils::PolygonValidator::VALID; }
+		virtual int simplify(double tolerance, const std::vector<bool>& pinned) { return 0; }
+		void ensure3DGeometry() const;
+		bool is3DGeometryDeferred() const { return geometry_outdated; }
+		void invalidate3DGeometry() { geometry_outdated = true; updateGeometryVersion(); }
+		int getGeometryVersion() const { return geometry_version; }
+		static const QImage& getRotationMarker() { return rotation_marker; }
+
+	protected:
+		virtual void drawMarkers(OverlayRenderer& renderer, const glm::dvec2& origin, double scale) const;
+		virtual void buildMesh();
+		void updatePose();
+		void build3DGeometry();
+		void ensureMesh() const;
+		void updateFillTriangles();
+		void updateGeometryVersion();
+		void copyIdentity(const Shape& other);
+		static glm::vec2 screenCoordinate(const glm::dvec2& point, const glm::dvec2& origin, double scale);
 	};
 
 }
\ No newline at end of file
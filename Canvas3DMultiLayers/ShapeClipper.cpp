@@ -0,0 +1,136 @@
+#include "ShapeClipper.h"
+#include <algorithm>
+#include <cmath>
+
+namespace canvas {
+
+	namespace {
+
+		/**
+		 * Return the outline of the shape in the world coordinate system in counter-clockwise order,
+		 * so that the outlines of several shapes are not taken as holes of each other.
+		 */
+		ShapeClipper::Path orientedOutline(const boost::shared_ptr<Shape>& shape) {
+			ShapeClipper::Path points = shape->getPoints();
+			if (glutils::PolygonClipper::area(ShapeClipper::Paths(1, points)) < 0.0) {
+				std::reverse(points.begin(), points.end());
+			}
+			return points;
+		}
+
+	}
+
+	ShapeClipper::ShapeClipper(double resolution, int max_entries) : clipper(resolution) {
+		this->max_entries = max_entries;
+	}
+
+	/**
+	 * Return the outline of the shape snapped to the grid.
+	 */
+	const ShapeClipper::Paths& ShapeClipper::outline(const boost::shared_ptr<Shape>& shape) {
+		std::vector<long long> key;
+		key.push_back(OP_OUTLINE);
+		key.push_back(shape->getGeometryVersion());
+		const Paths* cached = find(key);
+		if (cached != NULL) return *cached;
+
+		Paths result;
+		clipper.execute(glutils::PolygonClipper::UNION, Paths(1, orientedOutline(shape)), Paths(), result);
+		return insert(key, result);
+	}
+
+	/**
+	 * Return the union of the shapes.
+	 */
+	const ShapeClipper::Paths& ShapeClipper::unite(const std::vector<boost::shared_ptr<Shape> >& shapes) {
+		std::vector<long long> key;
+		key.push_back(OP_UNION);
+		for (int i = 0; i < shapes.size(); ++i) {
+			key.push_back(shapes[i]->getGeometryVersion());
+		}
+		std::sort(key.begin() + 1, key.end());
+		const Paths* cached = find(key);
+		if (cached != NULL) return *cached;
+
+		Paths outlines;
+		for (int i = 0; i < shapes.size(); ++i) {
+			outlines.push_back(orientedOutline(shapes[i]));
+		}
+
+		Paths result;
+		clipper.execute(glutils::PolygonClipper::UNION, outlines, Paths(), result);
+		return insert(key, result);
+	}
+
+	/**
+	 * Return the intersection of the two shapes.
+	 */
+	const ShapeClipper::Paths& ShapeClipper::intersect(const boost::shared_ptr<Shape>& shape1, const boost::shared_ptr<Shape>& shape2) {
+		std::vector<long long> key;
+		key.push_back(OP_INTERSECTION);
+		key.push_back(std::min(shape1->getGeometryVersion(), shape2->getGeometryVersion()));
+		key.push_back(std::max(shape1->getGeometryVersion(), shape2->getGeometryVersion()));
+		const Paths* cached = find(key);
+		if (cached != NULL) return *cached;
+
+		Paths result;
+		clipper.execute(glutils::PolygonClipper::INTERSECTION, Paths(1, orientedOutline(shape1)), Paths(1, orientedOutline(shape2)), result);
+		return insert(key, result);
+	}
+
+	/**
+	 * Return the first shape minus the second shape.
+	 */
+	const ShapeClipper::Paths& ShapeClipper::subtract(const boost::shared_ptr<Shape>& shape1, const boost::shared_ptr<Shape>& shape2) {
+		std::vector<long long> key;
+		key.push_back(OP_DIFFERENCE);
+		key.push_back(shape1->getGeometryVersion());
+		key.push_back(shape2->getGeometryVersion());
+		const Paths* cached = find(key);
+		if (cached != NULL) return *cached;
+
+		Paths result;
+		clipper.execute(glutils::PolygonClipper::DIFFERENCE, Paths(1, orientedOutline(shape1)), Paths(1, orientedOutline(shape2)), result);
+		return insert(key, result);
+	}
+
+	/**
+	 * Return the outline of the shape offset by the distance, e.g., the clearance region around the shape.
+	 * The outline shrinks if the distance is negative.
+	 */
+	const ShapeClipper::Paths& ShapeClipper::offset(const boost::shared_ptr<Shape>& shape, double delta) {
+		std::vector<long long> key;
+		key.push_back(OP_OFFSET);
+		key.push_back(shape->getGeometryVersion());
+		key.push_back((long long)floor(delta / clipper.getResolution() + 0.5));
+		const Paths* cached = find(key);
+		if (cached != NULL) return *cached;
+
+		Paths result;
+		clipper.offset(Paths(1, orientedOutline(shape)), delta, result);
+		return insert(key, result);
+	}
+
+	void ShapeClipper::clear() {
+		cache.clear();
+	}
+
+	const ShapeClipper::Paths* ShapeClipper::find(const std::vector<long long>& key) const {
+		std::map<std::vector<long long>, Paths>::const_iterator it = cache.find(key);
+		if (it != cache.end()) return &it->second;
+		else return NULL;
+	}
+
+	/**
+	 * Store the result in the cache. The cache is flushed when it is full, since the results of the old versions
+	 * are never used again.
+	 */
+	const ShapeClipper::Paths& ShapeClipper::insert(const std::vector<long long>& key, Paths& paths) {
+		if ((int)cache.size() >= max_entries) cache.clear();
+
+		Paths& entry = cache[key];
+		entry.swap(paths);
+		return entry;
+	}
+
+}
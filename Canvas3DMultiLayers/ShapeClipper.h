@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <boost/shared_ptr.hpp>
+#include "Shape.h"
+#include "PolygonClipper.h"
+
+namespace canvas {
+
+	/**
+	 * Boolean operations and offsetting of the outlines of the shapes in the world coordinate system,
+	 * e.g., the clearance regions around the shapes and the merged outlines of the bodies.
+	 *
+	 * The results are cached by the geometry versions of the shapes, which change whenever the outline or the pose
+	 * of a shape changes, so that only the results involving the changed shapes are recomputed.
+	 * The returned references stay valid until the next call.
+	 */
+	class ShapeClipper {
+	public:
+		typedef glutils::PolygonClipper::Path Path;
+		typedef glutils::PolygonClipper::Paths Paths;
+
+	private:
+		static enum { OP_OUTLINE = 0, OP_UNION, OP_INTERSECTION, OP_DIFFERENCE, OP_OFFSET };
+
+		glutils::PolygonClipper clipper;
+		int max_entries;
+		std::map<std::vector<long long>, Paths> cache;
+
+	public:
+		ShapeClipper(double resolution = 1.0 / 1024.0, int max_entries = 1024);
+
+		const Paths& outline(const boost::shared_ptr<Shape>& shape);
+		const Paths& unite(const std::vector<boost::shared_ptr<Shape> >& shapes);
+		const Paths& intersect(const boost::shared_ptr<Shape>& shape1, const boost::shared_ptr<Shape>& shape2);
+		const Paths& subtract(const boost::shared_ptr<Shape>& shape1, const boost::shared_ptr<Shape>& shape2);
+		const Paths& offset(const boost::shared_ptr<Shape>& shape, double delta);
+		void clear();
+		int size() const { return cache.size(); }
+
+	private:
+		const Paths* find(const std::vector<long long>& key) const;
+		const Paths& insert(const std::vector<long long>& key, Paths& paths);
+	};
+
+}
@@ -0,0 +1,136 @@
+#include "StreamingBuffer.h"
+#include <QOpenGLContext>
+#include <string.h>
+
+typedef void (APIENTRY *BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+StreamingBuffer::StreamingBuffer() {
+	buffer = 0;
+	mapped = NULL;
+	regionSize = 0;
+	region = 0;
+	used = 0;
+	for (int i = 0; i < NUM_REGIONS; ++i) {
+		fences[i] = 0;
+	}
+	frame = 0;
+}
+
+StreamingBuffer::~StreamingBuffer() {
+	release();
+}
+
+/**
+ * Allocate and map the ring buffer.
+ * This has to be called after the OpenGL context is initialized.
+ *
+ * @param regionSize	size of the region used in a frame in bytes
+ * @return				false if the driver does not support GL_ARB_buffer_storage
+ */
+bool StreamingBuffer::init(GLsizeiptr regionSize) {
+	release();
+
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	if (context == NULL || !context->hasExtension("GL_ARB_buffer_storage")) return false;
+
+	BufferStorageProc bufferStorage = (BufferStorageProc)context->getProcAddress("glBufferStorage");
+	if (bufferStorage == NULL) return false;
+
+	this->regionSize = regionSize;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	bufferStorage(GL_ARRAY_BUFFER, regionSize * NUM_REGIONS, NULL, flags);
+	mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * NUM_REGIONS, flags);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (mapped == NULL) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Unmap and delete the ring buffer and the fences.
+ * The OpenGL context which the buffer was created in has to be current. If no context is current,
+ * the objects are just forgotten, since they are deleted together with the context.
+ */
+void StreamingBuffer::release() {
+	if (QOpenGLContext::currentContext() != NULL) {
+		for (int i = 0; i < NUM_REGIONS; ++i) {
+			if (fences[i] != 0) glDeleteSync(fences[i]);
+		}
+		if (buffer != 0) {
+			if (mapped != NULL) {
+				glBindBuffer(GL_ARRAY_BUFFER, buffer);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+
+	buffer = 0;
+	mapped = NULL;
+	region = 0;
+	used = 0;
+	for (int i = 0; i < NUM_REGIONS; ++i) {
+		fences[i] = 0;
+	}
+}
+
+bool StreamingBuffer::isAvailable() const {
+	return mapped != NULL;
+}
+
+/**
+ * Copy the data into the region of the current frame.
+ *
+ * @param data		data to be copied
+ * @param size		size of the data in bytes
+ * @param offset	[OUT] offset of the copied data in the buffer
+ * @return			false if the region does not have enough space left
+ */
+bool StreamingBuffer::write(const void* data, GLsizeiptr size, GLintptr& offset) {
+	if (mapped == NULL || used + size > regionSize) return false;
+
+	// wait until the GPU finishes drawing from this region in the previous round
+	if (used == 0 && fences[region] != 0) {
+		while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+
+	offset = regionSize * region + used;
+	memcpy(mapped + offset, data, size);
+
+	// keep the next data aligned for the vertex attributes
+	used += (size + 63) & ~(GLsizeiptr)63;
+
+	return true;
+}
+
+/**
+ * Fence the region of the current frame after the draw calls reading from it have been issued, and move on to the next region.
+ * Nothing happens if nothing was written in this frame.
+ */
+void StreamingBuffer::endFrame() {
+	if (used == 0) return;
+
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % NUM_REGIONS;
+	used = 0;
+	frame++;
+}
+
+/**
+ * Return the counter of the frames which wrote to the buffer.
+ * The data written in an earlier frame may be overwritten, so it has to be written again.
+ */
+unsigned int StreamingBuffer::currentFrame() const {
+	return frame;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "glew.h"
+
+// GL_ARB_buffer_storage is newer than the bundled GLEW
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT	0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT		0x0080
+#endif
+
+/**
+ * Ring buffer for the vertices which change every frame, such as the shapes being dragged.
+ * The buffer is allocated once by glBufferStorage and stays mapped, so the vertices are just copied into it
+ * without reallocating the GPU storage. It is divided into regions which are used in turn frame by frame,
+ * and a fence keeps the CPU from overwriting a region before the GPU has finished drawing from it.
+ */
+class StreamingBuffer {
+public:
+	static const int NUM_REGIONS = 3;
+
+	GLuint buffer;
+
+private:
+	char* mapped;
+	GLsizeiptr regionSize;
+	int region;
+	GLsizeiptr used;
+	GLsync fences[NUM_REGIONS];
+	unsigned int frame;
+
+public:
+	StreamingBuffer();
+	~StreamingBuffer();
+
+	bool init(GLsizeiptr regionSize);
+	void release();
+	bool isAvailable() const;
+	bool write(const void* data, GLsizeiptr size, GLintptr& offset);
+	void endFrame();
+	unsigned int currentFrame() const;
+};
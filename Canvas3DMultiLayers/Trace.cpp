@@ -0,0 +1,150 @@
+#include "Trace.h"
+#include <vector>
+#include <mutex>
+#include <QElapsedTimer>
+#include <QThreadStorage>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QCoreApplication>
+
+namespace {
+
+	struct TraceEvent {
+		const char* name;
+		qint64 start;
+		qint64 end;
+	};
+
+	/**
+	 * Ring buffer of the events recorded by a thread. The oldest events are overwritten when it is full.
+	 */
+	struct TraceBuffer {
+		int tid;
+		std::vector<TraceEvent> events;
+		int next;
+		bool full;
+	};
+
+	struct TraceClock {
+		QElapsedTimer timer;
+		TraceClock() { timer.start(); }
+	};
+
+	/**
+	 * QThreadStorage deletes the pointers it stores when the thread exits,
+	 * so the buffer is stored through this wrapper to keep it in trace_buffers.
+	 */
+	struct TraceBufferRef {
+		TraceBuffer* buffer;
+	};
+
+	TraceClock trace_clock;
+
+	// the buffers are owned by the list, so that the events of finished threads can still be dumped
+	std::mutex trace_mutex;
+	std::vector<TraceBuffer*> trace_buffers;
+	QThreadStorage<TraceBufferRef> trace_buffer;
+
+	TraceBuffer* currentBuffer() {
+		if (!trace_buffer.hasLocalData()) {
+			TraceBuffer* buffer = new TraceBuffer();
+			buffer->events.resize(Trace::BUFFER_SIZE);
+			buffer->next = 0;
+			buffer->full = false;
+
+			std::lock_guard<std::mutex> lock(trace_mutex);
+			buffer->tid = trace_buffers.size() + 1;
+			trace_buffers.push_back(buffer);
+
+			TraceBufferRef ref;
+			ref.buffer = buffer;
+			trace_buffer.setLocalData(ref);
+		}
+		return trace_buffer.localData().buffer;
+	}
+}
+
+/**
+ * Return the current time in nanoseconds.
+ */
+qint64 Trace::now() {
+	return trace_clock.timer.nsecsElapsed();
+}
+
+void Trace::record(const char* name, qint64 start, qint64 end) {
+	TraceBuffer* buffer = currentBuffer();
+
+	TraceEvent& event = buffer->events[buffer->next];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+
+	buffer->next++;
+	if (buffer->next >= buffer->events.size()) {
+		buffer->next = 0;
+		buffer->full = true;
+	}
+}
+
+/**
+ * Write the recorded events to the file in the Chrome trace event format.
+ * The events being recorded by other threads during the dump may be partially written,
+ * so call this function when the worker threads are idle.
+ */
+bool Trace::dump(const QString& filename) {
+	QJsonArray events;
+
+	QJsonObject process_name;
+	process_name["name"] = QString("process_name");
+	process_name["ph"] = QString("M");
+	process_name["pid"] = (qint64)QCoreApplication::applicationPid();
+	QJsonObject args;
+	args["name"] = QString("Canvas3DMultiLayers");
+	process_name["args"] = args;
+	events.append(process_name);
+
+	{
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		for (int i = 0; i < trace_buffers.size(); ++i) {
+			TraceBuffer* buffer = trace_buffers[i];
+			int count = buffer->full ? buffer->events.size() : buffer->next;
+			int first = buffer->full ? buffer->next : 0;
+			for (int k = 0; k < count; ++k) {
+				const TraceEvent& event = buffer->events[(first + k) % buffer->events.size()];
+
+				// the timestamps of the Chrome trace event format are in microseconds
+				QJsonObject obj;
+				obj["name"] = QString(event.name);
+				obj["ph"] = QString("X");
+				obj["ts"] = event.start * 0.001;
+				obj["dur"] = (event.end - event.start) * 0.001;
+				obj["pid"] = (qint64)QCoreApplication::applicationPid();
+				obj["tid"] = buffer->tid;
+				events.append(obj);
+			}
+		}
+	}
+
+	QJsonObject root;
+	root["traceEvents"] = events;
+	root["displayTimeUnit"] = QString("ms");
+
+	QFile file(filename);
+	if (!file.open(QFile::WriteOnly)) return false;
+	file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+
+	return true;
+}
+
+/**
+ * Discard all the recorded events.
+ */
+void Trace::clear() {
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	for (int i = 0; i < trace_buffers.size(); ++i) {
+		trace_buffers[i]->next = 0;
+		trace_buffers[i]->full = false;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * Low-overhead scoped tracing of the interaction pipeline.
+ * Each thread records the begin time and the duration of the traced scopes into its own ring buffer,
+ * so that recording a scope does not take any lock. The recorded events can be dumped as a Chrome
+ * trace event JSON file, which can be opened by chrome://tracing or Perfetto.
+ *
+ * The tracing is enabled at compile time by defining CANVAS_TRACE in the preprocessor definitions of the build.
+ * Without it, TRACE_SCOPE expands to nothing and F5 does not dump the events, so the release build pays no cost.
+ * There is no switch at run time: once compiled in, the traced scopes are always recorded.
+ *
+ * Usage:
+ *     void RenderManager::render(...) {
+ *         TRACE_SCOPE("RenderManager::render");
+ *         ...
+ *     }
+ */
+class Trace {
+public:
+	static const int BUFFER_SIZE = 65536;
+
+public:
+	static qint64 now();
+	static void record(const char* name, qint64 start, qint64 end);
+	static bool dump(const QString& filename);
+	static void clear();
+};
+
+/**
+ * Record the time from its construction to its destruction as an event.
+ * The name has to be a string literal, because only the pointer is stored.
+ */
+class TraceScope {
+private:
+	const char* name;
+	qint64 start;
+
+public:
+	TraceScope(const char* name) : name(name), start(Trace::now()) {}
+	~TraceScope() { Trace::record(name, start, Trace::now()); }
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef CANVAS_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,697 @@
+#include "Triangulator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace glutils {
+
+	Triangulator::Triangulator() {
+		indices = NULL;
+		minX = 0.0;
+		minY = 0.0;
+		invSize = 0.0;
+	}
+
+	/**
+	 * Triangulate the polygon.
+	 * The indices of the triangles refer to the points of the outline, and the triangles are counter clockwise
+	 * regardless of the orientation of the outline.
+	 * Return false if no triangle is generated.
+	 */
+	bool Triangulator::triangulate(const std::vector<glm::vec2>& outline, std::vector<unsigned int>& indices) {
+		return triangulate(outline, std::vector<std::vector<glm::vec2> >(), indices);
+	}
+
+	/**
+	 * Triangulate the polygon with holes.
+	 * The indices of the triangles refer to the points of the outline followed by the points of the holes in order.
+	 * The triangles are counter clockwise regardless of the orientation of the outline and the holes.
+	 * Return false if no triangle is generated.
+	 */
+	bool Triangulator::triangulate(const std::vector<glm::vec2>& outline, const std::vector<std::vector<glm::vec2> >& holes, std::vector<unsigned int>& indices) {
+		indices.clear();
+		if (outline.size() < 3) return false;
+
+		// the pool of the nodes is never reallocated because the pointers between them have to stay valid
+		// (each bridge to a hole and each split adds two nodes, and there are at most as many splits as vertices),
+		// and createNode() stops the triangulation if the pool is exhausted anyway
+		int num_points = outline.size();
+		for (int i = 0; i < holes.size(); ++i) {
+			num_points += holes[i].size();
+		}
+		nodes.clear();
+		nodes.reserve(num_points * 3 + holes.size() * 2);
+		indices.reserve((num_points + holes.size() * 2) * 3);
+		this->indices = &indices;
+
+		try {
+			earcut(outline, holes, num_points);
+		}
+		catch (const char*) {
+			indices.clear();
+		}
+
+		this->indices = NULL;
+		return !indices.empty();
+	}
+
+	/**
+	 * Link the outline and the holes, and clip the ears.
+	 */
+	void Triangulator::earcut(const std::vector<glm::vec2>& outline, const std::vector<std::vector<glm::vec2> >& holes, int num_points) {
+		Node* outerNode = linkedList(outline, 0, true);
+		if (outerNode == NULL || outerNode->next == outerNode->prev) return;
+
+		if (!holes.empty()) {
+			outerNode = eliminateHoles(holes, outline.size(), outerNode);
+		}
+
+		// hash the vertices of large polygons in z-order
+		invSize = 0.0;
+		if (num_points > 80) {
+			double maxX = outline[0].x;
+			double maxY = outline[0].y;
+			minX = maxX;
+			minY = maxY;
+			for (int i = 1; i < outline.size(); ++i) {
+				minX = std::min(minX, (double)outline[i].x);
+				minY = std::min(minY, (double)outline[i].y);
+				maxX = std::max(maxX, (double)outline[i].x);
+				maxY = std::max(maxY, (double)outline[i].y);
+			}
+
+			// the coordinates are quantized to 15 bits
+			invSize = std::max(maxX - minX, maxY - minY);
+			invSize = invSize != 0.0 ? 32767.0 / invSize : 0.0;
+		}
+
+		earcutLinked(outerNode);
+	}
+
+	/**
+	 * Create a circular doubly linked list of the points in the specified winding order.
+	 * The indices of the nodes start from start.
+	 */
+	Triangulator::Node* Triangulator::linkedList(const std::vector<glm::vec2>& points, int start, bool clockwise) {
+		double sum = 0.0;
+		for (int i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+			sum += ((double)points[j].x - points[i].x) * ((double)points[i].y + points[j].y);
+		}
+
+		Node* last = NULL;
+		if (clockwise == (sum > 0)) {
+			for (int i = 0; i < points.size(); ++i) {
+				last = insertNode(start + i, points[i], last);
+			}
+		}
+		else {
+			for (int i = points.size() - 1; i >= 0; --i) {
+				last = insertNode(start + i, points[i], last);
+			}
+		}
+
+		if (last != NULL && equals(last, last->next)) {
+			removeNode(last);
+			last = last->next;
+		}
+
+		return last;
+	}
+
+	/**
+	 * Remove the duplicate and collinear points.
+	 */
+	Triangulator::Node* Triangulator::filterPoints(Node* start, Node* end) {
+		if (start == NULL) return start;
+		if (end == NULL) end = start;
+
+		Node* p = start;
+		bool again;
+		do {
+			again = false;
+
+			if (!p->steiner && (equals(p, p->next) || area(p->prev, p, p->next) == 0.0)) {
+				removeNode(p);
+				p = end = p->prev;
+
+				if (p == p->next) break;
+				again = true;
+			}
+			else {
+				p = p->next;
+			}
+		} while (again || p != end);
+
+		return end;
+	}
+
+	/**
+	 * Clip the ears of the polygon.
+	 * When no ear is found, the duplicate points are removed (pass 1), the local self-intersections are cured (pass 2),
+	 * and finally, the polygon is split into two along a valid diagonal.
+	 */
+	void Triangulator::earcutLinked(Node* ear, int pass) {
+		if (ear == NULL) return;
+
+		if (pass == 0 && invSize != 0.0) {
+			indexCurve(ear);
+		}
+
+		Node* stop = ear;
+		while (ear->prev != ear->next) {
+			Node* prev = ear->prev;
+			Node* next = ear->next;
+
+			if (invSize != 0.0 ? isEarHashed(ear) : isEar(ear)) {
+				addTriangle(prev, ear, next);
+				removeNode(ear);
+
+				// skipping the next vertex leads to less sliver triangles
+				ear = next->next;
+				stop = next->next;
+				continue;
+			}
+
+			ear = next;
+
+			// if we looped through the whole remaining polygon and can't find any more ears
+			if (ear == stop) {
+				if (pass == 0) {
+					earcutLinked(filterPoints(ear), 1);
+				}
+				else if (pass == 1) {
+					ear = cureLocalIntersections(filterPoints(ear));
+					earcutLinked(ear, 2);
+				}
+				else if (pass == 2) {
+					splitEarcut(ear);
+				}
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Check whether the polygon node forms a valid ear with its adjacent nodes.
+	 */
+	bool Triangulator::isEar(Node* ear) {
+		const Node* a = ear->prev;
+		const Node* b = ear;
+		const Node* c = ear->next;
+
+		// reflex
+		if (area(a, b, c) >= 0.0) return false;
+
+		// no other point is inside the ear
+		Node* p = ear->next->next;
+		while (p != ear->prev) {
+			if (pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && area(p->prev, p, p->next) >= 0.0) return false;
+			p = p->next;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Check whether the polygon node forms a valid ear by testing only the nodes whose z-order is within the bounding box of the ear.
+	 */
+	bool Triangulator::isEarHashed(Node* ear) {
+		const Node* a = ear->prev;
+		const Node* b = ear;
+		const Node* c = ear->next;
+
+		// reflex
+		if (area(a, b, c) >= 0.0) return false;
+
+		// z-order range of the bounding box of the ear
+		int minZ = zOrder(std::min(a->x, std::min(b->x, c->x)), std::min(a->y, std::min(b->y, c->y)));
+		int maxZ = zOrder(std::max(a->x, std::max(b->x, c->x)), std::max(a->y, std::max(b->y, c->y)));
+
+		// look for points inside the ear in both directions of the z-order
+		Node* p = ear->prevZ;
+		Node* n = ear->nextZ;
+		while (p != NULL && p->z >= minZ && n != NULL && n->z <= maxZ) {
+			if (p != ear->prev && p != ear->next && pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && area(p->prev, p, p->next) >= 0.0) return false;
+			p = p->prevZ;
+
+			if (n != ear->prev && n != ear->next && pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) && area(n->prev, n, n->next) >= 0.0) return false;
+			n = n->nextZ;
+		}
+
+		while (p != NULL && p->z >= minZ) {
+			if (p != ear->prev && p != ear->next && pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && area(p->prev, p, p->next) >= 0.0) return false;
+			p = p->prevZ;
+		}
+
+		while (n != NULL && n->z <= maxZ) {
+			if (n != ear->prev && n != ear->next && pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) && area(n->prev, n, n->next) >= 0.0) return false;
+			n = n->nextZ;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Clip the triangles at the local self-intersections of the polygon.
+	 */
+	Triangulator::Node* Triangulator::cureLocalIntersections(Node* start) {
+		Node* p = start;
+		do {
+			Node* a = p->prev;
+			Node* b = p->next->next;
+
+			if (!equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a)) {
+				addTriangle(a, p, b);
+
+				// remove two nodes involved
+				removeNode(p);
+				removeNode(p->next);
+
+				p = start = b;
+			}
+			p = p->next;
+		} while (p != start);
+
+		return filterPoints(p);
+	}
+
+	/**
+	 * Split the polygon into two along a valid diagonal, and triangulate them separately.
+	 */
+	void Triangulator::splitEarcut(Node* start) {
+		Node* a = start;
+		do {
+			Node* b = a->next->next;
+			while (b != a->prev) {
+				if (a->i != b->i && isValidDiagonal(a, b)) {
+					Node* c = splitPolygon(a, b);
+
+					a = filterPoints(a, a->next);
+					c = filterPoints(c, c->next);
+
+					earcutLinked(a);
+					earcutLinked(c);
+					return;
+				}
+				b = b->next;
+			}
+			a = a->next;
+		} while (a != start);
+	}
+
+	/**
+	 * Link every hole into the outline to form a single ring.
+	 * The holes are processed from left to right.
+	 */
+	Triangulator::Node* Triangulator::eliminateHoles(const std::vector<std::vector<glm::vec2> >& holes, int start, Node* outerNode) {
+		std::vector<Node*> queue;
+		for (int i = 0; i < holes.size(); ++i) {
+			Node* list = linkedList(holes[i], start, false);
+			start += holes[i].size();
+			if (list == NULL) continue;
+
+			if (list == list->next) list->steiner = true;
+			queue.push_back(getLeftmost(list));
+		}
+
+		std::sort(queue.begin(), queue.end(), [](const Node* a, const Node* b) {
+			return a->x < b->x;
+		});
+
+		for (int i = 0; i < queue.size(); ++i) {
+			outerNode = eliminateHole(queue[i], outerNode);
+		}
+
+		return outerNode;
+	}
+
+	/**
+	 * Find a bridge between the vertices that connects the hole with the outline, and link it.
+	 */
+	Triangulator::Node* Triangulator::eliminateHole(Node* hole, Node* outerNode) {
+		Node* bridge = findHoleBridge(hole, outerNode);
+		if (bridge == NULL) return outerNode;
+
+		Node* bridgeReverse = splitPolygon(bridge, hole);
+
+		// filter the collinear points around the cuts
+		filterPoints(bridgeReverse, bridgeReverse->next);
+		return filterPoints(bridge, bridge->next);
+	}
+
+	/**
+	 * Find the vertex of the outline which can be connected to the leftmost vertex of the hole by David Eberly's algorithm.
+	 */
+	Triangulator::Node* Triangulator::findHoleBridge(Node* hole, Node* outerNode) {
+		Node* p = outerNode;
+		double hx = hole->x;
+		double hy = hole->y;
+		double qx = -(std::numeric_limits<double>::max)();
+		Node* m = NULL;
+
+		// find a segment intersected by a ray from the hole's leftmost point to the left;
+		// segment's endpoint with lesser x will be potential connection point
+		do {
+			if (hy <= p->y && hy >= p->next->y && p->next->y != p->y) {
+				double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+				if (x <= hx && x > qx) {
+					qx = x;
+					m = p->x < p->next->x ? p : p->next;
+					if (x == hx) return m;
+				}
+			}
+			p = p->next;
+		} while (p != outerNode);
+
+		if (m == NULL) return NULL;
+
+		// look for points inside the triangle of hole point, segment intersection and endpoint;
+		// if there are no points found, we have a valid connection;
+		// otherwise choose the point of the minimum angle with the ray as connection point
+		const Node* stop = m;
+		double mx = m->x;
+		double my = m->y;
+		double tanMin = (std::numeric_limits<double>::max)();
+		p = m;
+		do {
+			if (hx >= p->x && p->x >= mx && hx != p->x && pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y)) {
+				double tan = std::abs(hy - p->y) / (hx - p->x);
+
+				if (locallyInside(p, hole) && (tan < tanMin || (tan == tanMin && (p->x > m->x || sectorContainsSector(m, p))))) {
+					m = p;
+					tanMin = tan;
+				}
+			}
+			p = p->next;
+		} while (p != stop);
+
+		return m;
+	}
+
+	/**
+	 * Check whether the sector in vertex m contains the sector in vertex p in the same coordinates.
+	 */
+	bool Triangulator::sectorContainsSector(const Node* m, const Node* p) {
+		return area(m->prev, m, p->prev) < 0.0 && area(p->next, m, m->next) < 0.0;
+	}
+
+	/**
+	 * Link the nodes in z-order.
+	 */
+	void Triangulator::indexCurve(Node* start) {
+		Node* p = start;
+		do {
+			p->z = p->z != 0 ? p->z : zOrder(p->x, p->y);
+			p->prevZ = p->prev;
+			p->nextZ = p->next;
+			p = p->next;
+		} while (p != start);
+
+		p->prevZ->nextZ = NULL;
+		p->prevZ = NULL;
+
+		sortLinked(p);
+	}
+
+	/**
+	 * Sort the linked list in z-order by Simon Tatham's merge sort.
+	 */
+	Triangulator::Node* Triangulator::sortLinked(Node* list) {
+		int inSize = 1;
+		int numMerges;
+		do {
+			Node* p = list;
+			list = NULL;
+			Node* tail = NULL;
+			numMerges = 0;
+
+			while (p != NULL) {
+				numMerges++;
+				Node* q = p;
+				int pSize = 0;
+				for (int i = 0; i < inSize; i++) {
+					pSize++;
+					q = q->nextZ;
+					if (q == NULL) break;
+				}
+
+				int qSize = inSize;
+				while (pSize > 0 || (qSize > 0 && q != NULL)) {
+					Node* e;
+					if (pSize != 0 && (qSize == 0 || q == NULL || p->z <= q->z)) {
+						e = p;
+						p = p->nextZ;
+						pSize--;
+					}
+					else {
+						e = q;
+						q = q->nextZ;
+						qSize--;
+					}
+
+					if (tail != NULL) tail->nextZ = e;
+					else list = e;
+
+					e->prevZ = tail;
+					tail = e;
+				}
+
+				p = q;
+			}
+
+			tail->nextZ = NULL;
+			inSize *= 2;
+		} while (numMerges > 1);
+
+		return list;
+	}
+
+	/**
+	 * Return the z-order (Morton code) of the point, whose coordinates are quantized to 15 bits.
+	 */
+	int Triangulator::zOrder(double x, double y) {
+		int ix = (int)((x - minX) * invSize);
+		int iy = (int)((y - minY) * invSize);
+
+		ix = (ix | (ix << 8)) & 0x00FF00FF;
+		ix = (ix | (ix << 4)) & 0x0F0F0F0F;
+		ix = (ix | (ix << 2)) & 0x33333333;
+		ix = (ix | (ix << 1)) & 0x55555555;
+
+		iy = (iy | (iy << 8)) & 0x00FF00FF;
+		iy = (iy | (iy << 4)) & 0x0F0F0F0F;
+		iy = (iy | (iy << 2)) & 0x33333333;
+		iy = (iy | (iy << 1)) & 0x55555555;
+
+		return ix | (iy << 1);
+	}
+
+	/**
+	 * Return the leftmost node of the polygon ring.
+	 */
+	Triangulator::Node* Triangulator::getLeftmost(Node* start) {
+		Node* p = start;
+		Node* leftmost = start;
+		do {
+			if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y)) {
+				leftmost = p;
+			}
+			p = p->next;
+		} while (p != start);
+
+		return leftmost;
+	}
+
+	/**
+	 * Check whether the diagonal from a to b is inside the polygon and does not intersect its edges.
+	 */
+	bool Triangulator::isValidDiagonal(Node* a, Node* b) {
+		// doesn't intersect other edges
+		if (a->next->i == b->i || a->prev->i == b->i || intersectsPolygon(a, b)) return false;
+
+		// locally visible, and does not create opposite-facing sectors
+		if (locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b) && (area(a->prev, a, b->prev) != 0.0 || area(a, b->prev, b) != 0.0)) return true;
+
+		// special zero-length case
+		return equals(a, b) && area(a->prev, a, a->next) > 0.0 && area(b->prev, b, b->next) > 0.0;
+	}
+
+	/**
+	 * Check whether the diagonal from a to b intersects any edge of the polygon.
+	 */
+	bool Triangulator::intersectsPolygon(const Node* a, const Node* b) {
+		const Node* p = a;
+		do {
+			if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i && intersects(p, p->next, a, b)) return true;
+			p = p->next;
+		} while (p != a);
+
+		return false;
+	}
+
+	/**
+	 * Check whether the diagonal from a to b is locally inside the polygon at a.
+	 */
+	bool Triangulator::locallyInside(const Node* a, const Node* b) {
+		if (area(a->prev, a, a->next) < 0.0) {
+			return area(a, b, a->next) >= 0.0 && area(a, a->prev, b) >= 0.0;
+		}
+		else {
+			return area(a, b, a->prev) < 0.0 || area(a, a->next, b) < 0.0;
+		}
+	}
+
+	/**
+	 * Check whether the middle point of the diagonal from a to b is inside the polygon.
+	 */
+	bool Triangulator::middleInside(const Node* a, const Node* b) {
+		const Node* p = a;
+		bool inside = false;
+		double px = (a->x + b->x) * 0.5;
+		double py = (a->y + b->y) * 0.5;
+		do {
+			if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y && (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x)) {
+				inside = !inside;
+			}
+			p = p->next;
+		} while (p != a);
+
+		return inside;
+	}
+
+	/**
+	 * Link two polygon vertices with a bridge.
+	 * If the vertices belong to the same ring, it splits the polygon into two,
+	 * and if one belongs to the outline and another to a hole, it merges them into a single ring.
+	 */
+	Triangulator::Node* Triangulator::splitPolygon(Node* a, Node* b) {
+		Node* a2 = createNode(a->i, a->x, a->y);
+		Node* b2 = createNode(b->i, b->x, b->y);
+		Node* an = a->next;
+		Node* bp = b->prev;
+
+		a->next = b;
+		b->prev = a;
+
+		a2->next = an;
+		an->prev = a2;
+
+		b2->next = a2;
+		a2->prev = b2;
+
+		bp->next = b2;
+		b2->prev = bp;
+
+		return b2;
+	}
+
+	/**
+	 * Create a node and insert it after the last node of the ring.
+	 */
+	Triangulator::Node* Triangulator::insertNode(int i, const glm::vec2& pt, Node* last) {
+		Node* p = createNode(i, pt.x, pt.y);
+
+		if (last == NULL) {
+			p->prev = p;
+			p->next = p;
+		}
+		else {
+			p->next = last->next;
+			p->prev = last;
+			last->next->prev = p;
+			last->next = p;
+		}
+
+		return p;
+	}
+
+	Triangulator::Node* Triangulator::createNode(int i, double x, double y) {
+		// the pool must not be reallocated, which would invalidate all the pointers to the nodes
+		if (nodes.size() == nodes.capacity()) throw "The node pool is exhausted.";
+
+		Node node;
+		node.i = i;
+		node.x = x;
+		node.y = y;
+		node.prev = NULL;
+		node.next = NULL;
+		node.z = 0;
+		node.prevZ = NULL;
+		node.nextZ = NULL;
+		node.steiner = false;
+		nodes.push_back(node);
+
+		return &nodes.back();
+	}
+
+	void Triangulator::removeNode(Node* p) {
+		p->next->prev = p->prev;
+		p->prev->next = p->next;
+
+		if (p->prevZ != NULL) p->prevZ->nextZ = p->nextZ;
+		if (p->nextZ != NULL) p->nextZ->prevZ = p->prevZ;
+	}
+
+	/**
+	 * Output the triangle in the counter clockwise order.
+	 */
+	void Triangulator::addTriangle(const Node* a, const Node* b, const Node* c) {
+		indices->push_back(a->i);
+		indices->push_back(b->i);
+		indices->push_back(c->i);
+	}
+
+	/**
+	 * Return the signed area of the triangle, which is negative if the triangle is counter clockwise.
+	 * The coordinates come from floats, so the differences are exact unless the magnitudes of the coordinates are far
+	 * apart, but the products and the final subtraction are rounded in general. The sign may thus be wrong for nearly
+	 * collinear points, which filterPoints() and cureLocalIntersections() tolerate.
+	 */
+	double Triangulator::area(const Node* p, const Node* q, const Node* r) {
+		return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+	}
+
+	bool Triangulator::equals(const Node* p1, const Node* p2) {
+		return p1->x == p2->x && p1->y == p2->y;
+	}
+
+	/**
+	 * Check whether the point is inside the triangle.
+	 */
+	bool Triangulator::pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py) {
+		return (cx - px) * (ay - py) >= (ax - px) * (cy - py) && (ax - px) * (by - py) >= (bx - px) * (ay - py) && (bx - px) * (cy - py) >= (cx - px) * (by - py);
+	}
+
+	/**
+	 * Check whether the segments p1-q1 and p2-q2 intersect.
+	 */
+	bool Triangulator::intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2) {
+		int o1 = sign(area(p1, q1, p2));
+		int o2 = sign(area(p1, q1, q2));
+		int o3 = sign(area(p2, q2, p1));
+		int o4 = sign(area(p2, q2, q1));
+
+		// general case
+		if (o1 != o2 && o3 != o4) return true;
+
+		// collinear cases
+		if (o1 == 0 && onSegment(p1, p2, q1)) return true;
+		if (o2 == 0 && onSegment(p1, q2, q1)) return true;
+		if (o3 == 0 && onSegment(p2, p1, q2)) return true;
+		if (o4 == 0 && onSegment(p2, q1, q2)) return true;
+
+		return false;
+	}
+
+	/**
+	 * Check whether the point q lies on the segment p-r, given that they are collinear.
+	 */
+	bool Triangulator::onSegment(const Node* p, const Node* q, const Node* r) {
+		return q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) && q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+	}
+
+	int Triangulator::sign(double val) {
+		return (0.0 < val) - (val < 0.0);
+	}
+
+}
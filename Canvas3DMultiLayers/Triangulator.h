@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace glutils {
+
+	/**
+	 * Triangulate a simple polygon with holes by ear clipping.
+	 *
+	 * The vertices are kept in a circular doubly linked list whose nodes are allocated from a single pool,
+	 * and the ears are clipped in the order of the list. For large polygons, the nodes are also linked in
+	 * z-order (Morton code of the quantized position) so that only the vertices near the candidate ear have to
+	 * be tested against it. The holes are bridged to the outline before clipping.
+	 * If the polygon is degenerate or slightly self-intersecting, the local intersections are cured and the
+	 * remaining polygon is split along a valid diagonal, so that some triangulation is always produced.
+	 *
+	 * The orientation tests are computed in double precision from float coordinates, so they are much more accurate
+	 * than in float, but they are not exact: the sign of the determinant may be wrong for nearly collinear points.
+	 */
+	class Triangulator {
+	private:
+		struct Node {
+			int i;
+			double x;
+			double y;
+			Node* prev;
+			Node* next;
+			int z;
+			Node* prevZ;
+			Node* nextZ;
+			bool steiner;
+		};
+
+		std::vector<Node> nodes;
+		std::vector<unsigned int>* indices;
+		double minX;
+		double minY;
+		double invSize;
+
+	public:
+		Triangulator();
+
+		bool triangulate(const std::vector<glm::vec2>& outline, std::vector<unsigned int>& indices);
+		bool triangulate(const std::vector<glm::vec2>& outline, const std::vector<std::vector<glm::vec2> >& holes, std::vector<unsigned int>& indices);
+
+	private:
+		void earcut(const std::vector<glm::vec2>& outline, const std::vector<std::vector<glm::vec2> >& holes, int num_points);
+		Node* linkedList(const std::vector<glm::vec2>& points, int start, bool clockwise);
+		Node* filterPoints(Node* start, Node* end = NULL);
+		void earcutLinked(Node* ear, int pass = 0);
+		bool isEar(Node* ear);
+		bool isEarHashed(Node* ear);
+		Node* cureLocalIntersections(Node* start);
+		void splitEarcut(Node* start);
+		Node* eliminateHoles(const std::vector<std::vector<glm::vec2> >& holes, int start, Node* outerNode);
+		Node* eliminateHole(Node* hole, Node* outerNode);
+		Node* findHoleBridge(Node* hole, Node* outerNode);
+		bool sectorContainsSector(const Node* m, const Node* p);
+		void indexCurve(Node* start);
+		Node* sortLinked(Node* list);
+		int zOrder(double x, double y);
+		Node* getLeftmost(Node* start);
+		bool isValidDiagonal(Node* a, Node* b);
+		bool intersectsPolygon(const Node* a, const Node* b);
+		bool locallyInside(const Node* a, const Node* b);
+		bool middleInside(const Node* a, const Node* b);
+		Node* splitPolygon(Node* a, Node* b);
+		Node* insertNode(int i, const glm::vec2& pt, Node* last);
+		Node* createNode(int i, double x, double y);
+		void removeNode(Node* p);
+		void addTriangle(const Node* a, const Node* b, const Node* c);
+
+		static double area(const Node* p, const Node* q, const Node* r);
+		static bool equals(const Node* p1, const Node* p2);
+		static bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py);
+		static bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2);
+		static bool onSegment(const Node* p, const Node* q, const Node* r);
+		static int sign(double val);
+	};
+
+}
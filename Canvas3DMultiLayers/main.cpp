@@ -1,9 +1,31 @@
 #include "MainWindow.h"
 #include <QtWidgets/QApplication>
+#include "BatchRenderer.h"
+#include "Benchmark.h"
+#include "DesignConverter.h"
 
 int main(int argc, char *argv[])
 {	
 	QApplication a(argc, argv);
+
+	// render the design files into images without showing the window
+	if (a.arguments().contains("--render")) {
+		BatchRenderer renderer;
+		return renderer.run(a.arguments());
+	}
+
+	// measure the editing operations over the design files
+	if (a.arguments().contains("--benchmark")) {
+		Benchmark benchmark;
+		return benchmark.run(a.arguments());
+	}
+
+	// convert the design files between the XML and the binary formats
+	if (a.arguments().contains("--convert")) {
+		DesignConverter converter;
+		return converter.run(a.arguments());
+	}
+
 	MainWindow w;
 	w.show();
 	return a.exec();
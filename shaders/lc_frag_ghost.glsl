@@ -0,0 +1,18 @@
+#version 420
+
+in vec4 outColor;
+in vec3 varyingNormal;
+
+layout(location = 0)out vec4 outputF;
+
+uniform vec3 lightDir;
+uniform sampler2D depthTex;	// depth of the solid layer
+uniform vec2 pixelSize;
+
+void main(){
+	// hide the ghosts behind the solid shapes
+	if (gl_FragCoord.z > texture(depthTex, gl_FragCoord.xy * pixelSize).r) discard;
+
+	float intensity = 0.6 + 0.5 * max(0.0, dot(-lightDir, normalize(varyingNormal)));
+	outputF = vec4(outColor.rgb * intensity, outColor.a);
+}
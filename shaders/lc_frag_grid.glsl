@@ -0,0 +1,26 @@
+#version 420
+
+in vec2 outUV;
+
+layout(location = 0)out vec4 outputF;
+
+uniform vec2 viewportSize;	// in pixels
+uniform vec2 offset;		// screen position of a grid intersection in pixels (top-left origin)
+uniform float cellSize;		// distance between the grid lines in pixels
+uniform vec4 lineColor;
+
+void main(){
+	// the screen y axis points downward while gl_FragCoord's points upward
+	vec2 screenPos = vec2(gl_FragCoord.x, viewportSize.y - gl_FragCoord.y);
+
+	// distance to the nearest grid line in pixels
+	// (computed relative to the grid cell so that the precision does not degrade when panning far away)
+	vec2 d = abs(fract((screenPos - offset) / cellSize + 0.5) - 0.5) * cellSize;
+	float dist = min(d.x, d.y);
+
+	// one pixel wide line with a smooth falloff
+	float alpha = 1.0 - clamp(dist - 0.5, 0.0, 1.0);
+	if (alpha <= 0.0) discard;
+
+	outputF = vec4(lineColor.rgb, lineColor.a * alpha);
+}
@@ -0,0 +1,13 @@
+#version 420
+
+in vec4 outColor;
+in vec2 outUV;
+in float outTextured;
+
+layout(location = 0)out vec4 outputF;
+
+uniform sampler2D tex0;		// rotation marker
+
+void main(){
+	outputF = outColor * mix(vec4(1.0), texture(tex0, outUV), outTextured);
+}
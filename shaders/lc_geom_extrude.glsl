@@ -0,0 +1,54 @@
+#version 420
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 6) out;
+
+out vec4 outColor;
+out vec2 outUV;
+out vec3 origVertex;
+out vec3 varyingNormal;
+
+// mvpMatrix of the camera, or light_mvpMatrix for the shadow map
+uniform mat4 mvpMatrix;
+uniform mat4 modelMatrix;
+uniform float zBottom;
+uniform float zTop;
+uniform vec4 color;
+
+void emitVertex(vec2 p, float z, vec3 normal){
+	outColor = color;
+	outUV = vec2(0, 0);
+	origVertex = (modelMatrix * vec4(p, z, 1.0)).xyz;
+	varyingNormal = mat3(modelMatrix) * normal;
+	gl_Position = mvpMatrix * vec4(origVertex, 1.0);
+	EmitVertex();
+}
+
+void main(){
+	vec2 p0 = gl_in[0].gl_Position.xy;
+	vec2 p1 = gl_in[1].gl_Position.xy;
+	vec2 p2 = gl_in[2].gl_Position.xy;
+
+	if (gl_in[0].gl_Position.z < 0.5) {
+		// top face
+		emitVertex(p0, zTop, vec3(0, 0, 1));
+		emitVertex(p1, zTop, vec3(0, 0, 1));
+		emitVertex(p2, zTop, vec3(0, 0, 1));
+		EndPrimitive();
+
+		// bottom face
+		emitVertex(p0, zBottom, vec3(0, 0, -1));
+		emitVertex(p2, zBottom, vec3(0, 0, -1));
+		emitVertex(p1, zBottom, vec3(0, 0, -1));
+		EndPrimitive();
+	}
+	else {
+		// side face of the edge from p0 to p1
+		vec3 n = normalize(vec3(p1.y - p0.y, p0.x - p1.x, 0));
+		emitVertex(p0, zBottom, n);
+		emitVertex(p1, zBottom, n);
+		emitVertex(p0, zTop, n);
+		emitVertex(p1, zTop, n);
+		EndPrimitive();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#version 420
+
+// (x, y, 0) for the vertices of the cap triangles, or (x, y, 1) for the side edges
+layout(location = 0)in vec3 vertex;
+
+void main(){
+	gl_Position = vec4(vertex, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 420
+
+layout(location = 0)in vec3 vertex;
+layout(location = 1)in vec3 normal;
+layout(location = 2)in vec4 color;
+layout(location = 3)in vec2 uv;
+layout(location = 5)in mat4 instanceMatrix;	// pose of the shape in the ghost layer relative to the mesh
+layout(location = 9)in vec4 instanceColor;
+
+out vec4 outColor;
+out vec3 varyingNormal;
+
+uniform mat4 mvpMatrix;
+
+void main(){
+	outColor=instanceColor;
+	varyingNormal=mat3(instanceMatrix) * normal;
+
+	gl_Position = mvpMatrix * instanceMatrix * vec4(vertex, 1.0);
+}
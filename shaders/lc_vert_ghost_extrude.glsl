@@ -0,0 +1,15 @@
+#version 420
+
+// (x, y, 0) for the vertices of the cap triangles, or (x, y, 1) for the side edges
+layout(location = 0)in vec3 vertex;
+layout(location = 5)in mat4 instanceMatrix;	// pose of the shape in the ghost layer
+layout(location = 9)in vec4 instanceColor;
+
+out mat4 ghostMatrix;
+out vec4 ghostColor;
+
+void main(){
+	ghostMatrix = instanceMatrix;
+	ghostColor = instanceColor;
+	gl_Position = vec4(vertex, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 420
+
+layout(location = 0)in vec2 vertex;	// in pixels (top-left origin)
+layout(location = 1)in vec4 color;
+layout(location = 2)in vec2 uv;
+layout(location = 3)in float textured;
+
+out vec4 outColor;
+out vec2 outUV;
+out float outTextured;
+
+uniform vec2 viewportSize;	// in pixels
+
+void main(){
+	outColor=color;
+	outUV=uv;
+	outTextured=textured;
+
+	gl_Position = vec4(vertex.x / viewportSize.x * 2.0 - 1.0, 1.0 - vertex.y / viewportSize.y * 2.0, 0, 1.0);
+}
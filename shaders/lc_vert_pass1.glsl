@@ -11,12 +11,13 @@ out vec3 origVertex;
 out vec3 varyingNormal;
 
 uniform mat4 mvpMatrix;
+uniform mat4 modelMatrix;
 
 void main(){
 	outColor=color;
 	outUV=uv;
-	origVertex=vertex;
-	varyingNormal=normal;
+	origVertex=(modelMatrix * vec4(vertex, 1.0)).xyz;
+	varyingNormal=mat3(modelMatrix) * normal;
 
 	gl_Position = mvpMatrix * vec4(origVertex,1.0);
 
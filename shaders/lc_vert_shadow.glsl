@@ -12,13 +12,14 @@ out vec3 origVertex;// L
 out vec3 varyingNormal;
 
 uniform mat4 light_mvpMatrix;
+uniform mat4 modelMatrix;
 
 void main(){
 	outColor=color;
 	outUV=uv;
-	origVertex=vertex;
+	origVertex=(modelMatrix * vec4(vertex, 1.0)).xyz;
 
-	varyingNormal=normal;
+	varyingNormal=mat3(modelMatrix) * normal;
 
 	gl_Position = light_mvpMatrix * vec4(origVertex, 1.0);
 